@@ -0,0 +1,337 @@
+/**
+ * @file
+ * @brief Autotuner for sorting thresholds.
+ *
+ * Sweeps each field of SortTuning on this machine, for each element size
+ * class, and writes the fastest values as a header which the library includes
+ * when built with -DSORT_TUNED.
+ *
+ * Parameters are tuned one at a time (coordinate descent), each against the
+ * sorts it affects:
+ * - length_threshold: merge_sort() and quick_sort() on random input.
+ * - min_gallop: timsort() on random and partially sorted input.
+ * - timsort_min_nelems: timsort() on many short random arrays.
+ * - comb_shrink: comb_sort() on random input.
+ *
+ * Usage: autotune.exe [--n N] [--reps R] [--output PATH]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "../src/sorting.h"
+
+typedef void (*SortFn)(void*, size_t, size_t,
+                       int (*compare)(const void*, const void*));
+
+static const size_t class_sizes[SORT_TUNING_NCLASSES] = {
+  1, 2, 4, 8, 16, 32, 64, 128
+};
+
+static const size_t length_thresholds[] = { 2, 4, 7, 10, 16, 24, 32 };
+static const int min_gallops[] = { 3, 5, 7, 10, 14, 20 };
+static const size_t timsort_min_nelems[] = { 16, 32, 64, 96, 128 };
+static const double comb_shrinks[] = { 1.2, 1.25, 1.3, 1.35, 1.4 };
+
+#define COUNT(arr) (sizeof(arr) / sizeof(arr[0]))
+
+//##############################################################################
+//# ELEMENTS
+//##############################################################################
+
+static int
+compare_u8(const void* a, const void* b)
+{
+  uint8_t aval = *((const uint8_t*)a);
+  uint8_t bval = *((const uint8_t*)b);
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+compare_u16(const void* a, const void* b)
+{
+  uint16_t aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+compare_u32(const void* a, const void* b)
+{
+  uint32_t aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+  uint64_t aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int (*
+compare_for_size(size_t size))(const void*, const void*)
+{
+  switch (size) {
+    case 1: return compare_u8;
+    case 2: return compare_u16;
+    case 4: return compare_u32;
+    default: return compare_u64;
+  }
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t
+rng_next()
+{
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * Fill elements with random keys. If 'sorted_pct' is non-zero, that
+ * percentage of consecutive elements ascend, producing long runs.
+ */
+static void
+fill_random(char* arr, size_t n, size_t size, int sorted_pct)
+{
+  const size_t key_bytes = size < 8 ? size : 8;
+  uint64_t key = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (sorted_pct > 0 && (int)(rng_next() % 100) < sorted_pct) {
+      key++;
+    } else {
+      key = rng_next();
+    }
+    memcpy(arr+(i * size), &key, key_bytes);
+    memset(arr+(i * size + key_bytes), 0, size - key_bytes);
+  }
+}
+
+//##############################################################################
+//# TIMING
+//##############################################################################
+
+static double
+now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Time sorting 'n' elements, split into arrays of 'chunk' elements. Returns
+ * best time (in ns) of 'reps' repetitions.
+ */
+static double
+time_sort(SortFn sort, const char* input, char* work, size_t n, size_t chunk,
+          size_t size, int reps)
+{
+  int (*compare)(const void*, const void*) = compare_for_size(size);
+  double best = 0;
+  for (int r = 0; r < reps; r++) {
+    memcpy(work, input, n * size);
+    double start = now_ns();
+    for (size_t c = 0; c + chunk <= n; c += chunk) {
+      sort(work+(c * size), chunk, size, compare);
+    }
+    double elapsed = now_ns() - start;
+    best = (r == 0 || elapsed < best) ? elapsed : best;
+  }
+  return best;
+}
+
+//##############################################################################
+//# SWEEPS
+//##############################################################################
+
+typedef struct TuneInput {
+  char* random; // n random elements.
+  char* runs; // n partially sorted elements.
+  char* work;
+  size_t n;
+  size_t size;
+  int reps;
+} TuneInput;
+
+static double
+cost_length_threshold(const TuneInput* in)
+{
+  return time_sort(merge_sort, in->random, in->work, in->n, in->n, in->size,
+                   in->reps)
+         + time_sort(quick_sort, in->random, in->work, in->n, in->n, in->size,
+                     in->reps);
+}
+
+static double
+cost_min_gallop(const TuneInput* in)
+{
+  return time_sort(timsort, in->random, in->work, in->n, in->n, in->size,
+                   in->reps)
+         + time_sort(timsort, in->runs, in->work, in->n, in->n, in->size,
+                     in->reps);
+}
+
+static double
+cost_timsort_min_nelems(const TuneInput* in)
+{
+  // Array lengths around the threshold itself.
+  double cost = 0;
+  for (size_t chunk = 16; chunk <= 256; chunk *= 2) {
+    cost += time_sort(timsort, in->random, in->work, in->n, chunk, in->size,
+                      in->reps);
+  }
+  return cost;
+}
+
+static double
+cost_comb_shrink(const TuneInput* in)
+{
+  return time_sort(comb_sort, in->random, in->work, in->n, in->n, in->size,
+                   in->reps);
+}
+
+static void
+tune_class(size_t size_class, const TuneInput* in)
+{
+  SortTuning tuning = *sort_tuning_get(in->size);
+  double best;
+  double cost;
+
+  best = -1;
+  size_t best_threshold = tuning.length_threshold;
+  for (size_t i = 0; i < COUNT(length_thresholds); i++) {
+    tuning.length_threshold = length_thresholds[i];
+    sort_tuning_set(size_class, &tuning);
+    cost = cost_length_threshold(in);
+    if (best < 0 || cost < best) {
+      best = cost;
+      best_threshold = length_thresholds[i];
+    }
+  }
+  tuning.length_threshold = best_threshold;
+
+  best = -1;
+  int best_gallop = tuning.min_gallop;
+  for (size_t i = 0; i < COUNT(min_gallops); i++) {
+    tuning.min_gallop = min_gallops[i];
+    sort_tuning_set(size_class, &tuning);
+    cost = cost_min_gallop(in);
+    if (best < 0 || cost < best) {
+      best = cost;
+      best_gallop = min_gallops[i];
+    }
+  }
+  tuning.min_gallop = best_gallop;
+
+  best = -1;
+  size_t best_min_nelems = tuning.timsort_min_nelems;
+  for (size_t i = 0; i < COUNT(timsort_min_nelems); i++) {
+    tuning.timsort_min_nelems = timsort_min_nelems[i];
+    sort_tuning_set(size_class, &tuning);
+    cost = cost_timsort_min_nelems(in);
+    if (best < 0 || cost < best) {
+      best = cost;
+      best_min_nelems = timsort_min_nelems[i];
+    }
+  }
+  tuning.timsort_min_nelems = best_min_nelems;
+
+  best = -1;
+  double best_shrink = tuning.comb_shrink;
+  for (size_t i = 0; i < COUNT(comb_shrinks); i++) {
+    tuning.comb_shrink = comb_shrinks[i];
+    sort_tuning_set(size_class, &tuning);
+    cost = cost_comb_shrink(in);
+    if (best < 0 || cost < best) {
+      best = cost;
+      best_shrink = comb_shrinks[i];
+    }
+  }
+  tuning.comb_shrink = best_shrink;
+
+  sort_tuning_set(size_class, &tuning);
+}
+
+//##############################################################################
+//# MAIN
+//##############################################################################
+
+int
+main(int argc, char* argv[])
+{
+  size_t n = 1 << 15;
+  int reps = 5;
+  const char* path = "sort_tuning_gen.h";
+
+  for (int a = 1; a + 1 < argc; a += 2) {
+    if (strcmp(argv[a], "--n") == 0) {
+      n = (size_t)strtod(argv[a + 1], NULL);
+    } else if (strcmp(argv[a], "--reps") == 0) {
+      reps = atoi(argv[a + 1]) > 0 ? atoi(argv[a + 1]) : 1;
+    } else if (strcmp(argv[a], "--output") == 0) {
+      path = argv[a + 1];
+    } else {
+      fprintf(stderr, "Unknown option %s\n", argv[a]);
+      return 1;
+    }
+  }
+  n = n < 256 ? 256 : n;
+
+  for (size_t c = 0; c < SORT_TUNING_NCLASSES; c++) {
+    const size_t size = class_sizes[c];
+    TuneInput in = {
+      malloc(n * size), malloc(n * size), malloc(n * size), n, size, reps
+    };
+    fill_random(in.random, n, size, 0);
+    fill_random(in.runs, n, size, 90);
+    tune_class(c, &in);
+    const SortTuning* t = sort_tuning_get(size);
+    fprintf(stderr, "size %3zu: length_threshold=%zu min_gallop=%d "
+                    "timsort_min_nelems=%zu comb_shrink=%.2f\n", size,
+            t->length_threshold, t->min_gallop, t->timsort_min_nelems,
+            t->comb_shrink);
+    free(in.random);
+    free(in.runs);
+    free(in.work);
+  }
+
+  FILE* out = fopen(path, "w");
+  if (out == NULL) {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 1;
+  }
+  fprintf(out, "/**\n"
+               " * @file\n"
+               " * @brief Sort tuning generated by autotune for this machine.\n"
+               " */\n"
+               "#ifndef MY_SORT_TUNING_GEN_\n"
+               "#define MY_SORT_TUNING_GEN_\n\n"
+               "/* { length_threshold, min_gallop, timsort_min_nelems, "
+               "comb_shrink } */\n"
+               "#define SORT_TUNING_TABLE { \\\n");
+  for (size_t c = 0; c < SORT_TUNING_NCLASSES; c++) {
+    const SortTuning* t = sort_tuning_get(class_sizes[c]);
+    fprintf(out, "  { %zu, %d, %zu, %.2f }, /* %s%zu bytes */ \\\n",
+            t->length_threshold, t->min_gallop, t->timsort_min_nelems,
+            t->comb_shrink, c == SORT_TUNING_NCLASSES - 1 ? ">" : "<=",
+            c == SORT_TUNING_NCLASSES - 1 ? class_sizes[c] / 2
+                                          : class_sizes[c]);
+  }
+  fprintf(out, "}\n\n#endif /* MY_SORT_TUNING_GEN_ */\n");
+  fclose(out);
+  return 0;
+}
@@ -0,0 +1,562 @@
+/**
+ * @file
+ * @brief Benchmark suite for sorting algorithms.
+ *
+ * Runs every sorting algorithm over a matrix of input distributions, element
+ * sizes and array lengths, and reports nanoseconds per element. When built
+ * with `make SORT_STATS=1`, comparisons and bytes moved per element (taken
+ * from the last repetition) are reported as well. Where hardware counters
+ * can be opened, branch and cache misses per element (also from the last
+ * repetition) are reported beside wall time.
+ *
+ * For every input on which sort_auto() and at least one fixed sort ran,
+ * sort_auto()'s median time is compared against the fastest fixed sort on
+ * stderr, followed by the worst ratio seen.
+ *
+ * Usage: bench.exe [--max-n N] [--reps R] [--warmup W] [--max-bytes B]
+ *                  [--algo NAME] [--dist NAME] [--size S]
+ *                  [--format csv|json] [--output PATH] [--precheck 0|1]
+ *
+ * --precheck 1 enables the sorted-input pre-check of every sort (see
+ * sort_precheck_set()).
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include "../src/sorting.h"
+#include "../src/sort_auto.h"
+#include "../src/sort_stats.h"
+#include "../src/perf.h"
+
+//##############################################################################
+//# ALGORITHMS
+//##############################################################################
+
+typedef void (*SortFn)(void*, size_t, size_t,
+                       int (*compare)(const void*, const void*));
+
+typedef struct BenchAlgo {
+  const char* name;
+  SortFn sort;
+  int quadratic; // Skip for large n.
+} BenchAlgo;
+
+// Timsort run in slices of this many comparisons, to measure slicing overhead.
+enum { SLICE_BUDGET = 10000 };
+
+static void
+timsort_sliced(void* arr, size_t nelems, size_t size,
+               int (*compare)(const void*, const void*))
+{
+  SortStepState* state = sort_step_init(arr, nelems, size, compare);
+  while (!sort_step(state, SLICE_BUDGET)) {
+  }
+  sort_step_free(&state);
+}
+
+static const BenchAlgo algos[] = {
+  { "insert_sort", insert_sort, 1 },
+  { "binary_insert_sort", binary_insert_sort, 1 },
+  { "select_sort", select_sort, 1 },
+  { "comb_sort", comb_sort, 0 },
+  { "merge_sort", merge_sort, 0 },
+  { "merge_sort_iterative", merge_sort_iterative, 0 },
+  { "merge_sort_tiled", merge_sort_tiled, 0 },
+  { "quick_sort", quick_sort, 0 },
+  { "quick_sort_iterative", quick_sort_iterative, 0 },
+  { "quick_sort_3way", quick_sort_3way, 0 },
+  { "timsort", timsort, 0 },
+  { "timsort_sliced", timsort_sliced, 0 },
+  { "sort_auto", sort_auto, 0 },
+};
+enum { NUM_ALGOS = sizeof(algos) / sizeof(algos[0]) };
+
+// Largest array length on which quadratic sorts are run.
+enum { QUADRATIC_MAX_N = 16384 };
+
+//##############################################################################
+//# ELEMENTS
+//##############################################################################
+
+/*
+ * Each element carries its key in its first min(size, 8) bytes. Remaining
+ * bytes are payload which is moved around but never compared.
+ */
+static const size_t elem_sizes[] = { 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+enum { NUM_SIZES = sizeof(elem_sizes) / sizeof(elem_sizes[0]) };
+
+static int
+compare_u8(const void* a, const void* b)
+{
+  uint8_t aval = *((const uint8_t*)a);
+  uint8_t bval = *((const uint8_t*)b);
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+compare_u16(const void* a, const void* b)
+{
+  uint16_t aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+compare_u32(const void* a, const void* b)
+{
+  uint32_t aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+  uint64_t aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int (*
+compare_for_size(size_t size))(const void*, const void*)
+{
+  switch (size) {
+    case 1: return compare_u8;
+    case 2: return compare_u16;
+    case 4: return compare_u32;
+    default: return compare_u64;
+  }
+}
+
+//##############################################################################
+//# DISTRIBUTIONS
+//##############################################################################
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t
+rng_next()
+{
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void
+gen_random(uint64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = rng_next();
+  }
+}
+
+static void
+gen_sorted(uint64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = i;
+  }
+}
+
+static void
+gen_reversed(uint64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = n - i;
+  }
+}
+
+static void
+gen_sawtooth(uint64_t* keys, size_t n)
+{
+  // Eight ascending teeth.
+  size_t period = n / 8 > 0 ? n / 8 : 1;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = i % period;
+  }
+}
+
+static void
+gen_organ_pipe(uint64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = i < n / 2 ? i : n - i;
+  }
+}
+
+static void
+gen_few_unique(uint64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = rng_next() % 16;
+  }
+}
+
+static void
+gen_mostly_sorted(uint64_t* keys, size_t n)
+{
+  // Sorted, followed by k = n / 100 random swaps.
+  gen_sorted(keys, n);
+  size_t k = n / 100 > 0 ? n / 100 : 1;
+  for (size_t s = 0; s < k; s++) {
+    size_t a = rng_next() % n;
+    size_t b = rng_next() % n;
+    uint64_t tmp = keys[a];
+    keys[a] = keys[b];
+    keys[b] = tmp;
+  }
+}
+
+static void
+gen_zipf(uint64_t* keys, size_t n)
+{
+  /*
+   * Approximate Zipf (s = 1) by sampling the continuous 1/x distribution on
+   * [1, n + 1): small ranks are very frequent, large ranks are rare.
+   */
+  const double log_max = log((double)n + 1.0);
+  for (size_t i = 0; i < n; i++) {
+    double u = (double)(rng_next() >> 11) / (double)(1ULL << 53);
+    keys[i] = (uint64_t)exp(u * log_max) - 1;
+  }
+}
+
+typedef struct BenchDist {
+  const char* name;
+  void (*generate)(uint64_t* keys, size_t n);
+} BenchDist;
+
+static const BenchDist dists[] = {
+  { "random", gen_random },
+  { "sorted", gen_sorted },
+  { "reversed", gen_reversed },
+  { "sawtooth", gen_sawtooth },
+  { "organ_pipe", gen_organ_pipe },
+  { "few_unique", gen_few_unique },
+  { "mostly_sorted", gen_mostly_sorted },
+  { "zipf", gen_zipf },
+};
+enum { NUM_DISTS = sizeof(dists) / sizeof(dists[0]) };
+
+/*
+ * Write keys into elements. Keys which do not fit into an element narrower
+ * than 8 bytes are scaled down monotonically, so that sorted inputs stay
+ * sorted (though no longer strictly).
+ */
+static void
+fill_elements(char* arr, const uint64_t* keys, size_t n, size_t size)
+{
+  uint64_t max_key = 0;
+  for (size_t i = 0; i < n; i++) {
+    max_key = keys[i] > max_key ? keys[i] : max_key;
+  }
+  const size_t key_bytes = size < 8 ? size : 8;
+  const uint64_t limit = key_bytes < 8 ? (1ULL << (key_bytes * 8)) - 1
+                                       : UINT64_MAX;
+  const int scale = max_key > limit;
+  memset(arr, 0, n * size);
+  for (size_t i = 0; i < n; i++) {
+    uint64_t k = scale ? (uint64_t)((double)keys[i] / max_key * limit)
+                       : keys[i];
+    switch (key_bytes) {
+      case 1: { uint8_t v = k; memcpy(arr+(i * size), &v, 1); break; }
+      case 2: { uint16_t v = k; memcpy(arr+(i * size), &v, 2); break; }
+      case 4: { uint32_t v = k; memcpy(arr+(i * size), &v, 4); break; }
+      default: memcpy(arr+(i * size), &k, 8); break;
+    }
+    // Fill payload with something non-trivial.
+    for (size_t p = key_bytes; p < size; p++) {
+      arr[i * size + p] = (char)(i + p);
+    }
+  }
+}
+
+//##############################################################################
+//# TIMING
+//##############################################################################
+
+static double
+now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+compare_doubles(const void* a, const void* b)
+{
+  double aval = *((const double*)a);
+  double bval = *((const double*)b);
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+is_sorted_by(const char* arr, size_t n, size_t size,
+             int (*compare)(const void*, const void*))
+{
+  for (size_t i = 1; i < n; i++) {
+    if (compare(arr+((i - 1) * size), arr+(i * size)) > 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+//##############################################################################
+//# OUTPUT
+//##############################################################################
+
+// Whether hardware counters could be opened.
+static int perf_available = 0;
+
+typedef enum { FORMAT_CSV, FORMAT_JSON } BenchFormat;
+
+typedef struct BenchResult {
+  const char* algo;
+  const char* dist;
+  size_t size;
+  size_t n;
+  int reps;
+  double ns_median;
+  double ns_min;
+  int sorted;
+  double compares;
+  double bytes_moved;
+  size_t merge_passes;
+  double branch_misses;
+  double cache_misses;
+} BenchResult;
+
+static void
+print_header(FILE* out, BenchFormat format)
+{
+  if (format == FORMAT_CSV) {
+    fprintf(out, "algorithm,distribution,elem_size,n,reps,"
+                 "ns_per_elem_median,ns_per_elem_min,sorted");
+    if (sort_stats_enabled()) {
+      fprintf(out, ",compares_per_elem,bytes_moved_per_elem,merge_passes");
+    }
+    if (perf_available) {
+      fprintf(out, ",branch_misses_per_elem,cache_misses_per_elem");
+    }
+    fprintf(out, "\n");
+  } else {
+    fprintf(out, "[\n");
+  }
+}
+
+static void
+print_result(FILE* out, BenchFormat format, const BenchResult* r, int first)
+{
+  if (format == FORMAT_CSV) {
+    fprintf(out, "%s,%s,%zu,%zu,%d,%.3f,%.3f,%d", r->algo, r->dist, r->size,
+            r->n, r->reps, r->ns_median, r->ns_min, r->sorted);
+    if (sort_stats_enabled()) {
+      fprintf(out, ",%.3f,%.3f,%zu", r->compares, r->bytes_moved,
+              r->merge_passes);
+    }
+    if (perf_available) {
+      fprintf(out, ",%.3f,%.3f", r->branch_misses, r->cache_misses);
+    }
+    fprintf(out, "\n");
+  } else {
+    fprintf(out, "%s  {\"algorithm\": \"%s\", \"distribution\": \"%s\", "
+                 "\"elem_size\": %zu, \"n\": %zu, \"reps\": %d, "
+                 "\"ns_per_elem_median\": %.3f, \"ns_per_elem_min\": %.3f, "
+                 "\"sorted\": %s", first ? "" : ",\n", r->algo, r->dist,
+            r->size, r->n, r->reps, r->ns_median, r->ns_min,
+            r->sorted ? "true" : "false");
+    if (sort_stats_enabled()) {
+      fprintf(out, ", \"compares_per_elem\": %.3f, "
+                   "\"bytes_moved_per_elem\": %.3f, \"merge_passes\": %zu",
+              r->compares, r->bytes_moved, r->merge_passes);
+    }
+    if (perf_available) {
+      fprintf(out, ", \"branch_misses_per_elem\": %.3f, "
+                   "\"cache_misses_per_elem\": %.3f", r->branch_misses,
+              r->cache_misses);
+    }
+    fprintf(out, "}");
+  }
+  fflush(out);
+}
+
+static void
+print_footer(FILE* out, BenchFormat format)
+{
+  if (format == FORMAT_JSON) {
+    fprintf(out, "\n]\n");
+  }
+}
+
+//##############################################################################
+//# MAIN
+//##############################################################################
+
+int
+main(int argc, char* argv[])
+{
+  size_t max_n = 100000;
+  size_t max_bytes = (size_t)1 << 30;
+  int reps = 5;
+  int warmup = 1;
+  const char* only_algo = NULL;
+  const char* only_dist = NULL;
+  size_t only_size = 0;
+  BenchFormat format = FORMAT_CSV;
+  FILE* out = stdout;
+
+  for (int a = 1; a < argc; a++) {
+    const char* opt = argv[a];
+    const char* val = a + 1 < argc ? argv[a + 1] : NULL;
+    if (val == NULL) {
+      fprintf(stderr, "Missing value for option %s\n", opt);
+      return 1;
+    }
+    if (strcmp(opt, "--max-n") == 0) {
+      max_n = (size_t)strtod(val, NULL);
+    } else if (strcmp(opt, "--max-bytes") == 0) {
+      max_bytes = (size_t)strtod(val, NULL);
+    } else if (strcmp(opt, "--reps") == 0) {
+      reps = atoi(val) > 0 ? atoi(val) : 1;
+    } else if (strcmp(opt, "--warmup") == 0) {
+      warmup = atoi(val);
+    } else if (strcmp(opt, "--algo") == 0) {
+      only_algo = val;
+    } else if (strcmp(opt, "--dist") == 0) {
+      only_dist = val;
+    } else if (strcmp(opt, "--size") == 0) {
+      only_size = (size_t)atol(val);
+    } else if (strcmp(opt, "--precheck") == 0) {
+      sort_precheck_set(atoi(val));
+    } else if (strcmp(opt, "--format") == 0) {
+      format = strcmp(val, "json") == 0 ? FORMAT_JSON : FORMAT_CSV;
+    } else if (strcmp(opt, "--output") == 0) {
+      out = fopen(val, "w");
+      if (out == NULL) {
+        fprintf(stderr, "Unable to open %s\n", val);
+        return 1;
+      }
+    } else {
+      fprintf(stderr, "Unknown option %s\n", opt);
+      return 1;
+    }
+    a++;
+  }
+
+  PerfCounters perf;
+  perf_available = perf_counters_open(&perf) > 0;
+  if (!perf_available) {
+    fprintf(stderr, "Hardware counters unavailable; reporting wall time "
+                    "only\n");
+  }
+
+  print_header(out, format);
+  int first = 1;
+  double* times = malloc(reps * sizeof(double));
+  double worst_auto_ratio = 0;
+
+  for (size_t n = 10; n <= max_n; n *= 10) {
+    uint64_t* keys = malloc(n * sizeof(uint64_t));
+    for (int d = 0; d < NUM_DISTS; d++) {
+      if (only_dist != NULL && strcmp(only_dist, dists[d].name) != 0) {
+        continue;
+      }
+      dists[d].generate(keys, n);
+      for (int s = 0; s < NUM_SIZES; s++) {
+        const size_t size = elem_sizes[s];
+        if ((only_size != 0 && size != only_size) || n * size > max_bytes) {
+          continue;
+        }
+        int (*compare)(const void*, const void*) = compare_for_size(size);
+        char* input = malloc(n * size);
+        char* work = malloc(n * size);
+        fill_elements(input, keys, n, size);
+        double auto_ns = -1;
+        double best_ns = -1;
+        const char* best_name = NULL;
+
+        for (int al = 0; al < NUM_ALGOS; al++) {
+          if ((only_algo != NULL && strcmp(only_algo, algos[al].name) != 0)
+              || (algos[al].quadratic && n > QUADRATIC_MAX_N)) {
+            continue;
+          }
+          for (int w = 0; w < warmup; w++) {
+            memcpy(work, input, n * size);
+            algos[al].sort(work, n, size, compare);
+          }
+          int sorted = 1;
+          PerfSample counts;
+          for (int r = 0; r < reps; r++) {
+            memcpy(work, input, n * size);
+            sort_stats_reset();
+            perf_counters_start(&perf);
+            double start = now_ns();
+            algos[al].sort(work, n, size, compare);
+            times[r] = (now_ns() - start) / n;
+            counts = perf_counters_stop(&perf);
+            sorted = sorted && is_sorted_by(work, n, size, compare);
+          }
+          qsort(times, reps, sizeof(double), compare_doubles);
+          BenchResult result = {
+            algos[al].name, dists[d].name, size, n, reps,
+            times[reps / 2], times[0], sorted,
+            (double)sort_stats_get().compares / n,
+            (double)sort_stats_get().bytes_moved / n,
+            sort_stats_get().merge_passes,
+            (double)counts.values[PERF_BRANCH_MISSES] / n,
+            (double)counts.values[PERF_CACHE_MISSES] / n
+          };
+          print_result(out, format, &result, first);
+          first = 0;
+          if (algos[al].sort == sort_auto) {
+            auto_ns = result.ns_median;
+          } else if (best_ns < 0 || result.ns_median < best_ns) {
+            best_ns = result.ns_median;
+            best_name = algos[al].name;
+          }
+        }
+        if (auto_ns > 0 && best_ns > 0) {
+          SortAutoChoice choice = sort_auto_choose(input, n, size, compare,
+                                                   NULL);
+          fprintf(stderr, "sort_auto %s/%zu/%zu: %s, %.2fx best (%s)\n",
+                  dists[d].name, size, n, sort_auto_choice_name(choice),
+                  auto_ns / best_ns, best_name);
+          if (auto_ns / best_ns > worst_auto_ratio) {
+            worst_auto_ratio = auto_ns / best_ns;
+          }
+        }
+        free(input);
+        free(work);
+      }
+    }
+    free(keys);
+    // Guard against overflow when max_n is close to SIZE_MAX.
+    if (n > max_n / 10) {
+      break;
+    }
+  }
+
+  print_footer(out, format);
+  if (worst_auto_ratio > 0) {
+    fprintf(stderr, "sort_auto worst: %.2fx best fixed sort\n",
+            worst_auto_ratio);
+  }
+  free(times);
+  perf_counters_close(&perf);
+  if (out != stdout) {
+    fclose(out);
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file
+ * @brief Thread scaling benchmark for parallel sorts.
+ *
+ * Sorts the same array of 8-byte keys with sample_sort_parallel() on 1, 2,
+ * 4, ... up to --max-threads threads, and once with quick_sort() for
+ * reference. Reports ns/element and speedup over one thread as CSV on stdout.
+ * Keys are drawn from each distribution in turn, or only from --dist:
+ * random (uniform), dups (16 distinct keys) and equal (all keys equal).
+ *
+ * Usage: scaling_bench.exe [--n N] [--max-threads T] [--reps R]
+ *                          [--dist random|dups|equal]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "../src/sorting.h"
+#include "../src/sample_sort.h"
+#include "../src/sorted.h"
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t
+rng_next()
+{
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static int
+compare_u64(const void* a, const void* b)
+{
+  uint64_t aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static double
+now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/*
+ * Best of 'reps' sorts of a copy of 'input', in ns/element. Threads of 0
+ * selects quick_sort().
+ */
+static double
+bench_sort(const uint64_t* input, uint64_t* work, size_t n, size_t nthreads,
+           int reps, int* sorted)
+{
+  double best = -1;
+  for (int r = 0; r < reps; r++) {
+    memcpy(work, input, n * sizeof(uint64_t));
+    double start = now_ns();
+    if (nthreads == 0) {
+      quick_sort(work, n, sizeof(uint64_t), compare_u64);
+    } else {
+      sample_sort_parallel(work, n, sizeof(uint64_t), compare_u64, nthreads);
+    }
+    double ns = (now_ns() - start) / n;
+    best = (best < 0 || ns < best) ? ns : best;
+    *sorted = *sorted && is_sorted_u64(work, n);
+  }
+  return best;
+}
+
+int
+main(int argc, char* argv[])
+{
+  size_t n = 10000000;
+  size_t max_threads = 64;
+  int reps = 3;
+  const char* only_dist = NULL;
+
+  for (int a = 1; a + 1 < argc; a += 2) {
+    if (strcmp(argv[a], "--n") == 0) {
+      n = (size_t)strtod(argv[a + 1], NULL);
+    } else if (strcmp(argv[a], "--max-threads") == 0) {
+      max_threads = (size_t)strtod(argv[a + 1], NULL);
+    } else if (strcmp(argv[a], "--reps") == 0) {
+      reps = atoi(argv[a + 1]) > 0 ? atoi(argv[a + 1]) : 1;
+    } else if (strcmp(argv[a], "--dist") == 0) {
+      only_dist = argv[a + 1];
+    } else {
+      fprintf(stderr, "Unknown option %s\n", argv[a]);
+      return 1;
+    }
+  }
+  n = n < 1 ? 1 : n;
+  max_threads = max_threads < 1 ? 1 : max_threads;
+
+  static const char* const dists[] = { "random", "dups", "equal" };
+  const int ndists = (int)(sizeof(dists) / sizeof(dists[0]));
+  int found = only_dist == NULL;
+  for (int d = 0; d < ndists; d++) {
+    found = found || strcmp(only_dist, dists[d]) == 0;
+  }
+  if (!found) {
+    fprintf(stderr, "Unknown distribution %s\n", only_dist);
+    return 1;
+  }
+
+  uint64_t* input = malloc(n * sizeof(uint64_t));
+  uint64_t* work = malloc(n * sizeof(uint64_t));
+
+  printf("algorithm,dist,threads,n,ns_per_elem,speedup,sorted\n");
+  for (int d = 0; d < ndists; d++) {
+    if (only_dist != NULL && strcmp(only_dist, dists[d]) != 0) {
+      continue;
+    }
+    for (size_t i = 0; i < n; i++) {
+      input[i] = d == 0 ? rng_next() : d == 1 ? rng_next() % 16 : 42;
+    }
+    int sorted = 1;
+    double quick_ns = bench_sort(input, work, n, 0, reps, &sorted);
+    printf("quick_sort,%s,1,%zu,%.3f,1.000,%d\n", dists[d], n, quick_ns,
+           sorted);
+    double single_ns = 0;
+    for (size_t nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+      sorted = 1;
+      double ns = bench_sort(input, work, n, nthreads, reps, &sorted);
+      single_ns = nthreads == 1 ? ns : single_ns;
+      printf("sample_sort_parallel,%s,%zu,%zu,%.3f,%.3f,%d\n", dists[d],
+             nthreads, n, ns, single_ns / ns, sorted);
+      fflush(stdout);
+    }
+  }
+
+  free(input);
+  free(work);
+  return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @brief Benchmark of the lock-free concurrent stack against a Stack guarded
+ * by a mutex.
+ *
+ * Each thread repeatedly pushes a burst of items and pops as many back, so
+ * that the stack stays shallow and threads contend on its head. Throughput is
+ * reported as millions of operations (pushes plus pops) per second, as CSV on
+ * stdout, for 1, 2, 4, ... up to --max-threads threads.
+ *
+ * Usage: stack_bench.exe [--ops N] [--burst B] [--max-threads T] [--reps R]
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "../src/stack.h"
+#include "../src/concurrent_stack.h"
+
+typedef struct BenchStack {
+  const char* name; ///< Name printed in results.
+  void* (*init)(); ///< Create empty stack.
+  void (*push)(void* stack, void* data); ///< Push item.
+  void (*pop)(void* stack); ///< Pop item.
+  void (*free)(void* stack); ///< Free stack.
+} BenchStack;
+
+typedef struct Worker {
+  const BenchStack* impl; ///< Stack implementation under test.
+  void* stack; ///< Shared stack.
+  size_t ops; ///< Push / pop pairs to perform.
+  size_t burst; ///< Items pushed before popping them back.
+} Worker;
+
+//##############################################################################
+//# STACKS
+//##############################################################################
+
+typedef struct MutexStack {
+  pthread_mutex_t lock;
+  Stack* stack;
+} MutexStack;
+
+static void*
+mutex_stack_init()
+{
+  MutexStack* s = malloc(sizeof(MutexStack));
+  pthread_mutex_init(&s->lock, NULL);
+  s->stack = stack_init();
+  return s;
+}
+
+static void
+mutex_stack_push(void* stack, void* data)
+{
+  MutexStack* s = stack;
+  pthread_mutex_lock(&s->lock);
+  stack_push(s->stack, data);
+  pthread_mutex_unlock(&s->lock);
+}
+
+static void
+mutex_stack_pop(void* stack)
+{
+  MutexStack* s = stack;
+  pthread_mutex_lock(&s->lock);
+  stack_pop(s->stack);
+  pthread_mutex_unlock(&s->lock);
+}
+
+static void
+mutex_stack_free(void* stack)
+{
+  MutexStack* s = stack;
+  pthread_mutex_destroy(&s->lock);
+  stack_free(&s->stack);
+  free(s);
+}
+
+static void*
+lock_free_stack_init()
+{
+  return concurrent_stack_init();
+}
+
+static void
+lock_free_stack_push(void* stack, void* data)
+{
+  concurrent_stack_push(stack, data);
+}
+
+static void
+lock_free_stack_pop(void* stack)
+{
+  concurrent_stack_pop(stack);
+}
+
+static void
+lock_free_stack_free(void* stack)
+{
+  ConcurrentStack* s = stack;
+  concurrent_stack_free(&s);
+}
+
+static const BenchStack impls[] = {
+  { "mutex", mutex_stack_init, mutex_stack_push, mutex_stack_pop,
+    mutex_stack_free },
+  { "concurrent", lock_free_stack_init, lock_free_stack_push,
+    lock_free_stack_pop, lock_free_stack_free },
+};
+
+#define NIMPLS (sizeof(impls) / sizeof(impls[0]))
+
+//##############################################################################
+//# TIMING
+//##############################################################################
+
+static double
+now_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void*
+worker_run(void* arg)
+{
+  Worker* w = arg;
+  for (size_t done = 0; done < w->ops; done += w->burst) {
+    size_t burst = w->ops - done < w->burst ? w->ops - done : w->burst;
+    for (size_t i = 0; i < burst; i++) {
+      w->impl->push(w->stack, w);
+    }
+    for (size_t i = 0; i < burst; i++) {
+      w->impl->pop(w->stack);
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Best of 'reps' runs of 'nthreads' threads, each performing 'ops' push / pop
+ * pairs on one shared stack, in millions of operations per second.
+ */
+static double
+bench_stack(const BenchStack* impl, size_t nthreads, size_t ops, size_t burst,
+            int reps)
+{
+  pthread_t* threads = malloc(nthreads * sizeof(pthread_t));
+  Worker* workers = malloc(nthreads * sizeof(Worker));
+  double best = 0.0;
+  for (int r = 0; r < reps; r++) {
+    void* stack = impl->init();
+    double start = now_ns();
+    for (size_t t = 0; t < nthreads; t++) {
+      workers[t] = (Worker){ impl, stack, ops, burst };
+      pthread_create(&threads[t], NULL, worker_run, &workers[t]);
+    }
+    for (size_t t = 0; t < nthreads; t++) {
+      pthread_join(threads[t], NULL);
+    }
+    double elapsed = now_ns() - start;
+    impl->free(stack);
+    double mops = 2.0 * (double)(nthreads * ops) / elapsed * 1e3;
+    best = mops > best ? mops : best;
+  }
+  free(threads);
+  free(workers);
+  return best;
+}
+
+int
+main(int argc, char* argv[])
+{
+  size_t ops = 1 << 20;
+  size_t burst = 16;
+  size_t max_threads = 8;
+  int reps = 3;
+
+  for (int a = 1; a + 1 < argc; a += 2) {
+    if (strcmp(argv[a], "--ops") == 0) {
+      ops = (size_t)strtod(argv[a + 1], NULL);
+    } else if (strcmp(argv[a], "--burst") == 0) {
+      burst = (size_t)strtod(argv[a + 1], NULL);
+    } else if (strcmp(argv[a], "--max-threads") == 0) {
+      max_threads = (size_t)strtod(argv[a + 1], NULL);
+    } else if (strcmp(argv[a], "--reps") == 0) {
+      reps = atoi(argv[a + 1]) > 0 ? atoi(argv[a + 1]) : 1;
+    } else {
+      fprintf(stderr, "Unknown option %s\n", argv[a]);
+      return 1;
+    }
+  }
+  burst = burst < 1 ? 1 : burst;
+  max_threads = max_threads < 1 ? 1 : max_threads;
+
+  printf("stack,threads,burst,mops_per_s\n");
+  for (size_t nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+    for (size_t i = 0; i < NIMPLS; i++) {
+      double mops = bench_stack(&impls[i], nthreads, ops, burst, reps);
+      printf("%s,%zu,%zu,%.2f\n", impls[i].name, nthreads, burst, mops);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
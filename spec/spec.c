@@ -1,9 +1,30 @@
 #include <string.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <time.h>
+#include <pthread.h>
 #include "minunit.h"
 #include "../src/stack.h"
+#include "../src/concurrent_stack.h"
+#include "../src/parallel.h"
 #include "../src/sorting.h"
+#include "../src/sort_auto.h"
+#include "../src/presorted.h"
+#include "../src/sorted.h"
+#include "../src/counting.h"
+#include "../src/list_sort.h"
+#include "../src/sample_sort.h"
+#include "../src/segmented.h"
+#include "../src/cosort.h"
+#include "../src/order_by.h"
+#include "../src/normkey.h"
+#include "../src/prefix_sort.h"
+#include "../src/sort_by_key.h"
+#include "../src/sort_job.h"
+#include "../src/segment.h"
+#include "../src/sort_stats.h"
+#include "../src/perf.h"
+#include "../src/trace.h"
 
 int tests_run = 0;
 
@@ -89,6 +110,119 @@ static char* test_stack_free()
   return 0;
 }
 
+static char* test_stack_pool() 
+{
+  enum { STACK_TEST_SIZE = 100000 };
+  Stack* stack = stack_init();
+  int* values = malloc(STACK_TEST_SIZE * sizeof(int));
+  for (int i = 0; i < STACK_TEST_SIZE; i++) {
+    values[i] = i;
+    stack_push(stack, &values[i]);
+  }
+  size_t capacity = stack->capacity;
+  mu_assert("stack_push: pool should grow geometrically", 
+            capacity >= STACK_TEST_SIZE && capacity < 3 * STACK_TEST_SIZE);
+
+  for (int round = 0; round < 2; round++) {
+    for (int i = STACK_TEST_SIZE - 1; i >= 0; i--) {
+      mu_assert("stack_pop_return: should return values in LIFO order", 
+                stack_pop_return(stack) == &values[i]);
+    }
+    mu_assert("stack_pop_return: should empty stack", 
+              stack->len == 0 && stack->head == NULL);
+    for (int i = 0; i < STACK_TEST_SIZE; i++) {
+      stack_push(stack, &values[i]);
+    }
+    mu_assert("stack_push: should reuse popped frames", 
+              stack->capacity == capacity);
+  }
+
+  stack_reserve(stack, 1000);
+  capacity = stack->capacity;
+  for (int i = 0; i < 1000; i++) {
+    stack_push(stack, &values[i]);
+  }
+  mu_assert("stack_reserve: reserved pushes should not allocate", 
+            stack->capacity == capacity
+            && stack->len == STACK_TEST_SIZE + 1000);
+
+  stack_free(&stack);
+  free(values);
+  return 0;
+}
+
+enum { CONCURRENT_TASKS = 8, CONCURRENT_TASK_ITEMS = 20000 };
+
+typedef struct ConcurrentStackTest {
+  ConcurrentStack* stack;
+  int* values;
+  int* popped;
+} ConcurrentStackTest;
+
+static void concurrent_stack_task(size_t task, void* ctx)
+{
+  ConcurrentStackTest* test = ctx;
+  int* values = test->values + task * CONCURRENT_TASK_ITEMS;
+  for (int i = 0; i < CONCURRENT_TASK_ITEMS; i += 50) {
+    for (int j = i; j < i + 50; j++) {
+      concurrent_stack_push(test->stack, &values[j]);
+    }
+    for (int j = i; j < i + 50; j++) {
+      void* data;
+      if (concurrent_stack_try_pop(test->stack, &data)) {
+        __atomic_add_fetch(&test->popped[*(int*)data], 1, __ATOMIC_RELAXED);
+      }
+    }
+  }
+}
+
+static char* test_concurrent_stack() 
+{
+  ConcurrentStack* stack = concurrent_stack_init();
+  int values[3] = { 0, 1, 2 };
+  mu_assert("concurrent_stack_pop_return: empty stack should return NULL", 
+            concurrent_stack_pop_return(stack) == NULL);
+  for (int i = 0; i < 3; i++) {
+    mu_assert("concurrent_stack_push: should succeed", 
+              concurrent_stack_push(stack, &values[i]));
+  }
+  mu_assert("concurrent_stack_len: should count pushes", 
+            concurrent_stack_len(stack) == 3);
+  for (int i = 2; i >= 0; i--) {
+    mu_assert("concurrent_stack_pop_return: should return values in LIFO "
+              "order", concurrent_stack_pop_return(stack) == &values[i]);
+  }
+  mu_assert("concurrent_stack_pop: empty stack should return 0", 
+            concurrent_stack_pop(stack) == 0
+            && concurrent_stack_len(stack) == 0);
+
+  const size_t nitems = CONCURRENT_TASKS * CONCURRENT_TASK_ITEMS;
+  ConcurrentStackTest test = {
+    stack, malloc(nitems * sizeof(int)), calloc(nitems, sizeof(int))
+  };
+  for (size_t i = 0; i < nitems; i++) {
+    test.values[i] = (int) i;
+  }
+  parallel_for(CONCURRENT_TASKS, 4, concurrent_stack_task, &test);
+  void* data;
+  while (concurrent_stack_try_pop(stack, &data)) {
+    test.popped[*(int*)data]++;
+  }
+  int exactly_once = 1;
+  for (size_t i = 0; i < nitems; i++) {
+    exactly_once &= test.popped[i] == 1;
+  }
+  mu_assert("concurrent_stack_try_pop: every push should be popped exactly "
+            "once", exactly_once && concurrent_stack_len(stack) == 0);
+
+  concurrent_stack_free(&stack);
+  mu_assert("concurrent_stack_free: stack pointer should be NULL", 
+            stack == NULL);
+  free(test.values);
+  free(test.popped);
+  return 0;
+}
+
 //##############################################################################
 //# SORTING TEST SETUP
 //##############################################################################
@@ -154,34 +288,6 @@ get_sorting_tests()
   return default_tests;
 }
 
-//##############################################################################
-//# SORTING HELPER TESTS
-//##############################################################################
-// Note: Require altering function declaration to non-static before running.
-/*static char*
-test_bin_search_loc()
-{
-  int arr[10] = { -4, -2, 0, 0, 1, 3, 3, 3, 7, 10 };
-  int target = 5;
-  size_t index = bin_search_loc(&arr, sizeof(int), compare_ints, 
-                                0, 9 * sizeof(int), &target) / sizeof(int);
-  mu_assert("bin_search_loc: should have index 8", index == 8);
-
-  target = -5;
-  index = bin_search_loc(&arr, sizeof(int), compare_ints, 
-                         0, 9 * sizeof(int), &target) / sizeof(int);
-  mu_assert("bin_search_loc: should have index 0 for small element", 
-            index == 0);
-
-  target = 20;
-  index = bin_search_loc(&arr, sizeof(int), compare_ints, 
-                         0, 9 * sizeof(int), &target) / sizeof(int);
-  mu_assert("bin_search_loc: should return last index of array for target"
-            "greater than all other elements in the array", index == 9);
-  
-  return 0;
-}*/
-
 //##############################################################################
 //# SORTING TESTS
 //##############################################################################
@@ -418,6 +524,7 @@ test_timsort_stress_integers()
 
   free(tst);
   free(def);
+  return 0;
 }
 
 static char*
@@ -544,8 +651,1366 @@ test_timsort_stress_chars()
 
   free(tst);
   free(def);
+  return 0;
+}
+
+
+//##############################################################################
+//# SORT STATS TESTS
+//##############################################################################
+// Note: Require building with SORT_STATS defined (make SORT_STATS=1).
+#ifdef SORT_STATS
+static char*
+test_sort_stats_timsort()
+{
+  enum { STATS_TEST_SIZE = 1000 };
+  int arr[STATS_TEST_SIZE];
+  for (int i = 0; i < STATS_TEST_SIZE; i++) {
+    arr[i] = STATS_TEST_SIZE - i;
+  }
+  sort_stats_reset();
+  timsort(arr, STATS_TEST_SIZE, sizeof(int), compare_ints);
+  SortStats stats = sort_stats_get();
+  mu_assert("sort_stats: descending input should form a single run",
+            stats.runs == 1 && stats.merges == 0);
+  mu_assert("sort_stats: single run should need n - 1 comparisons",
+            stats.compares == STATS_TEST_SIZE - 1);
+  mu_assert("sort_stats: reversing run should swap n / 2 times",
+            stats.swaps == STATS_TEST_SIZE / 2);
+
+  for (int i = 0; i < STATS_TEST_SIZE; i++) {
+    arr[i] = (i * 7919) % STATS_TEST_SIZE;
+  }
+  sort_stats_reset();
+  timsort(arr, STATS_TEST_SIZE, sizeof(int), compare_ints);
+  stats = sort_stats_get();
+  mu_assert("sort_stats: unsorted input should need runs and merges",
+            stats.runs > 1 && stats.merges == stats.runs - 1
+            && stats.allocs > 0 && stats.bytes_moved > 0
+            && stats.min_gallop_updates > 0);
+  return 0;
 }
+#endif
 
+//##############################################################################
+//# PERF TESTS
+//##############################################################################
+
+static char*
+test_perf_counters()
+{
+  PerfCounters pc;
+  int available = perf_counters_open(&pc);
+  int arr[1000];
+  for (int i = 0; i < 1000; i++) {
+    arr[i] = (i * 7919) % 1000;
+  }
+  perf_phases_attach(&pc);
+  perf_counters_start(&pc);
+  timsort(arr, 1000, sizeof(int), compare_ints);
+  PerfSample sample = perf_counters_stop(&pc);
+  int valid = 0;
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    valid += sample.valid[e];
+    mu_assert("perf_counters_stop: unavailable events should read as 0",
+              sample.valid[e] || sample.values[e] == 0);
+  }
+  mu_assert("perf_counters_stop: should report each open counter as valid",
+            valid == available);
+  perf_counters_close(&pc);
+  mu_assert("perf_counters_close: should close all counters",
+            pc.fds[PERF_CYCLES] == -1 && pc.fds[PERF_CACHE_MISSES] == -1);
+  return 0;
+}
+
+//##############################################################################
+//# TRACE TESTS
+//##############################################################################
+// Note: Require building with SORT_TRACE defined (make SORT_TRACE=1).
+#ifdef SORT_TRACE
+static char*
+test_trace_dump()
+{
+  const char* path = "trace_spec.json";
+  int arr[1000];
+  for (int i = 0; i < 1000; i++) {
+    arr[i] = (i * 7919) % 1000;
+  }
+  trace_reset();
+  trace_thread_name("spec");
+  timsort(arr, 1000, sizeof(int), compare_ints);
+  mu_assert("trace_dump: should write trace file", trace_dump(path) == 1);
+
+  FILE* file = fopen(path, "r");
+  char buff[4096];
+  size_t len = fread(buff, 1, sizeof(buff) - 1, file);
+  buff[len] = '\0';
+  fclose(file);
+  remove(path);
+  mu_assert("trace_dump: should contain timsort phases",
+            strstr(buff, "\"traceEvents\"") != NULL
+            && strstr(buff, "\"name\": \"timsort\"") != NULL
+            && strstr(buff, "\"name\": \"merge_runs\"") != NULL);
+  return 0;
+}
+
+static int
+trace_max_tid(const char* path)
+{
+  FILE* file = fopen(path, "r");
+  char* buff = malloc(1 << 22);
+  size_t len = fread(buff, 1, (1 << 22) - 1, file);
+  buff[len] = '\0';
+  fclose(file);
+  int max_tid = -1;
+  for (const char* tid = strstr(buff, "\"tid\": "); tid != NULL;
+       tid = strstr(tid + 1, "\"tid\": ")) {
+    int value = atoi(tid + strlen("\"tid\": "));
+    max_tid = value > max_tid ? value : max_tid;
+  }
+  free(buff);
+  return max_tid;
+}
+
+static char*
+test_trace_workers()
+{
+  enum { TRACE_WORKERS_SIZE = 100000 };
+  const char* path = "trace_workers_spec.json";
+  int* arr = malloc(TRACE_WORKERS_SIZE * sizeof(int));
+  for (int i = 0; i < TRACE_WORKERS_SIZE; i++) {
+    arr[i] = rand();
+  }
+  trace_reset();
+  sample_sort_parallel(arr, TRACE_WORKERS_SIZE, sizeof(int), compare_ints, 2);
+  SortPool* pool = sort_pool_init(1);
+  SortJob job = {
+    quick_sort, arr, 100, sizeof(int), compare_ints, SORT_JOB_NORMAL, NULL,
+    NULL
+  };
+  SortJobHandle* handle = sort_submit(pool, &job);
+  sort_wait(handle);
+  sort_handle_free(&handle);
+  sort_pool_free(&pool);
+  mu_assert("trace_dump: should write trace file", trace_dump(path) == 1);
+
+  FILE* file = fopen(path, "r");
+  char* buff = malloc(1 << 20);
+  size_t len = fread(buff, 1, (1 << 20) - 1, file);
+  buff[len] = '\0';
+  fclose(file);
+  remove(path);
+  mu_assert("trace_dump: should name worker threads",
+            strstr(buff, "\"name\": \"parallel_for worker\"") != NULL
+            && strstr(buff, "\"name\": \"sort_pool worker\"") != NULL);
+  mu_assert("trace_dump: should record tasks run by workers",
+            strstr(buff, "\"name\": \"parallel_task\"") != NULL
+            && strstr(buff, "\"index\": ") != NULL
+            && strstr(buff, "\"name\": \"sort_job\"") != NULL);
+  free(buff);
+
+  // Workers of later calls reuse the buffers of exited workers.
+  mu_assert("trace_dump: should write trace file", trace_dump(path) == 1);
+  const int max_tid = trace_max_tid(path);
+  for (int r = 0; r < 8; r++) {
+    sample_sort_parallel(arr, TRACE_WORKERS_SIZE, sizeof(int), compare_ints,
+                         2);
+  }
+  mu_assert("trace_dump: should write trace file", trace_dump(path) == 1);
+  mu_assert("trace_buffer: should reuse buffers of exited threads",
+            trace_max_tid(path) == max_tid);
+  remove(path);
+  free(arr);
+  return 0;
+}
+#endif
+
+//##############################################################################
+//# SEGMENT TESTS
+//##############################################################################
+
+static char*
+test_segment_lookup()
+{
+  enum { SEGMENT_TEST_SIZE = 10000 };
+  const char* path = "segment_spec.seg";
+  int* arr = malloc(SEGMENT_TEST_SIZE * sizeof(int));
+  for (int i = 0; i < SEGMENT_TEST_SIZE; i++) {
+    arr[i] = (SEGMENT_TEST_SIZE - i) / 3;
+  }
+
+  // Block lengths: default (one page), and tiny (spans several index pages).
+  size_t block_lens[2] = { 0, 2 };
+  for (int b = 0; b < 2; b++) {
+    mu_assert("segment_sort_write: should write segment file",
+              segment_sort_write(path, arr, SEGMENT_TEST_SIZE, sizeof(int),
+                                 compare_ints, block_lens[b]) == 1);
+    Segment* seg = segment_open(path);
+    mu_assert("segment_open: should open segment file", seg != NULL);
+
+    for (int target = -1; target <= SEGMENT_TEST_SIZE / 3 + 1; target += 7) {
+      size_t expected = 0;
+      while (expected < SEGMENT_TEST_SIZE && arr[expected] < target) {
+        expected++;
+      }
+      mu_assert("segment_lower_bound: should find first element >= target",
+                segment_lower_bound(seg, compare_ints, &target) == expected);
+    }
+
+    int lo = 100;
+    int hi = 200;
+    size_t first;
+    size_t count = segment_range(seg, compare_ints, &lo, &hi, &first);
+    mu_assert("segment_range: should find all elements in [lo, hi]",
+              count == 303 && *(int*)segment_get(seg, first) == lo
+              && *(int*)segment_get(seg, first + count - 1) == hi);
+    segment_close(&seg);
+    mu_assert("segment_close: segment pointer should be NULL", seg == NULL);
+  }
+
+  // Header whose data length overflows to 4 bytes when computed naively.
+  SegmentHeader header;
+  FILE* file = fopen(path, "r+b");
+  mu_assert("segment_open: should read header",
+            fread(&header, sizeof(header), 1, file) == 1);
+  header.nelems = ((uint64_t) 1 << 62) + 1;
+  header.block_nelems = header.nelems;
+  header.nblocks = 1;
+  rewind(file);
+  fwrite(&header, sizeof(header), 1, file);
+  fclose(file);
+  mu_assert("segment_open: should reject overflowing lengths",
+            segment_open(path) == NULL);
+
+  remove(path);
+  free(arr);
+  return 0;
+}
+
+static char*
+test_sort_auto_choose()
+{
+  enum { AUTO_TEST_SIZE = 10000 };
+  int* arr = malloc(AUTO_TEST_SIZE * sizeof(int));
+  SortAutoSample sample;
+
+  for (int i = 0; i < AUTO_TEST_SIZE; i++) {
+    arr[i] = (i * 7919) % AUTO_TEST_SIZE;
+  }
+  mu_assert("sort_auto_choose: tiny arrays should use insertion sort",
+            sort_auto_choose(arr, 10, sizeof(int), compare_ints, NULL)
+            == SORT_AUTO_INSERT);
+  mu_assert("sort_auto_choose: short arrays should use insertion sort",
+            sort_auto_choose(arr, SORT_AUTO_INSERT_NELEMS - 1, sizeof(int),
+                             compare_ints, NULL) == SORT_AUTO_INSERT);
+  mu_assert("sort_auto_choose: arrays past the cutoff should not",
+            sort_auto_choose(arr, SORT_AUTO_INSERT_NELEMS, sizeof(int),
+                             compare_ints, NULL) != SORT_AUTO_INSERT);
+  mu_assert("sort_auto_choose: random arrays should use quicksort",
+            sort_auto_choose(arr, AUTO_TEST_SIZE, sizeof(int), compare_ints,
+                             &sample) == SORT_AUTO_QUICK
+            && sample.pairs > 0 && sample.distinct == sample.sampled);
+
+  for (int i = 0; i < AUTO_TEST_SIZE; i++) {
+    arr[i] = (i < AUTO_TEST_SIZE / 2) ? i : AUTO_TEST_SIZE - i;
+  }
+  mu_assert("sort_auto_choose: long runs should use timsort",
+            sort_auto_choose(arr, AUTO_TEST_SIZE, sizeof(int), compare_ints,
+                             NULL) == SORT_AUTO_TIMSORT);
+
+  for (int i = 0; i < AUTO_TEST_SIZE; i++) {
+    arr[i] = (i * 7919) % 5;
+  }
+  mu_assert("sort_auto_choose: few unique values should use 3-way quicksort",
+            sort_auto_choose(arr, AUTO_TEST_SIZE, sizeof(int), compare_ints,
+                             NULL) == SORT_AUTO_QUICK_3WAY);
+
+  sort_stats_reset();
+  sort_auto(arr, AUTO_TEST_SIZE, sizeof(int), compare_ints);
+  for (int i = 1; i < AUTO_TEST_SIZE; i++) {
+    mu_assert("sort_auto: should sort few unique values", arr[i - 1] <= arr[i]);
+  }
+  if (sort_stats_enabled()) {
+    mu_assert("sort_auto: should record its choice in stats",
+              sort_stats_get().auto_dispatches == 1
+              && sort_stats_get().auto_choice == SORT_AUTO_QUICK_3WAY);
+  }
+
+  free(arr);
+  return 0;
+}
+
+static char*
+test_measure_presortedness()
+{
+  enum { PRESORTED_TEST_SIZE = 3000 };
+  int* arr = malloc(PRESORTED_TEST_SIZE * sizeof(int));
+  for (int i = 0; i < PRESORTED_TEST_SIZE; i++) {
+    arr[i] = rand() % 500;
+  }
+
+  // Brute force: inversions, duplicates and stable ranks.
+  uint64_t inversions = 0;
+  size_t duplicates = 0;
+  size_t max_displacement = 0;
+  for (int i = 0; i < PRESORTED_TEST_SIZE; i++) {
+    size_t rank = 0;
+    int duplicate = 0;
+    for (int j = 0; j < PRESORTED_TEST_SIZE; j++) {
+      inversions += j > i && arr[i] > arr[j];
+      rank += arr[j] < arr[i] || (j < i && arr[j] == arr[i]);
+      duplicate = duplicate || (j < i && arr[j] == arr[i]);
+    }
+    duplicates += duplicate;
+    size_t displacement = rank > (size_t)i ? rank - i : i - rank;
+    max_displacement = displacement > max_displacement ? displacement
+                                                       : max_displacement;
+  }
+
+  size_t nthreads[3] = { 1, 3, 0 };
+  for (int t = 0; t < 3; t++) {
+    Presortedness p = measure_presortedness_parallel(
+        arr, PRESORTED_TEST_SIZE, sizeof(int), compare_ints, nthreads[t]);
+    mu_assert("measure_presortedness: inversions should be exact",
+              p.inversions == inversions);
+    mu_assert("measure_presortedness: duplicates should be exact",
+              p.duplicates == duplicates);
+    mu_assert("measure_presortedness: max displacement should be exact",
+              p.max_displacement == max_displacement);
+    mu_assert("measure_presortedness: runs should cover array",
+              p.asc_runs + p.desc_runs > 0 && p.longest_run >= 2);
+  }
+
+  // Organ pipe: one ascending run, then one strictly descending run.
+  for (int i = 0; i < PRESORTED_TEST_SIZE; i++) {
+    arr[i] = (i < PRESORTED_TEST_SIZE / 2) ? i : PRESORTED_TEST_SIZE - i;
+  }
+  Presortedness p = measure_presortedness(arr, PRESORTED_TEST_SIZE,
+                                          sizeof(int), compare_ints);
+  mu_assert("measure_presortedness: should find one run of each kind",
+            p.asc_runs == 1 && p.desc_runs == 1
+            && p.longest_run == PRESORTED_TEST_SIZE / 2 + 1);
+  mu_assert("measure_presortedness: should not modify array",
+            arr[0] == 0 && arr[PRESORTED_TEST_SIZE - 1] == 1);
+
+  free(arr);
+  return 0;
+}
+
+static char*
+test_is_sorted()
+{
+  enum { SORTED_TEST_SIZE = 1000 };
+  int32_t* i32 = malloc(SORTED_TEST_SIZE * sizeof(int32_t));
+  uint64_t* u64 = malloc(SORTED_TEST_SIZE * sizeof(uint64_t));
+  double* f64 = malloc(SORTED_TEST_SIZE * sizeof(double));
+  for (int i = 0; i < SORTED_TEST_SIZE; i++) {
+    i32[i] = i / 2 - 100;
+    u64[i] = (uint64_t)i << 40;
+    f64[i] = i * 0.5;
+  }
+  mu_assert("is_sorted: empty and single element arrays are sorted",
+            is_sorted_i32(i32, 0) && is_sorted_i32(i32, 1)
+            && is_reverse_sorted_i32(i32, 1));
+  mu_assert("is_sorted: should accept non-descending arrays",
+            is_sorted_i32(i32, SORTED_TEST_SIZE)
+            && is_sorted_u64(u64, SORTED_TEST_SIZE)
+            && is_sorted_f64(f64, SORTED_TEST_SIZE)
+            && is_sorted(i32, SORTED_TEST_SIZE, sizeof(int), compare_ints));
+  mu_assert("is_reverse_sorted: should reject arrays with equal neighbours",
+            !is_reverse_sorted(i32, 2, sizeof(int), compare_ints));
+
+  // Break order at each side of a block boundary, and at the very end.
+  int breaks[4] = { SORTED_BLOCK_NELEMS - 1, SORTED_BLOCK_NELEMS,
+                    SORTED_BLOCK_NELEMS + 1, SORTED_TEST_SIZE - 1 };
+  for (int b = 0; b < 4; b++) {
+    int k = breaks[b];
+    int32_t saved = i32[k];
+    i32[k] = -1000;
+    mu_assert("is_sorted_i32: should find single out of order element",
+              !is_sorted_i32(i32, SORTED_TEST_SIZE)
+              && !is_sorted(i32, SORTED_TEST_SIZE, sizeof(int),
+                            compare_ints));
+    i32[k] = saved;
+  }
+
+  for (int i = 0; i < SORTED_TEST_SIZE; i++) {
+    i32[i] = SORTED_TEST_SIZE - i;
+    u64[i] = SORTED_TEST_SIZE - i;
+  }
+  mu_assert("is_reverse_sorted: should accept strictly descending arrays",
+            is_reverse_sorted_i32(i32, SORTED_TEST_SIZE)
+            && is_reverse_sorted_u64(u64, SORTED_TEST_SIZE)
+            && is_reverse_sorted(i32, SORTED_TEST_SIZE, sizeof(int),
+                                 compare_ints)
+            && !is_sorted_u64(u64, SORTED_TEST_SIZE));
+
+  free(i32);
+  free(u64);
+  free(f64);
+  return 0;
+}
+
+enum { SMALL_STACK_TEST_SIZE = 200000 };
+
+typedef struct SmallStackTest {
+  void (*sort)(void*, size_t, size_t, int (*compare)(const void*, const void*));
+  int* arr;
+} SmallStackTest;
+
+static void*
+small_stack_sort(void* arg)
+{
+  SmallStackTest* test = arg;
+  test->sort(test->arr, SMALL_STACK_TEST_SIZE, sizeof(int), compare_ints);
+  return NULL;
+}
+
+static char*
+test_sort_iterative_small_stack()
+{
+  SmallStackTest tests[2] = {
+    { quick_sort_iterative, NULL }, { merge_sort_iterative, NULL }
+  };
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, 64 * 1024);
+  for (int t = 0; t < 2; t++) {
+    // Organ pipe with duplicates, then random.
+    for (int input = 0; input < 2; input++) {
+      int* arr = malloc(SMALL_STACK_TEST_SIZE * sizeof(int));
+      for (int i = 0; i < SMALL_STACK_TEST_SIZE; i++) {
+        arr[i] = input == 0 ? (i < SMALL_STACK_TEST_SIZE / 2 
+                               ? i / 3 : (SMALL_STACK_TEST_SIZE - i) / 3)
+                            : rand();
+      }
+      tests[t].arr = arr;
+      pthread_t thread;
+      mu_assert("sort_iterative: should start thread with 64 KB stack",
+                pthread_create(&thread, &attr, small_stack_sort, 
+                               &tests[t]) == 0);
+      pthread_join(thread, NULL);
+      int sorted = 1;
+      for (int i = 1; i < SMALL_STACK_TEST_SIZE; i++) {
+        sorted &= arr[i - 1] <= arr[i];
+      }
+      mu_assert("sort_iterative: should sort on a 64 KB stack", sorted);
+      free(arr);
+    }
+  }
+  pthread_attr_destroy(&attr);
+  return 0;
+}
+
+static char*
+test_sort_precheck()
+{
+  enum { PRECHECK_TEST_SIZE = 2000 };
+  typedef void (*SortFn)(void*, size_t, size_t,
+                         int (*compare)(const void*, const void*));
+  SortFn sorts[7] = { insert_sort, binary_insert_sort, comb_sort, merge_sort,
+                      quick_sort, quick_sort_3way, timsort };
+  int* arr = malloc(PRECHECK_TEST_SIZE * sizeof(int));
+
+  sort_precheck_set(1);
+  mu_assert("sort_precheck_get: should be enabled", sort_precheck_get());
+  for (int s = 0; s < 7; s++) {
+    // Sorted, strictly descending, and descending with duplicates.
+    for (int input = 0; input < 3; input++) {
+      for (int i = 0; i < PRECHECK_TEST_SIZE; i++) {
+        arr[i] = input == 0 ? i
+                 : input == 1 ? PRECHECK_TEST_SIZE - i
+                 : (PRECHECK_TEST_SIZE - i) / 2;
+      }
+      sort_stats_reset();
+      sorts[s](arr, PRECHECK_TEST_SIZE, sizeof(int), compare_ints);
+      for (int i = 1; i < PRECHECK_TEST_SIZE; i++) {
+        mu_assert("sort_precheck: sorts should still sort",
+                  arr[i - 1] <= arr[i]);
+      }
+      if (sort_stats_enabled() && input < 2) {
+        mu_assert("sort_precheck: should take one comparison per pair",
+                  sort_stats_get().compares == PRECHECK_TEST_SIZE - 1);
+      }
+    }
+  }
+  sort_precheck_set(0);
+
+  free(arr);
+  return 0;
+}
+
+typedef struct CountingRecord {
+  int key;
+  int id;
+} CountingRecord;
+
+static int64_t
+counting_record_key(const void* record)
+{
+  return ((const CountingRecord*)record)->key;
+}
+
+static int
+compare_u16(const void* a, const void* b)
+{
+  uint16_t aval = *((const uint16_t*)a);
+  uint16_t bval = *((const uint16_t*)b);
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static int
+compare_counting_records(const void* a, const void* b)
+{
+  int akey = ((const CountingRecord*)a)->key;
+  int bkey = ((const CountingRecord*)b)->key;
+  return (akey < bkey) ? -1 : (akey > bkey);
+}
+
+static char*
+test_timsort_stable()
+{
+  enum { STABLE_TEST_SIZE = 100000 };
+  CountingRecord* records = malloc(STABLE_TEST_SIZE * sizeof(CountingRecord));
+  // Few unique keys, then long ascending runs which merges gallop through.
+  for (int t = 0; t < 2; t++) {
+    for (int i = 0; i < STABLE_TEST_SIZE; i++) {
+      records[i].key = t == 0 ? rand() % 10 : (i % 7919) / 16 + rand() % 2;
+      records[i].id = i;
+    }
+    timsort(records, STABLE_TEST_SIZE, sizeof(CountingRecord),
+            compare_counting_records);
+    int stable = 1;
+    for (int i = 1; i < STABLE_TEST_SIZE; i++) {
+      stable &= records[i - 1].key < records[i].key
+                || (records[i - 1].key == records[i].key
+                    && records[i - 1].id < records[i].id);
+    }
+    mu_assert("timsort: should sort stably", stable);
+  }
+  free(records);
+  return 0;
+}
+
+static char*
+test_merge_sort_tiled()
+{
+  // Sizes needing no, an even and an odd number of passes over whole tiles.
+  const size_t sizes[4] = { 5, 1000, 100000, 300000 };
+  const size_t passes[4] = { 0, 1, 3, 4 };
+  CountingRecord* records = malloc(sizes[3] * sizeof(CountingRecord));
+  for (int t = 0; t < 4; t++) {
+    for (size_t i = 0; i < sizes[t]; i++) {
+      records[i].key = rand() % 1000;
+      records[i].id = (int) i;
+    }
+    sort_stats_reset();
+    merge_sort_tiled(records, sizes[t], sizeof(CountingRecord),
+                     compare_counting_records);
+    int stable = 1;
+    for (size_t i = 1; i < sizes[t]; i++) {
+      stable &= records[i - 1].key < records[i].key
+                || (records[i - 1].key == records[i].key
+                    && records[i - 1].id < records[i].id);
+    }
+    mu_assert("merge_sort_tiled: should sort stably", stable);
+    if (sort_stats_enabled()) {
+      mu_assert("merge_sort_tiled: should count passes over array",
+                sort_stats_get().merge_passes == passes[t]);
+    }
+  }
+  free(records);
+  return 0;
+}
+
+static size_t sort_step_compares = 0;
+
+static int
+compare_counting_records_counted(const void* a, const void* b)
+{
+  sort_step_compares++;
+  return compare_counting_records(a, b);
+}
+
+static char*
+test_sort_step()
+{
+  enum { STEP_TEST_SIZE = 100000, STEP_TEST_BUDGET = 100 };
+  const size_t sizes[4] = { 0, 1, 50, STEP_TEST_SIZE };
+  CountingRecord* records[2];
+  for (int r = 0; r < 2; r++) {
+    records[r] = malloc(STEP_TEST_SIZE * sizeof(CountingRecord));
+  }
+  for (int t = 0; t < 4; t++) {
+    // Random keys with duplicates, and runs both ascending and descending.
+    SortStepState* states[2];
+    for (int r = 0; r < 2; r++) {
+      for (size_t i = 0; i < sizes[t]; i++) {
+        records[r][i].key = r == 0 ? rand() % 1000 
+                            : (int)((i / 5000) % 2 ? i % 5000
+                                                   : 5000 - i % 5000);
+        records[r][i].id = (int) i;
+      }
+      states[r] = sort_step_init(records[r], sizes[t], sizeof(CountingRecord),
+                                 compare_counting_records_counted);
+    }
+    // Interleave both sorts, as an event loop would.
+    int done[2] = { 0, 0 };
+    size_t max_step = 0;
+    while (!done[0] || !done[1]) {
+      for (int r = 0; r < 2; r++) {
+        sort_step_compares = 0;
+        done[r] = sort_step(states[r], STEP_TEST_BUDGET);
+        max_step = sort_step_compares > max_step ? sort_step_compares 
+                                                 : max_step;
+      }
+    }
+    mu_assert("sort_step: should bound comparisons per step",
+              max_step <= STEP_TEST_BUDGET + 64);
+    for (int r = 0; r < 2; r++) {
+      int stable = 1;
+      for (size_t i = 1; i < sizes[t]; i++) {
+        stable &= records[r][i - 1].key < records[r][i].key
+                  || (records[r][i - 1].key == records[r][i].key
+                      && records[r][i - 1].id < records[r][i].id);
+      }
+      mu_assert("sort_step: should sort stably", stable);
+      mu_assert("sort_step: should stay done", sort_step(states[r], 1) == 1);
+      sort_step_free(&states[r]);
+    }
+  }
+
+  // Abandoned part-way, the array is still a permutation of the input.
+  int* arr = malloc(STEP_TEST_SIZE * sizeof(int));
+  int* def = malloc(STEP_TEST_SIZE * sizeof(int));
+  for (int i = 0; i < STEP_TEST_SIZE; i++) {
+    arr[i] = def[i] = rand();
+  }
+  SortStepState* state = sort_step_init(arr, STEP_TEST_SIZE, sizeof(int),
+                                        compare_ints);
+  mu_assert("sort_step: should not finish within small budget",
+            sort_step(state, 100000) == 0);
+  sort_step_free(&state);
+  mu_assert("sort_step_free: should reset state", state == NULL);
+  qsort(arr, STEP_TEST_SIZE, sizeof(int), compare_ints);
+  qsort(def, STEP_TEST_SIZE, sizeof(int), compare_ints);
+  mu_assert("sort_step: should leave permutation of input",
+            memcmp(arr, def, STEP_TEST_SIZE * sizeof(int)) == 0);
+  free(arr);
+  free(def);
+  for (int r = 0; r < 2; r++) {
+    free(records[r]);
+  }
+  return 0;
+}
+
+static SortControl sort_control_test;
+static size_t sort_control_compares = 0;
+
+static int
+compare_ints_cancelling(const void* a, const void* b)
+{
+  if (++sort_control_compares == 100000) {
+    sort_control_cancel(&sort_control_test);
+  }
+  return compare_ints(a, b);
+}
+
+static char*
+test_sort_control()
+{
+  enum { CONTROL_TEST_SIZE = 200000 };
+  typedef SortStatus (*SortCtlFn)(void*, size_t, size_t,
+                                  int (*compare)(const void*, const void*),
+                                  const SortControl*);
+  SortCtlFn sorts[3] = { quick_sort_ctl, merge_sort_ctl, timsort_ctl };
+  int* tst = malloc(CONTROL_TEST_SIZE * sizeof(int));
+  int* def = malloc(CONTROL_TEST_SIZE * sizeof(int));
+  for (int t = 0; t < 3; t++) {
+    for (int i = 0; i < CONTROL_TEST_SIZE; i++) {
+      tst[i] = def[i] = rand();
+    }
+    // Fired before the sort starts: array untouched.
+    sort_control_init(&sort_control_test);
+    sort_control_test.deadline_ns = 1;
+    mu_assert("sort_ctl: should stop at past deadline",
+              sorts[t](tst, CONTROL_TEST_SIZE, sizeof(int), compare_ints,
+                       &sort_control_test) == SORT_DEADLINE_EXCEEDED
+              && memcmp(tst, def, CONTROL_TEST_SIZE * sizeof(int)) == 0);
+
+    // Cancelled part-way: stops within about one pass, leaving a permutation.
+    sort_control_init(&sort_control_test);
+    sort_control_compares = 0;
+    mu_assert("sort_ctl: should stop when cancelled",
+              sorts[t](tst, CONTROL_TEST_SIZE, sizeof(int),
+                       compare_ints_cancelling, &sort_control_test)
+              == SORT_CANCELLED);
+    mu_assert("sort_ctl: should stop soon after cancel",
+              sort_control_compares < 100000 + 2 * CONTROL_TEST_SIZE);
+    qsort(tst, CONTROL_TEST_SIZE, sizeof(int), compare_ints);
+    qsort(def, CONTROL_TEST_SIZE, sizeof(int), compare_ints);
+    mu_assert("sort_ctl: should leave permutation of input",
+              memcmp(tst, def, CONTROL_TEST_SIZE * sizeof(int)) == 0);
+
+    for (int i = 0; i < CONTROL_TEST_SIZE; i++) {
+      tst[i] = def[i] = rand();
+    }
+    sort_control_init(&sort_control_test);
+    sort_control_set_timeout(&sort_control_test, 3600000000000ULL);
+    mu_assert("sort_ctl: should sort before deadline",
+              sorts[t](tst, CONTROL_TEST_SIZE, sizeof(int), compare_ints,
+                       &sort_control_test) == SORT_OK
+              && sorts[t](def, CONTROL_TEST_SIZE, sizeof(int), compare_ints,
+                          NULL) == SORT_OK
+              && is_sorted(tst, CONTROL_TEST_SIZE, sizeof(int), compare_ints)
+              && memcmp(tst, def, CONTROL_TEST_SIZE * sizeof(int)) == 0);
+  }
+  free(tst);
+  free(def);
+  return 0;
+}
+
+static char*
+test_cosort()
+{
+  enum { COSORT_TEST_SIZE = 100000 };
+  int* keys = malloc(COSORT_TEST_SIZE * sizeof(int));
+  int* ids = malloc(COSORT_TEST_SIZE * sizeof(int));
+  double* values = malloc(COSORT_TEST_SIZE * sizeof(double));
+  char (*names)[12] = malloc(COSORT_TEST_SIZE * sizeof(*names));
+  for (int i = 0; i < COSORT_TEST_SIZE; i++) {
+    keys[i] = rand() % 1000;
+    ids[i] = i;
+    values[i] = keys[i] * 0.5 + i;
+    snprintf(names[i], sizeof(*names), "n%d", i);
+  }
+  void* payloads[3] = { ids, values, names };
+  const size_t sizes[3] = { sizeof(int), sizeof(double), sizeof(*names) };
+  cosort(keys, COSORT_TEST_SIZE, sizeof(int), compare_ints, payloads, sizes,
+         3);
+  int ok = 1;
+  for (int i = 0; i < COSORT_TEST_SIZE; i++) {
+    char name[12];
+    snprintf(name, sizeof(name), "n%d", ids[i]);
+    ok &= values[i] == keys[i] * 0.5 + ids[i] && strcmp(names[i], name) == 0;
+    if (i > 0) {
+      ok &= keys[i - 1] < keys[i]
+            || (keys[i - 1] == keys[i] && ids[i - 1] < ids[i]);
+    }
+  }
+  mu_assert("cosort: should sort keys stably, carrying payloads along", ok);
+  cosort(keys, 0, sizeof(int), compare_ints, payloads, sizes, 3);
+  free(keys);
+  free(ids);
+  free(values);
+  free(names);
+  return 0;
+}
+
+typedef struct OrderByRecord {
+  int32_t a;
+  double b;
+  const char* s;
+  int64_t c;
+  uint8_t b_null;
+  int id;
+} OrderByRecord;
+
+static void
+fill_order_by_records(OrderByRecord* records, int nelems,
+                      const char* const* words, int nwords)
+{
+  for (int i = 0; i < nelems; i++) {
+    // Few distinct values per key, so that later keys break many ties.
+    records[i].a = rand() % 7 - 3;
+    records[i].b = (rand() % 5 - 2) * 0.5;
+    records[i].b_null = rand() % 6 == 0;
+    records[i].s = rand() % 6 == 0 ? NULL : words[rand() % nwords];
+    records[i].c = (int64_t)(rand() % 3 - 1) * ((int64_t) 1 << 40);
+    records[i].id = i;
+  }
+}
+
+static char*
+test_order_by()
+{
+  enum { ORDER_BY_TEST_SIZE = 50000 };
+  static const char* words[5] = { "pear", "apple", "fig", "apricot", "plum" };
+  const SortKeySpec fixed[3] = {
+    { offsetof(OrderByRecord, a), SORT_KEY_I32, SORT_KEY_ASC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL },
+    { offsetof(OrderByRecord, b), SORT_KEY_F64, SORT_KEY_DESC,
+      SORT_KEY_NULLS_FIRST, offsetof(OrderByRecord, b_null) },
+    { offsetof(OrderByRecord, c), SORT_KEY_I64, SORT_KEY_ASC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL }
+  };
+  const SortKeySpec mixed[3] = {
+    { offsetof(OrderByRecord, s), SORT_KEY_STR, SORT_KEY_DESC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL },
+    fixed[1],
+    { offsetof(OrderByRecord, a), SORT_KEY_I32, SORT_KEY_DESC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL }
+  };
+  const SortKeySpec* specs[2] = { fixed, mixed };
+  OrderByRecord* records = malloc(ORDER_BY_TEST_SIZE * sizeof(OrderByRecord));
+  for (int t = 0; t < 2; t++) {
+    fill_order_by_records(records, ORDER_BY_TEST_SIZE, words, 5);
+    order_by(records, ORDER_BY_TEST_SIZE, sizeof(OrderByRecord), specs[t],
+             3);
+    int ordered = 1;
+    for (int i = 1; i < ORDER_BY_TEST_SIZE; i++) {
+      int cmp = order_by_compare(&records[i - 1], &records[i], specs[t], 3);
+      ordered &= cmp < 0 || (cmp == 0 && records[i - 1].id < records[i].id);
+      if (t == 0) {
+        ordered &= records[i - 1].a <= records[i].a;
+      } else {
+        ordered &= records[i].s == NULL
+                   || (records[i - 1].s != NULL
+                       && strcmp(records[i - 1].s, records[i].s) >= 0);
+      }
+    }
+    mu_assert("order_by: should sort stably by every key", ordered);
+  }
+  free(records);
+  return 0;
+}
+
+static char*
+test_normkey()
+{
+  enum { NORMKEY_TEST_SIZE = 20000 };
+  // Long common prefixes, so that normalized keys are truncated.
+  static const char* words[6] = {
+    "transaction-record-beta", "transaction-record-alpha", "transaction-rec",
+    "transaction-recor", "", "zebra"
+  };
+  const SortKeySpec asc[3] = {
+    { offsetof(OrderByRecord, s), SORT_KEY_STR, SORT_KEY_ASC,
+      SORT_KEY_NULLS_FIRST, ORDER_BY_NOT_NULL, 0 },
+    { offsetof(OrderByRecord, b), SORT_KEY_F64, SORT_KEY_DESC,
+      SORT_KEY_NULLS_LAST, offsetof(OrderByRecord, b_null), 0 },
+    { offsetof(OrderByRecord, a), SORT_KEY_I32, SORT_KEY_ASC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL, 0 }
+  };
+  const SortKeySpec desc[3] = {
+    { offsetof(OrderByRecord, a), SORT_KEY_I32, SORT_KEY_DESC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL, 0 },
+    { offsetof(OrderByRecord, s), SORT_KEY_STR, SORT_KEY_DESC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL, 4 },
+    { offsetof(OrderByRecord, c), SORT_KEY_I64, SORT_KEY_ASC,
+      SORT_KEY_NULLS_LAST, ORDER_BY_NOT_NULL, 0 }
+  };
+  const SortKeySpec* specs[2] = { asc, desc };
+  OrderByRecord* records = malloc(NORMKEY_TEST_SIZE * sizeof(OrderByRecord));
+  for (int t = 0; t < 2; t++) {
+    const size_t width = normkey_width(specs[t], 3);
+    unsigned char* prev = malloc(width);
+    unsigned char* next = malloc(width);
+    fill_order_by_records(records, NORMKEY_TEST_SIZE, words, 6);
+    normkey_sort(records, NORMKEY_TEST_SIZE, sizeof(OrderByRecord), specs[t],
+                 3);
+    int ordered = 1;
+    int consistent = 1;
+    int exact = normkey_encode(specs[t], 3, &records[0], prev);
+    for (int i = 1; i < NORMKEY_TEST_SIZE; i++) {
+      int cmp = order_by_compare(&records[i - 1], &records[i], specs[t], 3);
+      ordered &= cmp < 0 || (cmp == 0 && records[i - 1].id < records[i].id);
+      // Encodings never contradict the order, and decide it when exact.
+      const int next_exact = normkey_encode(specs[t], 3, &records[i], next);
+      const int bytes = memcmp(prev, next, width);
+      consistent &= bytes <= 0;
+      if (exact && next_exact) {
+        consistent &= (bytes < 0) == (cmp < 0);
+      }
+      memcpy(prev, next, width);
+      exact = next_exact;
+    }
+    mu_assert("normkey_sort: should sort stably by every key", ordered);
+    mu_assert("normkey_encode: memcmp should agree with order_by_compare",
+              consistent);
+    free(prev);
+    free(next);
+  }
+  free(records);
+  return 0;
+}
+
+typedef struct PrefixSortRecord {
+  char name[24];
+  int id;
+  char payload[100];
+} PrefixSortRecord;
+
+static size_t prefix_sort_compares = 0;
+
+static int
+compare_prefix_sort_record(const void* a, const void* b)
+{
+  prefix_sort_compares++;
+  return strcmp(((const PrefixSortRecord*) a)->name,
+                ((const PrefixSortRecord*) b)->name);
+}
+
+static uint64_t
+prefix_sort_record_prefix(const void* elem)
+{
+  return prefix_sort_str(((const PrefixSortRecord*) elem)->name);
+}
+
+static char*
+test_prefix_sort()
+{
+  enum { PREFIX_SORT_TEST_SIZE = 20000 };
+  PrefixSortRecord* records = calloc(PREFIX_SORT_TEST_SIZE,
+                                     sizeof(PrefixSortRecord));
+  for (int t = 0; t < 2; t++) {
+    for (int i = 0; i < PREFIX_SORT_TEST_SIZE; i++) {
+      if (t == 0) {
+        // Distinct names which fit in prefixes are never compared.
+        snprintf(records[i].name, sizeof(records[i].name), "%07d",
+                 (int)((i * 7919L) % PREFIX_SORT_TEST_SIZE));
+      } else {
+        // Every prefix is "customer".
+        snprintf(records[i].name, sizeof(records[i].name), "customer-%d",
+                 rand() % 1000);
+      }
+      records[i].id = i;
+      records[i].payload[0] = (char) i;
+    }
+    prefix_sort_compares = 0;
+    prefix_sort(records, PREFIX_SORT_TEST_SIZE, sizeof(PrefixSortRecord),
+                compare_prefix_sort_record, prefix_sort_record_prefix);
+    int ordered = 1;
+    for (int i = 1; i < PREFIX_SORT_TEST_SIZE; i++) {
+      int cmp = strcmp(records[i - 1].name, records[i].name);
+      ordered &= cmp < 0 || (cmp == 0 && records[i - 1].id < records[i].id);
+      ordered &= records[i].payload[0] == (char) records[i].id;
+    }
+    mu_assert("prefix_sort: should sort stably", ordered);
+    if (t == 0) {
+      mu_assert("prefix_sort: should only compare equal prefixes",
+                prefix_sort_compares == 0);
+    }
+  }
+  mu_assert("prefix_sort_str: should pad short strings with zeros",
+            prefix_sort_str("ab") == 0x6162000000000000ULL
+            && prefix_sort_str("abcdefghij") == 0x6162636465666768ULL);
+  free(records);
+  return 0;
+}
+
+typedef struct SortByKeyRecord {
+  char stamp[12];
+  char amount[12];
+  int id;
+} SortByKeyRecord;
+
+static size_t sort_by_key_calls = 0;
+
+static void
+sort_by_key_stamp(const void* elem, void* key)
+{
+  // "HH:MM:SS" as seconds since midnight.
+  const char* stamp = ((const SortByKeyRecord*) elem)->stamp;
+  uint32_t seconds = (uint32_t)(atoi(stamp) * 3600 + atoi(stamp + 3) * 60
+                                + atoi(stamp + 6));
+  memcpy(key, &seconds, sizeof(seconds));
+  sort_by_key_calls++;
+}
+
+static void
+sort_by_key_stamp_bytes(const void* elem, void* key)
+{
+  // "HH:MM:SS" and its terminator, a 9 byte key in memcmp() order.
+  memcpy(key, ((const SortByKeyRecord*) elem)->stamp, 9);
+  sort_by_key_calls++;
+}
+
+static void
+sort_by_key_amount(const void* elem, void* key)
+{
+  double amount = strtod(((const SortByKeyRecord*) elem)->amount, NULL);
+  memcpy(key, &amount, sizeof(amount));
+  sort_by_key_calls++;
+}
+
+static int
+compare_sort_by_key_amount(const void* a, const void* b)
+{
+  double aval, bval;
+  memcpy(&aval, a, sizeof(aval));
+  memcpy(&bval, b, sizeof(bval));
+  return (aval < bval) ? -1 : (aval > bval);
+}
+
+static char*
+test_sort_by_key()
+{
+  enum { SORT_BY_KEY_TEST_SIZE = 20000 };
+  SortByKeyRecord* records = malloc(SORT_BY_KEY_TEST_SIZE
+                                    * sizeof(SortByKeyRecord));
+  // Integer keys, keys with a comparison function, byte string keys.
+  for (int t = 0; t < 3; t++) {
+    for (int i = 0; i < SORT_BY_KEY_TEST_SIZE; i++) {
+      snprintf(records[i].stamp, sizeof(records[i].stamp), "%02d:%02d:%02d",
+               rand() % 24, rand() % 60, rand() % 60);
+      snprintf(records[i].amount, sizeof(records[i].amount), "%.2f",
+               (rand() % 2000 - 1000) / 4.0);
+      records[i].id = i;
+    }
+    sort_by_key_calls = 0;
+    if (t == 0) {
+      sort_by_key(records, SORT_BY_KEY_TEST_SIZE, sizeof(SortByKeyRecord),
+                  sort_by_key_stamp, sizeof(uint32_t), NULL);
+    } else if (t == 1) {
+      sort_by_key(records, SORT_BY_KEY_TEST_SIZE, sizeof(SortByKeyRecord),
+                  sort_by_key_amount, sizeof(double),
+                  compare_sort_by_key_amount);
+    } else {
+      sort_by_key(records, SORT_BY_KEY_TEST_SIZE, sizeof(SortByKeyRecord),
+                  sort_by_key_stamp_bytes, 9, NULL);
+    }
+    mu_assert("sort_by_key: should compute each key once",
+              sort_by_key_calls == SORT_BY_KEY_TEST_SIZE);
+    int ordered = 1;
+    for (int i = 1; i < SORT_BY_KEY_TEST_SIZE; i++) {
+      int cmp;
+      if (t != 1) {
+        cmp = strcmp(records[i - 1].stamp, records[i].stamp);
+      } else {
+        double prev = strtod(records[i - 1].amount, NULL);
+        double next = strtod(records[i].amount, NULL);
+        cmp = (prev < next) ? -1 : (prev > next);
+      }
+      ordered &= cmp < 0 || (cmp == 0 && records[i - 1].id < records[i].id);
+    }
+    mu_assert("sort_by_key: should sort stably by key", ordered);
+  }
+  free(records);
+  return 0;
+}
+
+typedef struct ListSortNode {
+  int key;
+  int id;
+  struct ListSortNode* next;
+} ListSortNode;
+
+static int
+compare_list_nodes(const void* a, const void* b)
+{
+  int akey = ((const ListSortNode*)a)->key;
+  int bkey = ((const ListSortNode*)b)->key;
+  return (akey < bkey) ? -1 : (akey > bkey);
+}
+
+static char*
+test_list_sort()
+{
+  enum { LIST_TEST_SIZE = 50000 };
+  ListSortNode* nodes = malloc(LIST_TEST_SIZE * sizeof(ListSortNode));
+  mu_assert("list_sort: empty list should stay empty",
+            list_sort(NULL, offsetof(ListSortNode, next),
+                      compare_list_nodes) == NULL);
+  // Random, sorted, descending, and runs going both ways.
+  for (int input = 0; input < 4; input++) {
+    for (int i = 0; i < LIST_TEST_SIZE; i++) {
+      nodes[i].key = input == 0 ? rand() % 1000
+                     : input == 1 ? i / 3
+                     : input == 2 ? (LIST_TEST_SIZE - i) / 3
+                     : ((i / 100) % 2 ? -(i % 100) : i % 100);
+      nodes[i].id = i;
+      nodes[i].next = (i + 1 < LIST_TEST_SIZE) ? &nodes[i + 1] : NULL;
+    }
+    ListSortNode* head = list_sort(&nodes[0], offsetof(ListSortNode, next),
+                                   compare_list_nodes);
+    int count = 0;
+    int stable = 1;
+    for (ListSortNode* node = head; node != NULL; node = node->next) {
+      if (node->next != NULL) {
+        stable &= node->key < node->next->key
+                  || (node->key == node->next->key 
+                      && node->id < node->next->id);
+      }
+      count++;
+    }
+    mu_assert("list_sort: should sort stably", stable);
+    mu_assert("list_sort: should keep every node", count == LIST_TEST_SIZE);
+  }
+  free(nodes);
+
+  int values[100];
+  Stack* stack = stack_init();
+  for (int i = 0; i < 100; i++) {
+    values[i] = (i * 37) % 100;
+    stack_push(stack, &values[i]);
+  }
+  stack_sort(stack, compare_ints);
+  for (int i = 0; i < 100; i++) {
+    mu_assert("stack_sort: should pop data in ascending order",
+              *(int*)stack_pop_return(stack) == i);
+  }
+  mu_assert("stack_sort: should keep every frame", stack->len == 0);
+  stack_free(&stack);
+  return 0;
+}
+
+static char*
+test_sample_sort_parallel()
+{
+  enum { SAMPLE_TEST_SIZE = 300007 };
+  int* tst = malloc(SAMPLE_TEST_SIZE * sizeof(int));
+  int* def = malloc(SAMPLE_TEST_SIZE * sizeof(int));
+  // Random and few unique values, on 1 and 4 threads, then below the cutoff,
+  // then all equal values.
+  for (int t = 0; t < 6; t++) {
+    const int nelems = t != 4 ? SAMPLE_TEST_SIZE : SAMPLE_SORT_MIN_NELEMS - 1;
+    for (int i = 0; i < nelems; i++) {
+      tst[i] = def[i] = t == 5 ? 42 : (t % 2 == 0) ? rand() : rand() % 7;
+    }
+    sample_sort_parallel(tst, nelems, sizeof(int), compare_ints, 
+                         t < 2 ? 1 : 4);
+    qsort(def, nelems, sizeof(int), compare_ints);
+    mu_assert("sample_sort_parallel: should match qsort",
+              memcmp(tst, def, nelems * sizeof(int)) == 0);
+  }
+  free(tst);
+  free(def);
+  return 0;
+}
+
+static char*
+test_segmented_sort()
+{
+  enum { SEGMENTED_TEST_SEGMENTS = 5000 };
+  size_t* offsets = malloc((SEGMENTED_TEST_SEGMENTS + 1) * sizeof(size_t));
+  offsets[0] = 0;
+  for (int s = 0; s < SEGMENTED_TEST_SEGMENTS; s++) {
+    // Mostly empty to tiny segments, a few long ones.
+    size_t len = (s % 500 == 7) ? 5000 + rand() % 5000 : rand() % 40;
+    offsets[s + 1] = offsets[s] + len;
+  }
+  const size_t nelems = offsets[SEGMENTED_TEST_SEGMENTS];
+  int* tst = malloc(nelems * sizeof(int));
+  int* def = malloc(nelems * sizeof(int));
+  for (int t = 0; t < 2; t++) {
+    for (size_t i = 0; i < nelems; i++) {
+      tst[i] = def[i] = rand() % 1000;
+    }
+    segmented_sort_parallel(tst, sizeof(int), compare_ints, offsets,
+                            SEGMENTED_TEST_SEGMENTS, t == 0 ? 1 : 4);
+    for (int s = 0; s < SEGMENTED_TEST_SEGMENTS; s++) {
+      qsort(def + offsets[s], offsets[s + 1] - offsets[s], sizeof(int),
+            compare_ints);
+    }
+    mu_assert("segmented_sort_parallel: should sort each segment alone",
+              memcmp(tst, def, nelems * sizeof(int)) == 0);
+  }
+  segmented_sort(tst, sizeof(int), compare_ints, offsets, 0);
+  free(offsets);
+  free(tst);
+  free(def);
+  return 0;
+}
+
+static int sort_job_gate = 0;
+static int sort_job_order[3];
+static int sort_job_finished = 0;
+
+static int
+compare_ints_gated(const void* a, const void* b)
+{
+  while (!__atomic_load_n(&sort_job_gate, __ATOMIC_ACQUIRE)) {
+  }
+  return compare_ints(a, b);
+}
+
+static void
+sort_job_record(const SortJob* job, SortJobStatus status)
+{
+  int slot = __atomic_fetch_add(&sort_job_finished, 1, __ATOMIC_RELAXED);
+  if (slot < 3) {
+    sort_job_order[slot] = status == SORT_JOB_DONE ? *(int*)job->ctx : -1;
+  }
+}
+
+static char*
+test_sort_job()
+{
+  enum { JOB_TEST_JOBS = 64, JOB_TEST_SIZE = 1000 };
+  SortPool* pool = sort_pool_init(2);
+  mu_assert("sort_pool_init: should start workers", pool != NULL);
+
+  // Many small jobs submitted together, across algorithms.
+  typedef void (*SortFn)(void*, size_t, size_t,
+                         int (*compare)(const void*, const void*));
+  SortFn sorts[3] = { quick_sort, timsort, merge_sort_tiled };
+  int* arrs = malloc(JOB_TEST_JOBS * JOB_TEST_SIZE * sizeof(int));
+  SortJob jobs[JOB_TEST_JOBS];
+  SortJobHandle* handles[JOB_TEST_JOBS];
+  for (int j = 0; j < JOB_TEST_JOBS; j++) {
+    for (int i = 0; i < JOB_TEST_SIZE; i++) {
+      arrs[j * JOB_TEST_SIZE + i] = rand();
+    }
+    jobs[j] = (SortJob){ sorts[j % 3], arrs + j * JOB_TEST_SIZE, JOB_TEST_SIZE,
+                         sizeof(int), compare_ints, j % SORT_JOB_NPRIORITIES,
+                         NULL, NULL };
+  }
+  sort_submit_batch(pool, jobs, JOB_TEST_JOBS, handles);
+  for (int j = 0; j < JOB_TEST_JOBS; j++) {
+    mu_assert("sort_wait: should finish job", 
+              sort_wait(handles[j]) == SORT_JOB_DONE
+              && sort_poll(handles[j]) == SORT_JOB_DONE);
+    int sorted = 1;
+    for (int i = 1; i < JOB_TEST_SIZE; i++) {
+      sorted &= arrs[j * JOB_TEST_SIZE + i - 1] <= arrs[j * JOB_TEST_SIZE + i];
+    }
+    mu_assert("sort_submit_batch: should sort every array", sorted);
+    sort_handle_free(&handles[j]);
+  }
+  sort_pool_free(&pool);
+  mu_assert("sort_pool_free: pool pointer should be NULL", pool == NULL);
+
+  // One worker, held up by a gated job: queued jobs can be cancelled, and
+  // run by priority once the gate opens.
+  pool = sort_pool_init(1);
+  int ids[4] = { 0, 1, 2, 3 };
+  SortJob gated = { insert_sort, arrs, 10, sizeof(int), compare_ints_gated,
+                    SORT_JOB_NORMAL, sort_job_record, &ids[0] };
+  SortJobHandle* first = sort_submit(pool, &gated);
+  while (sort_poll(first) == SORT_JOB_QUEUED) {
+  }
+  SortJob low = { quick_sort, arrs + JOB_TEST_SIZE, JOB_TEST_SIZE,
+                  sizeof(int), compare_ints, SORT_JOB_LOW, sort_job_record,
+                  &ids[1] };
+  SortJob high = low;
+  high.priority = SORT_JOB_HIGH;
+  high.arr = arrs + 2 * JOB_TEST_SIZE;
+  high.ctx = &ids[2];
+  SortJob doomed = high;
+  doomed.arr = arrs + 3 * JOB_TEST_SIZE;
+  doomed.ctx = &ids[3];
+  SortJobHandle* low_handle = sort_submit(pool, &low);
+  SortJobHandle* doomed_handle = sort_submit(pool, &doomed);
+  SortJobHandle* high_handle = sort_submit(pool, &high);
+  mu_assert("sort_cancel: should cancel queued job",
+            sort_cancel(doomed_handle) == 1
+            && sort_poll(doomed_handle) == SORT_JOB_CANCELLED);
+  mu_assert("sort_cancel: should not cancel running job",
+            sort_cancel(first) == 0);
+  __atomic_store_n(&sort_job_gate, 1, __ATOMIC_RELEASE);
+  sort_wait(low_handle);
+  mu_assert("sort_submit: higher priority job should run first",
+            sort_job_order[0] == -1 && sort_job_order[1] == 0
+            && sort_job_order[2] == 2);
+  mu_assert("sort_wait: all jobs should be finished",
+            sort_wait(first) == SORT_JOB_DONE 
+            && sort_wait(high_handle) == SORT_JOB_DONE);
+  sort_handle_free(&first);
+  sort_handle_free(&low_handle);
+  sort_handle_free(&doomed_handle);
+  sort_handle_free(&high_handle);
+  sort_pool_free(&pool);
+  free(arrs);
+  return 0;
+}
+
+static char*
+test_counting_sort()
+{
+  enum { COUNTING_TEST_SIZE = 100003 };
+  char* tst = malloc(COUNTING_TEST_SIZE);
+  char* def = malloc(COUNTING_TEST_SIZE);
+  for (int i = 0; i < COUNTING_TEST_SIZE; i++) {
+    // Runs of equal bytes, then random bytes (including negative chars).
+    tst[i] = def[i] = (i < COUNTING_TEST_SIZE / 2) ? i / 1000 : rand();
+  }
+  counting_sort_u8((uint8_t*) tst, COUNTING_TEST_SIZE);
+  qsort(def, COUNTING_TEST_SIZE, sizeof(char), compare_chars);
+  mu_assert("counting_sort_u8: should match qsort",
+            memcmp(tst, def, COUNTING_TEST_SIZE) == 0);
+
+  uint16_t* u16 = malloc(COUNTING_TEST_SIZE * sizeof(uint16_t));
+  uint16_t* u16_def = malloc(COUNTING_TEST_SIZE * sizeof(uint16_t));
+  for (int i = 0; i < COUNTING_TEST_SIZE; i++) {
+    u16[i] = u16_def[i] = rand();
+  }
+  counting_sort_u16(u16, COUNTING_TEST_SIZE);
+  qsort(u16_def, COUNTING_TEST_SIZE, sizeof(uint16_t), compare_u16);
+  mu_assert("counting_sort_u16: should match qsort",
+            memcmp(u16, u16_def, COUNTING_TEST_SIZE * sizeof(uint16_t)) == 0);
+
+  CountingRecord* records = malloc(COUNTING_TEST_SIZE * sizeof(CountingRecord));
+  for (int i = 0; i < COUNTING_TEST_SIZE; i++) {
+    records[i].key = rand() % 101 - 50;
+    records[i].id = i;
+  }
+  mu_assert("counting_sort_range: should reject keys outside range",
+            counting_sort_range(records, COUNTING_TEST_SIZE,
+                                sizeof(CountingRecord), counting_record_key,
+                                -10, 10) == 0
+            && records[0].id == 0);
+  mu_assert("counting_sort_range: should reject ranges which are too wide",
+            counting_sort_range(records, COUNTING_TEST_SIZE,
+                                sizeof(CountingRecord), counting_record_key,
+                                INT64_MIN, INT64_MAX) == 0);
+  mu_assert("counting_sort_range: should sort keys within range",
+            counting_sort_range(records, COUNTING_TEST_SIZE,
+                                sizeof(CountingRecord), counting_record_key,
+                                -50, 50) == 1);
+  for (int i = 1; i < COUNTING_TEST_SIZE; i++) {
+    mu_assert("counting_sort_range: should sort stably",
+              records[i - 1].key < records[i].key
+              || (records[i - 1].key == records[i].key
+                  && records[i - 1].id < records[i].id));
+  }
+
+  free(tst);
+  free(def);
+  free(u16);
+  free(u16_def);
+  free(records);
+  return 0;
+}
+
+static char*
+test_sort_tuning()
+{
+  enum { TUNING_TEST_SIZE = 5000 };
+  typedef void (*SortFn)(void*, size_t, size_t,
+                         int (*compare)(const void*, const void*));
+  SortFn sorts[4] = { comb_sort, merge_sort, quick_sort, timsort };
+
+  const size_t size_class = sort_tuning_class(sizeof(int));
+  mu_assert("sort_tuning_class: int should share class with 3-byte elements",
+            size_class == sort_tuning_class(3));
+  const SortTuning saved = *sort_tuning_get(sizeof(int));
+
+  // Extreme (but legal) values, and values which must be clamped.
+  SortTuning tunings[2] = { { 1, 1, 2, 1.05 }, { 0, 0, 0, 0.5 } };
+  int* arr = malloc(TUNING_TEST_SIZE * sizeof(int));
+  for (int t = 0; t < 2; t++) {
+    sort_tuning_set(size_class, &tunings[t]);
+    const SortTuning* tuning = sort_tuning_get(sizeof(int));
+    mu_assert("sort_tuning_set: values should be clamped to valid range",
+              tuning->length_threshold >= 1 && tuning->min_gallop >= 1
+              && tuning->timsort_min_nelems >= 2 && tuning->comb_shrink > 1);
+    for (int s = 0; s < 4; s++) {
+      for (int i = 0; i < TUNING_TEST_SIZE; i++) {
+        arr[i] = (i % 3 == 0) ? i : (i * 7919) % 1013;
+      }
+      sorts[s](arr, TUNING_TEST_SIZE, sizeof(int), compare_ints);
+      for (int i = 1; i < TUNING_TEST_SIZE; i++) {
+        mu_assert("sort_tuning_set: sorts should remain correct",
+                  arr[i - 1] <= arr[i]);
+      }
+    }
+  }
+
+  sort_tuning_set(size_class, &saved);
+  free(arr);
+  return 0;
+}
 
 static char* all_tests() {
   // Stack
@@ -556,9 +2021,8 @@ static char* all_tests() {
   mu_run_test(test_stack_pop_nonempty_stack);
   mu_run_test(test_stack_pop_return_nonempty_stack);
   mu_run_test(test_stack_free);
-
-  // Helpers
-  //mu_run_test(test_bin_search_loc);
+  mu_run_test(test_stack_pool);
+  mu_run_test(test_concurrent_stack);
 
   // Sorts
   mu_run_test_on_arg(test_sort_no_bounds, insert_sort, "insert_sort");
@@ -567,12 +2031,57 @@ static char* all_tests() {
   mu_run_test_on_arg(test_sort_no_bounds, select_sort, "select_sort");
   mu_run_test_on_arg(test_sort_no_bounds, comb_sort, "comb_sort");
   mu_run_test_on_arg(test_sort_no_bounds, merge_sort, "merge_sort");
+  mu_run_test_on_arg(test_sort_no_bounds, merge_sort_iterative, 
+                     "merge_sort_iterative");
+  mu_run_test_on_arg(test_sort_no_bounds, merge_sort_tiled, 
+                     "merge_sort_tiled");
   mu_run_test_on_arg(test_sort_no_bounds, quick_sort, "quick_sort");
+  mu_run_test_on_arg(test_sort_no_bounds, quick_sort_iterative, 
+                     "quick_sort_iterative");
+  mu_run_test_on_arg(test_sort_no_bounds, quick_sort_3way, "quick_sort_3way");
   mu_run_test_on_arg(test_sort_no_bounds, timsort, "timsort");
+  mu_run_test_on_arg(test_sort_no_bounds, sort_auto, "sort_auto");
+  mu_run_test(test_sort_iterative_small_stack);
+
+  // Sort Stats
+#ifdef SORT_STATS
+  mu_run_test(test_sort_stats_timsort);
+#endif
+
+  // Perf
+  mu_run_test(test_perf_counters);
+
+  // Trace
+#ifdef SORT_TRACE
+  mu_run_test(test_trace_dump);
+  mu_run_test(test_trace_workers);
+#endif
+
+  // Segments
+  mu_run_test(test_segment_lookup);
+  mu_run_test(test_sort_tuning);
+  mu_run_test(test_sort_auto_choose);
+  mu_run_test(test_measure_presortedness);
+  mu_run_test(test_is_sorted);
+  mu_run_test(test_sort_precheck);
+  mu_run_test(test_counting_sort);
+  mu_run_test(test_merge_sort_tiled);
+  mu_run_test(test_list_sort);
+  mu_run_test(test_sample_sort_parallel);
+  mu_run_test(test_segmented_sort);
+  mu_run_test(test_cosort);
+  mu_run_test(test_order_by);
+  mu_run_test(test_normkey);
+  mu_run_test(test_prefix_sort);
+  mu_run_test(test_sort_by_key);
+  mu_run_test(test_sort_job);
+  mu_run_test(test_sort_step);
+  mu_run_test(test_sort_control);
 
   // Stress Tests
   mu_run_test(test_timsort_stress_integers);
   mu_run_test(test_timsort_stress_chars);
+  mu_run_test(test_timsort_stable);
 
   return 0;
 }
@@ -0,0 +1,407 @@
+/**
+ * @file
+ * @brief Lock-free concurrent stack implementation.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "concurrent_stack.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup ConcurrentStack
+ * @def CONCURRENT_STACK_MAX_NODES
+ * @brief Maximum number of nodes in a stack's node pool. */
+#define CONCURRENT_STACK_MAX_NODES \
+  ((uint64_t) CONCURRENT_STACK_CHUNK_NODES * CONCURRENT_STACK_MAX_CHUNKS)
+
+/*
+ * Tagged heads: a 32-bit tag above a 32-bit reference (node index + 1, so
+ * that 0 is the empty list).
+ */
+#define TAGGED(tag, ref) (((uint64_t)(tag) << 32) | (uint32_t)(ref))
+#define TAGGED_REF(word) ((uint32_t)(word))
+#define TAGGED_TAG(word) ((uint32_t)((word) >> 32))
+
+/**
+ * @ingroup ConcurrentStack
+ * @brief Source of unique stack identifiers.
+ */
+static uint64_t concurrent_stack_next_id = 0;
+
+/**
+ * @ingroup ConcurrentStack
+ * @brief Per-thread byte whose address identifies the thread to caches.
+ */
+static __thread char concurrent_stack_token;
+
+/*
+ * Cache of the last lookup made by this thread in concurrent_stack_cache().
+ */
+static __thread const ConcurrentStack* concurrent_stack_last = NULL;
+static __thread uint64_t concurrent_stack_last_id = 0;
+static __thread ConcurrentStackCache* concurrent_stack_last_cache = NULL;
+
+static ConcurrentStackNode* concurrent_stack_node(ConcurrentStack* stack,
+                                                  uint32_t ref);
+static void concurrent_stack_list_push(ConcurrentStack* stack, uint64_t* head,
+                                       uint32_t first, uint32_t last);
+static uint32_t concurrent_stack_list_pop(ConcurrentStack* stack,
+                                          uint64_t* head);
+static uint32_t concurrent_stack_node_alloc(ConcurrentStack* stack,
+                                            uint32_t nnodes);
+static ConcurrentStackCache* concurrent_stack_cache(ConcurrentStack* stack);
+static uint32_t concurrent_stack_node_take(ConcurrentStack* stack);
+static void concurrent_stack_node_release(ConcurrentStack* stack,
+                                          uint32_t ref);
+
+/**
+ * @addtogroup ConcurrentStack
+ * @{
+ */
+
+/**
+ * @brief Initialize new concurrent stack.
+ *
+ * Nodes are allocated in chunks of CONCURRENT_STACK_CHUNK_NODES and never
+ * returned to the system before concurrent_stack_free(). A popped node is
+ * therefore always safe to read, and the tagged heads are all that is needed
+ * to protect against ABA.
+ *
+ * @return New stack.
+ */
+ConcurrentStack*
+concurrent_stack_init()
+{
+  ConcurrentStack* stack = malloc(sizeof(ConcurrentStack));
+  stack->head = TAGGED(0, 0);
+  stack->free_head = TAGGED(0, 0);
+  stack->len = 0;
+  stack->next_node = 0;
+  stack->id = __atomic_add_fetch(&concurrent_stack_next_id, 1,
+                                 __ATOMIC_RELAXED);
+  stack->chunks = calloc(CONCURRENT_STACK_MAX_CHUNKS,
+                         sizeof(ConcurrentStackNode*));
+  stack->caches = calloc(CONCURRENT_STACK_MAX_THREADS,
+                         sizeof(ConcurrentStackCache));
+  return stack;
+}
+
+/**
+ * @brief Push data onto stack. Safe to call from any thread.
+ *
+ * @param stack Stack to push data onto.
+ * @param data Data to be pushed.
+ * @return Returns 0 if the node pool is exhausted else 1.
+ */
+int
+concurrent_stack_push(ConcurrentStack* stack, void* data)
+{
+  uint32_t ref = concurrent_stack_node_take(stack);
+  if (ref == 0) {
+    return 0;
+  }
+  concurrent_stack_node(stack, ref)->data = data;
+  // Count before publishing, so that a racing pop never sees len underflow.
+  __atomic_add_fetch(&stack->len, 1, __ATOMIC_RELAXED);
+  concurrent_stack_list_push(stack, &stack->head, ref, ref);
+  return 1;
+}
+
+/**
+ * @brief Remove topmost value from stack, if any. Safe to call from any
+ * thread.
+ *
+ * @param stack Stack to pop from.
+ * @param data Set to previous top of stack (unchanged if stack is empty).
+ * @return Returns 0 if stack is empty else 1.
+ */
+int
+concurrent_stack_try_pop(ConcurrentStack* stack, void** data)
+{
+  uint32_t ref = concurrent_stack_list_pop(stack, &stack->head);
+  if (ref == 0) {
+    return 0;
+  }
+  *data = concurrent_stack_node(stack, ref)->data;
+  concurrent_stack_node_release(stack, ref);
+  __atomic_sub_fetch(&stack->len, 1, __ATOMIC_RELAXED);
+  return 1;
+}
+
+/**
+ * @brief Remove topmost value from stack without returning it.
+ *
+ * @param stack Stack to pop from.
+ * @return Returns 0 if unable to pop else 1.
+ */
+int
+concurrent_stack_pop(ConcurrentStack* stack)
+{
+  void* data;
+  return concurrent_stack_try_pop(stack, &data);
+}
+
+/**
+ * @brief Remove topmost value from stack and return it.
+ *
+ * @note Use concurrent_stack_try_pop() if NULL may be pushed.
+ *
+ * @param stack Stack to pop from.
+ * @return Previous top of stack, or NULL if stack is empty.
+ */
+void*
+concurrent_stack_pop_return(ConcurrentStack* stack)
+{
+  void* data = NULL;
+  concurrent_stack_try_pop(stack, &data);
+  return data;
+}
+
+/**
+ * @brief Get number of items in stack.
+ *
+ * @note While other threads push or pop, the result may include pushes which
+ * are still in progress.
+ *
+ * @param stack Stack to measure.
+ * @return Number of items in stack.
+ */
+size_t
+concurrent_stack_len(ConcurrentStack* stack)
+{
+  return __atomic_load_n(&stack->len, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Free stack and its node pool.
+ *
+ * @note Not thread-safe: no other thread may be using the stack.
+ *
+ * @note Does not free data stored in stack.
+ *
+ * @param stack Stack to free.
+ * @return Void.
+ */
+void
+concurrent_stack_free(ConcurrentStack** stack)
+{
+  for (size_t c = 0; c < CONCURRENT_STACK_MAX_CHUNKS; c++) {
+    free((*stack)->chunks[c]);
+  }
+  free((*stack)->chunks);
+  free((*stack)->caches);
+  free(*stack);
+  *stack = NULL;
+}
+
+/**
+ * @brief Get node by reference.
+ *
+ * @param stack Stack owning node.
+ * @param ref Node index + 1.
+ * @return Node.
+ */
+ConcurrentStackNode*
+concurrent_stack_node(ConcurrentStack* stack, uint32_t ref)
+{
+  uint32_t index = ref - 1;
+  ConcurrentStackNode* chunk = __atomic_load_n(
+      &stack->chunks[index / CONCURRENT_STACK_CHUNK_NODES], __ATOMIC_ACQUIRE);
+  return &chunk[index % CONCURRENT_STACK_CHUNK_NODES];
+}
+
+/**
+ * @brief Push chain of linked nodes onto tagged list.
+ *
+ * @param stack Stack owning nodes.
+ * @param head Tagged head of list.
+ * @param first First node of chain.
+ * @param last Last node of chain (its next is overwritten).
+ * @return Void.
+ */
+void
+concurrent_stack_list_push(ConcurrentStack* stack, uint64_t* head,
+                           uint32_t first, uint32_t last)
+{
+  ConcurrentStackNode* last_node = concurrent_stack_node(stack, last);
+  uint64_t old = __atomic_load_n(head, __ATOMIC_RELAXED);
+  uint64_t new_head;
+  do {
+    __atomic_store_n(&last_node->next, TAGGED_REF(old), __ATOMIC_RELAXED);
+    new_head = TAGGED(TAGGED_TAG(old) + 1, first);
+  } while (!__atomic_compare_exchange_n(head, &old, new_head, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Pop node from tagged list.
+ *
+ * The next reference of the head node may be stale by the time it is read
+ * (another thread may have popped and reused the node), but then the tag has
+ * moved on and the exchange fails.
+ *
+ * @param stack Stack owning nodes.
+ * @param head Tagged head of list.
+ * @return Popped node, or 0 if list is empty.
+ */
+uint32_t
+concurrent_stack_list_pop(ConcurrentStack* stack, uint64_t* head)
+{
+  uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+  while (TAGGED_REF(old) != 0) {
+    ConcurrentStackNode* node = concurrent_stack_node(stack, TAGGED_REF(old));
+    uint32_t next = __atomic_load_n(&node->next, __ATOMIC_RELAXED);
+    if (__atomic_compare_exchange_n(head, &old,
+                                    TAGGED(TAGGED_TAG(old) + 1, next), 1,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+      return TAGGED_REF(old);
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Hand out consecutive nodes which have never been used.
+ *
+ * @param stack Stack owning pool.
+ * @param nnodes Number of nodes wanted.
+ * @return First of up to nnodes new nodes (refs first, first + 1, ...), or 0
+ * if the pool is exhausted. Fewer nodes are handed out only at the very end
+ * of the pool.
+ */
+uint32_t
+concurrent_stack_node_alloc(ConcurrentStack* stack, uint32_t nnodes)
+{
+  uint64_t start = __atomic_fetch_add(&stack->next_node, nnodes,
+                                      __ATOMIC_RELAXED);
+  if (start >= CONCURRENT_STACK_MAX_NODES) {
+    return 0;
+  }
+  uint64_t end = start + nnodes < CONCURRENT_STACK_MAX_NODES
+                 ? start + nnodes : CONCURRENT_STACK_MAX_NODES;
+  for (uint64_t c = start / CONCURRENT_STACK_CHUNK_NODES;
+       c <= (end - 1) / CONCURRENT_STACK_CHUNK_NODES; c++) {
+    if (__atomic_load_n(&stack->chunks[c], __ATOMIC_ACQUIRE) == NULL) {
+      ConcurrentStackNode* chunk = malloc(CONCURRENT_STACK_CHUNK_NODES
+                                          * sizeof(ConcurrentStackNode));
+      ConcurrentStackNode* expected = NULL;
+      if (!__atomic_compare_exchange_n(&stack->chunks[c], &expected, chunk, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(chunk);
+      }
+    }
+  }
+  return (uint32_t) start + 1;
+}
+
+/**
+ * @brief Find node cache of calling thread, claiming one if needed.
+ *
+ * A thread is identified by the address of its concurrent_stack_token. A new
+ * thread which is given the address of an exited thread takes over its cache
+ * (and the free nodes in it). Threads beyond CONCURRENT_STACK_MAX_THREADS get
+ * no cache and use the shared free list directly.
+ *
+ * @param stack Stack owning caches.
+ * @return Cache of calling thread, or NULL if none is available.
+ */
+ConcurrentStackCache*
+concurrent_stack_cache(ConcurrentStack* stack)
+{
+  if (concurrent_stack_last == stack && concurrent_stack_last_id == stack->id) {
+    return concurrent_stack_last_cache;
+  }
+  const void* token = &concurrent_stack_token;
+  ConcurrentStackCache* cache = NULL;
+  for (size_t t = 0; cache == NULL && t < CONCURRENT_STACK_MAX_THREADS; t++) {
+    if (__atomic_load_n(&stack->caches[t].owner, __ATOMIC_ACQUIRE) == token) {
+      cache = &stack->caches[t];
+    }
+  }
+  for (size_t t = 0; cache == NULL && t < CONCURRENT_STACK_MAX_THREADS; t++) {
+    const void* expected = NULL;
+    if (__atomic_compare_exchange_n(&stack->caches[t].owner, &expected, token,
+                                    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      cache = &stack->caches[t];
+    }
+  }
+  concurrent_stack_last = stack;
+  concurrent_stack_last_id = stack->id;
+  concurrent_stack_last_cache = cache;
+  return cache;
+}
+
+/**
+ * @brief Take free node for a push.
+ *
+ * Nodes come from the calling thread's cache. An empty cache is refilled to
+ * half capacity, first from the shared free list and then from the pool.
+ *
+ * @param stack Stack owning nodes.
+ * @return Free node, or 0 if the pool is exhausted.
+ */
+uint32_t
+concurrent_stack_node_take(ConcurrentStack* stack)
+{
+  ConcurrentStackCache* cache = concurrent_stack_cache(stack);
+  if (cache == NULL) {
+    uint32_t ref = concurrent_stack_list_pop(stack, &stack->free_head);
+    return ref != 0 ? ref : concurrent_stack_node_alloc(stack, 1);
+  }
+  if (cache->len == 0) {
+    const uint32_t refill = CONCURRENT_STACK_CACHE_NODES / 2;
+    uint32_t ref;
+    while (cache->len < refill
+           && (ref = concurrent_stack_list_pop(stack, &stack->free_head))) {
+      cache->nodes[cache->len++] = ref;
+    }
+    if (cache->len == 0) {
+      uint32_t first = concurrent_stack_node_alloc(stack, refill);
+      uint64_t end = first != 0 ? first + (uint64_t) refill : 0;
+      end = end < CONCURRENT_STACK_MAX_NODES + 1
+            ? end : CONCURRENT_STACK_MAX_NODES + 1;
+      for (uint64_t r = first; first != 0 && r < end; r++) {
+        cache->nodes[cache->len++] = (uint32_t) r;
+      }
+    }
+    if (cache->len == 0) {
+      return 0;
+    }
+  }
+  return cache->nodes[--cache->len];
+}
+
+/**
+ * @brief Release popped node.
+ *
+ * Nodes go to the calling thread's cache. A full cache first moves half of
+ * its nodes to the shared free list, linked into a chain and published by a
+ * single exchange.
+ *
+ * @param stack Stack owning nodes.
+ * @param ref Node to release.
+ * @return Void.
+ */
+void
+concurrent_stack_node_release(ConcurrentStack* stack, uint32_t ref)
+{
+  ConcurrentStackCache* cache = concurrent_stack_cache(stack);
+  if (cache == NULL) {
+    concurrent_stack_list_push(stack, &stack->free_head, ref, ref);
+    return;
+  }
+  if (cache->len == CONCURRENT_STACK_CACHE_NODES) {
+    const uint32_t keep = CONCURRENT_STACK_CACHE_NODES / 2;
+    for (uint32_t i = keep; i + 1 < cache->len; i++) {
+      __atomic_store_n(&concurrent_stack_node(stack, cache->nodes[i])->next,
+                       cache->nodes[i + 1], __ATOMIC_RELAXED);
+    }
+    concurrent_stack_list_push(stack, &stack->free_head, cache->nodes[keep],
+                               cache->nodes[cache->len - 1]);
+    cache->len = keep;
+  }
+  cache->nodes[cache->len++] = ref;
+}
+
+/** @} */
@@ -0,0 +1,80 @@
+/**
+ * @file
+ * @brief Lock-free concurrent stack header file.
+ */
+#ifndef MY_CONCURRENT_STACK_
+#define MY_CONCURRENT_STACK_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def CONCURRENT_STACK_CHUNK_NODES
+ * @brief Number of nodes in each chunk of a stack's node pool. */
+#define CONCURRENT_STACK_CHUNK_NODES 4096
+/**
+ * @def CONCURRENT_STACK_MAX_CHUNKS
+ * @brief Maximum number of chunks in a stack's node pool. */
+#define CONCURRENT_STACK_MAX_CHUNKS 65536
+/**
+ * @def CONCURRENT_STACK_CACHE_NODES
+ * @brief Maximum number of free nodes cached by each thread. */
+#define CONCURRENT_STACK_CACHE_NODES 62
+/**
+ * @def CONCURRENT_STACK_MAX_THREADS
+ * @brief Maximum number of threads with their own node cache. */
+#define CONCURRENT_STACK_MAX_THREADS 64
+
+/**
+ * @ingroup ConcurrentStack
+ * @struct ConcurrentStackNode
+ * @brief Struct to represent a node in a concurrent stack.
+ */
+typedef struct ConcurrentStackNode {
+  void* data; ///< Data stored in node.
+  uint32_t next; ///< Index + 1 of next node (0 if none).
+} ConcurrentStackNode;
+
+/**
+ * @ingroup ConcurrentStack
+ * @struct ConcurrentStackCache
+ * @brief Struct to represent the free nodes cached by one thread.
+ */
+typedef struct ConcurrentStackCache {
+  const void* owner; ///< Thread owning cache (NULL if unclaimed).
+  uint32_t len; ///< Number of cached nodes.
+  uint32_t nodes[CONCURRENT_STACK_CACHE_NODES]; ///< Indices of free nodes.
+} ConcurrentStackCache;
+
+/**
+ * @ingroup ConcurrentStack
+ * @struct ConcurrentStack
+ * @brief Struct to represent a lock-free (Treiber) stack.
+ *
+ * Heads pack a 32-bit tag above a 32-bit node index + 1, and every successful
+ * update increments the tag, so that a head which was popped and pushed back
+ * in between (the ABA problem) is not mistaken for an unchanged one.
+ */
+typedef struct ConcurrentStack {
+  uint64_t head; ///< Tagged head of stack.
+  uint64_t free_head; ///< Tagged head of shared free node list.
+  size_t len; ///< Number of items in stack.
+  uint64_t next_node; ///< Next node never handed out.
+  uint64_t id; ///< Unique identifier (stacks may reuse an address).
+  ConcurrentStackNode** chunks; ///< Chunks of node pool.
+  ConcurrentStackCache* caches; ///< Node cache of each thread.
+} ConcurrentStack;
+
+//##############################################################################
+//# CONCURRENT STACK
+//##############################################################################
+
+ConcurrentStack* concurrent_stack_init();
+int concurrent_stack_push(ConcurrentStack* stack, void* data);
+int concurrent_stack_try_pop(ConcurrentStack* stack, void** data);
+int concurrent_stack_pop(ConcurrentStack* stack);
+void* concurrent_stack_pop_return(ConcurrentStack* stack);
+size_t concurrent_stack_len(ConcurrentStack* stack);
+void concurrent_stack_free(ConcurrentStack** stack);
+
+#endif /* MY_CONCURRENT_STACK_ */
@@ -0,0 +1,275 @@
+/**
+ * @file
+ * @brief Co-sort (struct-of-arrays sort) implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "cosort.h"
+#include "sorting.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup CoSort
+ * @def COSORT_GATHER
+ * @brief Gather elements of a constant width, so that each copy compiles to
+ * a single load and store. */
+#define COSORT_GATHER(dst, src, nelems, width, perm) \
+  for (size_t i = 0; i < (nelems); i++) { \
+    if (i + COSORT_PREFETCH_DISTANCE < (nelems)) { \
+      __builtin_prefetch( \
+          (src)+((perm)[i + COSORT_PREFETCH_DISTANCE] * (width))); \
+    } \
+    memcpy((dst)+(i * (width)), (src)+((perm)[i] * (width)), (width)); \
+  }
+
+/**
+ * @addtogroup CoSort
+ * @{
+ */
+
+/**
+ * @brief Sort a key column, applying the same permutation to payload columns.
+ *
+ * For columnar data, where the key of element i is keys[i] and its other
+ * fields are payloads[c][i]. The sort is stable: elements with equal keys
+ * keep their order in every column.
+ *
+ * Keys are sorted once with their indices (see cosort_permutation()), and
+ * the resulting permutation is then applied to one payload column at a time
+ * (see cosort_apply()), so that each pass streams through a single column.
+ * Payloads are never touched by the comparison function.
+ *
+ * Uses nelems * (sizeof(size_t) + largest payload size) bytes of auxillary
+ * space, plus that of cosort_permutation().
+ *
+ * @param keys Key column, sorted in place.
+ * @param nelems Number of elements in each column.
+ * @param key_size Size of each key.
+ * @param compare Function to be used to compare keys.
+ * @param payloads Payload columns, permuted in place.
+ * @param payload_sizes Size of each element of each payload column.
+ * @param npayloads Number of payload columns.
+ * @return Void.
+ */
+void
+cosort(void* keys, size_t nelems, size_t key_size,
+       int (*compare)(const void*, const void*),
+       void* const payloads[], const size_t payload_sizes[],
+       size_t npayloads)
+{
+  if (nelems < 2) {
+    return;
+  }
+  size_t* perm = malloc(nelems * sizeof(size_t));
+  cosort_permutation(keys, nelems, key_size, compare, perm);
+
+  size_t max_size = 0;
+  for (size_t c = 0; c < npayloads; c++) {
+    max_size = payload_sizes[c] > max_size ? payload_sizes[c] : max_size;
+  }
+  void* scratch = malloc(nelems * max_size + 1);
+  SORT_STATS_ADD(allocs, 2);
+  SORT_STATS_ADD(aux_bytes, nelems * (sizeof(size_t) + max_size));
+  for (size_t c = 0; c < npayloads; c++) {
+    cosort_apply(payloads[c], nelems, payload_sizes[c], perm, scratch);
+  }
+  free(scratch);
+  free(perm);
+}
+
+/**
+ * @brief Stably sort a key column, recording where each key came from.
+ *
+ * Each key is copied into a record followed by its index, and the records
+ * are sorted by merge_sort_tiled() with compare, which only reads the key at
+ * the start of each record. Comparisons therefore touch keys and indices only,
+ * and ties keep their original order. Records are padded so that keys stay
+ * as aligned as the array they were copied from (up to 16 bytes).
+ *
+ * Uses 2 * nelems * (key_size + sizeof(size_t)) bytes of auxillary space,
+ * plus padding.
+ *
+ * @param keys Key column, sorted in place.
+ * @param nelems Number of keys.
+ * @param key_size Size of each key.
+ * @param compare Function to be used to compare keys.
+ * @param perm Set so that perm[i] is the original index of the key now at i.
+ * @return Void.
+ */
+void
+cosort_permutation(void* keys, size_t nelems, size_t key_size,
+                   int (*compare)(const void*, const void*),
+                   size_t* perm)
+{
+  char* keys_p = (char*) keys;
+  const size_t align = key_size % 16 == 0 ? 16 : sizeof(size_t);
+  const size_t index_offset = (key_size + sizeof(size_t) - 1)
+                              / sizeof(size_t) * sizeof(size_t);
+  const size_t stride = (index_offset + sizeof(size_t) + align - 1)
+                        / align * align;
+  char* records = malloc(nelems * stride + 1);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, nelems * stride);
+  for (size_t i = 0; i < nelems; i++) {
+    memcpy(records+(i * stride), keys_p+(i * key_size), key_size);
+    memcpy(records+(i * stride + index_offset), &i, sizeof(size_t));
+  }
+  merge_sort_tiled(records, nelems, stride, compare);
+  for (size_t i = 0; i < nelems; i++) {
+    memcpy(keys_p+(i * key_size), records+(i * stride), key_size);
+    memcpy(&perm[i], records+(i * stride + index_offset), sizeof(size_t));
+  }
+  SORT_STATS_ADD(bytes_moved, 2 * nelems * stride);
+  free(records);
+}
+
+/**
+ * @brief Rearrange a column by a permutation.
+ *
+ * Element perm[i] is moved to position i. Elements are gathered into scratch
+ * in output order, prefetching sources COSORT_PREFETCH_DISTANCE elements
+ * ahead, then copied back in one pass: perm and scratch are accessed
+ * sequentially and only the gathered reads are scattered. Common sizes are
+ * copied with fixed-width moves.
+ *
+ * @param arr Column to rearrange.
+ * @param nelems Number of elements in column.
+ * @param size Size of each element.
+ * @param perm Original index of the element which belongs at each position.
+ * @param scratch nelems * size bytes of space, or NULL to allocate it.
+ * @return Void.
+ */
+void
+cosort_apply(void* arr, size_t nelems, size_t size, const size_t* perm,
+             void* scratch)
+{
+  const char* arr_p = (const char*) arr;
+  char* dst = (char*) scratch;
+  if (scratch == NULL) {
+    dst = malloc(nelems * size + 1);
+    SORT_STATS_ADD(allocs, 1);
+    SORT_STATS_ADD(aux_bytes, nelems * size);
+  }
+  switch (size) {
+    case 1:
+      COSORT_GATHER(dst, arr_p, nelems, 1, perm);
+      break;
+    case 2:
+      COSORT_GATHER(dst, arr_p, nelems, 2, perm);
+      break;
+    case 4:
+      COSORT_GATHER(dst, arr_p, nelems, 4, perm);
+      break;
+    case 8:
+      COSORT_GATHER(dst, arr_p, nelems, 8, perm);
+      break;
+    default:
+      COSORT_GATHER(dst, arr_p, nelems, size, perm);
+      break;
+  }
+  memcpy(arr, dst, nelems * size);
+  SORT_STATS_ADD(bytes_moved, 2 * nelems * size);
+  if (scratch == NULL) {
+    free(dst);
+  }
+}
+
+/**
+ * @brief Stably sort entries by the low bytes of their keys, a byte per pass.
+ *
+ * LSD radix sort. Counts for every byte are gathered in a single pass before
+ * any entry moves, and bytes which are equal for every entry take no pass.
+ *
+ * @param entries Entries to sort.
+ * @param aux Space for as many entries.
+ * @param nelems Number of entries.
+ * @param nbytes Number of low bytes of key to sort by (at most 8).
+ * @return Either entries or aux, whichever holds the sorted entries.
+ */
+CosortEntry*
+cosort_radix(CosortEntry* entries, CosortEntry* aux, size_t nelems,
+             size_t nbytes)
+{
+  enum { RADIX = 256 };
+  size_t counts[8][RADIX];
+  memset(counts, 0, sizeof(counts));
+  for (size_t i = 0; i < nelems; i++) {
+    for (size_t b = 0; b < nbytes; b++) {
+      counts[b][(entries[i].key >> (8 * b)) & 0xFF]++;
+    }
+  }
+
+  CosortEntry* src = entries;
+  CosortEntry* dst = aux;
+  for (size_t b = 0; b < nbytes && nelems > 0; b++) {
+    const unsigned shift = 8 * b;
+    if (counts[b][(src[0].key >> shift) & 0xFF] == nelems) {
+      continue;
+    }
+    size_t pos = 0;
+    for (size_t d = 0; d < RADIX; d++) {
+      size_t count = counts[b][d];
+      counts[b][d] = pos;
+      pos += count;
+    }
+    for (size_t i = 0; i < nelems; i++) {
+      dst[counts[b][(src[i].key >> shift) & 0xFF]++] = src[i];
+    }
+    SORT_STATS_ADD(bytes_moved, nelems * sizeof(CosortEntry));
+    CosortEntry* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  return src;
+}
+
+/**
+ * @brief Stably sort indices of elements by comparing the elements.
+ *
+ * A top-down merge sort of the indices, for sorting short runs of elements
+ * which other keys left tied. The elements are not moved.
+ *
+ * @param arr Array of elements (not moved).
+ * @param size Size of each element in array.
+ * @param compare Function to be used to compare elements, passed ctx as its
+ * third argument.
+ * @param ctx Context for compare.
+ * @param idx Indices to sort.
+ * @param tmp Space for nelems indices.
+ * @param nelems Number of indices.
+ * @return Void.
+ */
+void
+cosort_indices(const void* arr, size_t size,
+               int (*compare)(const void*, const void*, void*), void* ctx,
+               size_t* idx, size_t* tmp, size_t nelems)
+{
+  if (nelems < 2) {
+    return;
+  }
+  const char* arr_p = (const char*) arr;
+  const size_t mid = nelems / 2;
+  cosort_indices(arr, size, compare, ctx, idx, tmp, mid);
+  cosort_indices(arr, size, compare, ctx, idx + mid, tmp, nelems - mid);
+  size_t i = 0;
+  size_t j = mid;
+  size_t k = 0;
+  while (i < mid && j < nelems) {
+    if (compare(arr_p+(idx[j] * size), arr_p+(idx[i] * size), ctx) < 0) {
+      tmp[k++] = idx[j++];
+    } else {
+      tmp[k++] = idx[i++];
+    }
+  }
+  while (i < mid) {
+    tmp[k++] = idx[i++];
+  }
+  while (j < nelems) {
+    tmp[k++] = idx[j++];
+  }
+  memcpy(idx, tmp, nelems * sizeof(size_t));
+}
+
+/** @} */
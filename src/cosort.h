@@ -0,0 +1,46 @@
+/**
+ * @file
+ * @brief Co-sort (struct-of-arrays sort) header file.
+ */
+#ifndef MY_COSORT_
+#define MY_COSORT_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def COSORT_PREFETCH_DISTANCE
+ * @brief How many elements ahead cosort_apply() prefetches the source of
+ * each gathered element. */
+#define COSORT_PREFETCH_DISTANCE 16
+
+/**
+ * @ingroup CoSort
+ * @struct CosortEntry
+ * @brief Struct to represent an element by its integer key and index.
+ */
+typedef struct CosortEntry {
+  uint64_t key; ///< Element's key, widened or encoded to 64 bits.
+  size_t index; ///< Index of element in array.
+} CosortEntry;
+
+//##############################################################################
+//# COSORT
+//##############################################################################
+
+void cosort(void* keys, size_t nelems, size_t key_size,
+            int (*compare)(const void*, const void*),
+            void* const payloads[], const size_t payload_sizes[],
+            size_t npayloads);
+void cosort_permutation(void* keys, size_t nelems, size_t key_size,
+                        int (*compare)(const void*, const void*),
+                        size_t* perm);
+void cosort_apply(void* arr, size_t nelems, size_t size, const size_t* perm,
+                  void* scratch);
+CosortEntry* cosort_radix(CosortEntry* entries, CosortEntry* aux,
+                          size_t nelems, size_t nbytes);
+void cosort_indices(const void* arr, size_t size,
+                    int (*compare)(const void*, const void*, void*),
+                    void* ctx, size_t* idx, size_t* tmp, size_t nelems);
+
+#endif /* MY_COSORT_ */
@@ -0,0 +1,163 @@
+/**
+ * @file
+ * @brief Counting sort implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "counting.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @addtogroup CountingSort
+ * @{
+ */
+
+/**
+ * @brief Sort array of bytes by counting occurrences of each value.
+ *
+ * Consecutive bytes are counted into COUNTING_U8_HISTOGRAMS separate
+ * histograms. Runs of equal bytes are common (e.g. text, or data which is
+ * partly sorted), and with a single histogram each increment would have to
+ * wait on the store of the previous increment to the same counter. Spreading
+ * neighbours across histograms lets those increments proceed independently.
+ * The histograms are summed before the array is rewritten, one memset() per
+ * value.
+ *
+ * Runs in O(nelems + 256) time and O(1) space, without any comparisons.
+ *
+ * @param arr Array to be sorted (values compare as unsigned).
+ * @param nelems Number of elements in array.
+ * @return Void.
+ */
+void
+counting_sort_u8(uint8_t* arr, size_t nelems)
+{
+  size_t counts[COUNTING_U8_HISTOGRAMS][256];
+  memset(counts, 0, sizeof(counts));
+
+  size_t i = 0;
+  for (; i + COUNTING_U8_HISTOGRAMS <= nelems; i += COUNTING_U8_HISTOGRAMS) {
+    for (size_t h = 0; h < COUNTING_U8_HISTOGRAMS; h++) {
+      counts[h][arr[i + h]]++;
+    }
+  }
+  for (; i < nelems; i++) {
+    counts[0][arr[i]]++;
+  }
+
+  size_t pos = 0;
+  for (size_t v = 0; v < 256; v++) {
+    size_t count = 0;
+    for (size_t h = 0; h < COUNTING_U8_HISTOGRAMS; h++) {
+      count += counts[h][v];
+    }
+    memset(arr+(pos), (int) v, count);
+    pos += count;
+  }
+  SORT_STATS_ADD(bytes_moved, nelems);
+}
+
+/**
+ * @brief Sort array of 16-bit unsigned integers by counting occurrences of
+ * each value.
+ *
+ * Runs in O(nelems + 65,536) time, with a 65,536 entry histogram on the heap.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in array.
+ * @return Void.
+ */
+void
+counting_sort_u16(uint16_t* arr, size_t nelems)
+{
+  enum { U16_VALUES = 1 << 16 };
+  size_t* counts = calloc(U16_VALUES, sizeof(size_t));
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, U16_VALUES * sizeof(size_t));
+  for (size_t i = 0; i < nelems; i++) {
+    counts[arr[i]]++;
+  }
+
+  size_t pos = 0;
+  for (size_t v = 0; v < U16_VALUES; v++) {
+    for (size_t c = counts[v]; c > 0; c--) {
+      arr[pos++] = (uint16_t) v;
+    }
+  }
+  SORT_STATS_ADD(bytes_moved, nelems * sizeof(uint16_t));
+  free(counts);
+}
+
+/**
+ * @brief Stable sort of generic array by integer keys in a declared range.
+ *
+ * Each element's key is read once, offset by min_key, and remembered. A
+ * histogram of the keys is turned into the starting position of each key by
+ * prefix sums, and elements (key and payload alike) are then copied to those
+ * positions in order, which keeps equal keys in their original order.
+ *
+ * Runs in O(nelems + range) time, with nelems * (size + 4) bytes plus one
+ * counter per key of auxiliary space.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param key Function returning the key of an element.
+ * @param min_key Smallest key which may occur.
+ * @param max_key Largest key which may occur.
+ * @return Returns 0 (leaving array unchanged) if the range is empty or wider
+ * than COUNTING_MAX_RANGE, or if any key lies outside it, else 1.
+ */
+int
+counting_sort_range(void* arr, size_t nelems, size_t size,
+                    int64_t (*key)(const void*), int64_t min_key,
+                    int64_t max_key)
+{
+  // Unsigned subtraction cannot overflow, even for the widest ranges.
+  if (max_key < min_key
+      || (uint64_t) max_key - (uint64_t) min_key
+         >= (uint64_t) COUNTING_MAX_RANGE) {
+    return 0;
+  }
+  char* arr_p = (char*) arr;
+  const size_t range = (size_t)((uint64_t) max_key - (uint64_t) min_key) + 1;
+
+  uint32_t* keys = malloc(nelems * sizeof(uint32_t) + 1);
+  for (size_t i = 0; i < nelems; i++) {
+    int64_t k = key(arr_p+(i * size));
+    if (k < min_key || k > max_key) {
+      free(keys);
+      return 0;
+    }
+    keys[i] = (uint32_t)((uint64_t) k - (uint64_t) min_key);
+  }
+
+  size_t* offsets = calloc(range, sizeof(size_t));
+  char* aux = malloc(nelems * size + 1);
+  SORT_STATS_ADD(allocs, 3);
+  SORT_STATS_ADD(aux_bytes, nelems * sizeof(uint32_t) + range * sizeof(size_t)
+                            + nelems * size);
+  for (size_t i = 0; i < nelems; i++) {
+    offsets[keys[i]]++;
+  }
+  size_t sum = 0;
+  for (size_t k = 0; k < range; k++) {
+    size_t count = offsets[k];
+    offsets[k] = sum;
+    sum += count;
+  }
+  for (size_t i = 0; i < nelems; i++) {
+    memcpy(aux+(offsets[keys[i]]++ * size), arr_p+(i * size), size);
+  }
+  memcpy(arr, aux, nelems * size);
+  SORT_STATS_ADD(bytes_moved, 2 * nelems * size);
+
+  free(keys);
+  free(offsets);
+  free(aux);
+  return 1;
+}
+
+/** @} */
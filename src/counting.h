@@ -0,0 +1,31 @@
+/**
+ * @file
+ * @brief Counting sort header file.
+ */
+#ifndef MY_COUNTING_SORT_
+#define MY_COUNTING_SORT_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def COUNTING_U8_HISTOGRAMS
+ * @brief Number of interleaved histograms used by counting_sort_u8(). */
+#define COUNTING_U8_HISTOGRAMS 4
+/**
+ * @def COUNTING_MAX_RANGE
+ * @brief Largest key range (max_key - min_key + 1) accepted by
+ * counting_sort_range(). */
+#define COUNTING_MAX_RANGE ((int64_t)1 << 24)
+
+//##############################################################################
+//# COUNTING SORTS
+//##############################################################################
+
+void counting_sort_u8(uint8_t* arr, size_t nelems);
+void counting_sort_u16(uint16_t* arr, size_t nelems);
+int counting_sort_range(void* arr, size_t nelems, size_t size,
+                        int64_t (*key)(const void*), int64_t min_key,
+                        int64_t max_key);
+
+#endif /* MY_COUNTING_SORT_ */
@@ -9,8 +9,57 @@
    * @brief StackFrame implementation.
    */
 
+  /**
+   * @defgroup ConcurrentStack Concurrent Stack
+   * @brief Lock-free stack safe for use by many threads.
+   */
+
 /** @} */
 
+/**
+ * @defgroup Segment Sorted Segment Files
+ * @brief Persistent sorted segments with a sparse block index.
+ */
+
+/**
+ * @defgroup SortStats Sort Statistics
+ * @brief Counters collected by instrumented (-DSORT_STATS) builds.
+ */
+
+/**
+ * @defgroup Perf Performance Counters
+ * @brief Hardware performance counters for sorts and their phases.
+ */
+
+/**
+ * @defgroup Trace Tracing
+ * @brief Per-thread phase trace events in Chrome trace_event format.
+ */
+
+/**
+ * @defgroup Parallel Parallel Loops
+ * @brief Parallel for loops over POSIX threads.
+ */
+
+/**
+ * @defgroup AsyncSort Asynchronous Sorts
+ * @brief Sort jobs run by a pool of worker threads.
+ */
+
+/**
+ * @defgroup SortControl Sort Control
+ * @brief Cancellation and deadlines for long-running sorts.
+ */
+
+/**
+ * @defgroup Sorted Sorted Order Checks
+ * @brief Generic and typed (vectorizable) checks for sorted order.
+ */
+
+/**
+ * @defgroup Presortedness Presortedness
+ * @brief Measures of how close an array is to being sorted.
+ */
 
 /**
  * @defgroup SortingAlgorithm Sorting Algorithms
@@ -51,6 +100,11 @@
      * @defgroup QuickSort Quicksorts
      * @brief Quicksort implementations.
      */
+
+    /**
+     * @defgroup SampleSort Sample Sorts
+     * @brief Sample sorts which sort buckets in parallel.
+     */
   
   /** @} END EfficientSort */
 
@@ -79,8 +133,71 @@
      * @brief Timsort implementations.
      */
 
+    /**
+     * @defgroup AutoSort Adaptive Sorts
+     * @brief Sorts which choose an algorithm by sampling their input.
+     */
+
   /** @} END HybridSort */
 
+  /**
+   * @defgroup DistributionSort Distribution Sorts
+   * @brief Sorts which place elements by key rather than by comparison.
+   * @{
+   */
+
+    /**
+     * @defgroup CountingSort Counting Sorts
+     * @brief Counting sort implementations for small key domains.
+     */
+
+  /** @} END DistributionSort */
+
+  /**
+   * @defgroup ListSort Linked List Sorts
+   * @brief Sorts which rewire the links of linked lists.
+   */
+
+  /**
+   * @defgroup SegmentedSort Segmented Sorts
+   * @brief Sorts of many independent segments of one array.
+   */
+
+  /**
+   * @defgroup CoSort Co-sorts
+   * @brief Sorts of a key column which carry payload columns along.
+   */
+
+  /**
+   * @defgroup OrderBy Multi-key Sorts
+   * @brief Lexicographic sorts by typed fields, as in SQL's ORDER BY.
+   */
+
+  /**
+   * @defgroup NormKey Normalized Keys
+   * @brief Multi-key sorts by memcmp-comparable byte strings.
+   */
+
+  /**
+   * @defgroup PrefixSort Prefix Sort
+   * @brief Sorts by cached integer key prefixes, comparing only ties.
+   */
+
+  /**
+   * @defgroup SortByKey Sort by Key
+   * @brief Sorts by keys computed once per element.
+   */
+
+  /**
+   * @defgroup Tuning Tuning
+   * @brief Machine-specific thresholds used by sorting algorithms.
+   */
+
+  /**
+   * @defgroup Precheck Pre-check
+   * @brief Optional check of every sort's input for sorted order.
+   */
+
   /**
    * @defgroup SortingHelper Helper Functions
    * @brief Helpers for sorting algorithms.
@@ -0,0 +1,206 @@
+/**
+ * @file
+ * @brief Linked list sort implementation.
+ */
+#include <stdlib.h>
+#include <stddef.h>
+
+#include "list_sort.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup ListSort
+ * @struct ListSort
+ * @brief Struct to represent the layout of the list being sorted.
+ */
+typedef struct ListSort {
+  size_t next_offset; ///< Offset of the next pointer within each node.
+  int frames; ///< Whether nodes are StackFrames compared by their data.
+  int (*compare)(const void*, const void*); ///< Function to compare nodes.
+} ListSort;
+
+static void* list_sort_nodes(const ListSort* ls, void* head);
+static void* list_sort_run(const ListSort* ls, void* head, void** rest);
+static void* list_sort_merge(const ListSort* ls, void* a, void* b);
+static int list_sort_compare(const ListSort* ls, void* a, void* b);
+
+/**
+ * @ingroup ListSort
+ * @def LIST_NEXT
+ * @brief Next pointer of a node, as an lvalue. */
+#define LIST_NEXT(ls, node) (*(void**)((char*)(node) + (ls)->next_offset))
+
+/**
+ * @addtogroup ListSort
+ * @{
+ */
+
+/**
+ * @brief Sort generic NULL-terminated singly linked list.
+ *
+ * Bottom-up natural merge sort: the list is consumed as a sequence of
+ * non-descending runs (strictly descending runs are reversed in place), and
+ * runs are merged like a binary counter, bin k of LIST_SORT_MAX_BINS holding
+ * the merge of 2^k runs. Sorting a list of r runs takes O(n log r) time, and
+ * already sorted lists take a single pass of n - 1 comparisons.
+ *
+ * Only next pointers are rewritten: nodes are never moved or copied, and no
+ * memory is allocated. The sort is stable.
+ *
+ * @param head First node of list (may be NULL).
+ * @param next_offset Offset of the next pointer within each node (e.g.
+ * offsetof(Node, next)).
+ * @param compare Function to compare nodes (passed pointers to nodes).
+ * @return First node of sorted list.
+ */
+void*
+list_sort(void* head, size_t next_offset,
+          int (*compare)(const void*, const void*))
+{
+  SORT_STATS_WRAP(compare);
+  ListSort ls = { next_offset, 0, compare };
+  return list_sort_nodes(&ls, head);
+}
+
+/**
+ * @brief Sort frames of stack by their data, smallest on top.
+ *
+ * Rewires the stack's frames with list_sort(). Popping the sorted stack
+ * returns data in ascending order, with equal data in its original order.
+ * Frame pool and length are unaffected.
+ *
+ * @param stack Stack to be sorted.
+ * @param compare Function to compare data (passed the data pointers stored in
+ * frames, not pointers to them).
+ * @return Void.
+ */
+void
+stack_sort(Stack* stack, int (*compare)(const void*, const void*))
+{
+  SORT_STATS_WRAP(compare);
+  ListSort ls = { offsetof(StackFrame, next), 1, compare };
+  stack->head = list_sort_nodes(&ls, stack->head);
+}
+
+/**
+ * @brief Sort list by merging its runs.
+ *
+ * @param ls Layout of list.
+ * @param head First node of list (may be NULL).
+ * @return First node of sorted list.
+ */
+void*
+list_sort_nodes(const ListSort* ls, void* head)
+{
+  void* bins[LIST_SORT_MAX_BINS] = { NULL };
+  size_t nbins = 0;
+  while (head != NULL) {
+    void* run = list_sort_run(ls, head, &head);
+    // Bins hold earlier nodes than run, so they go on the left of merges.
+    size_t k = 0;
+    for (; k < nbins && bins[k] != NULL; k++) {
+      run = list_sort_merge(ls, bins[k], run);
+      bins[k] = NULL;
+    }
+    if (k == LIST_SORT_MAX_BINS) {
+      k--;
+    }
+    bins[k] = run;
+    nbins = (k + 1 > nbins) ? k + 1 : nbins;
+  }
+
+  void* sorted = NULL;
+  for (size_t k = 0; k < nbins; k++) {
+    if (bins[k] != NULL) {
+      sorted = (sorted == NULL) ? bins[k]
+               : list_sort_merge(ls, bins[k], sorted);
+    }
+  }
+  return sorted;
+}
+
+/**
+ * @brief Detach the run at the head of list.
+ *
+ * A run is either non-descending, or strictly descending and then reversed
+ * (strictness keeps the reversal stable).
+ *
+ * @param ls Layout of list.
+ * @param head First node of list (not NULL).
+ * @param rest Set to first node after the run (NULL if none).
+ * @return First node of ascending run, which ends in NULL.
+ */
+void*
+list_sort_run(const ListSort* ls, void* head, void** rest)
+{
+  void* last = head;
+  void* next = LIST_NEXT(ls, head);
+  if (next != NULL && list_sort_compare(ls, next, head) < 0) {
+    // Strictly descending: reverse nodes onto the front of the run.
+    void* run = head;
+    LIST_NEXT(ls, head) = NULL;
+    do {
+      void* after = LIST_NEXT(ls, next);
+      LIST_NEXT(ls, next) = run;
+      run = next;
+      next = after;
+    } while (next != NULL && list_sort_compare(ls, next, run) < 0);
+    *rest = next;
+    return run;
+  }
+  while (next != NULL && list_sort_compare(ls, next, last) >= 0) {
+    last = next;
+    next = LIST_NEXT(ls, next);
+  }
+  LIST_NEXT(ls, last) = NULL;
+  *rest = next;
+  return head;
+}
+
+/**
+ * @brief Merge two sorted NULL-terminated lists.
+ *
+ * @param ls Layout of list.
+ * @param a Sorted list of earlier nodes, which win ties (not NULL).
+ * @param b Sorted list of later nodes (not NULL).
+ * @return First node of merged list.
+ */
+void*
+list_sort_merge(const ListSort* ls, void* a, void* b)
+{
+  void* head = NULL;
+  void** tail = &head;
+  while (a != NULL && b != NULL) {
+    if (list_sort_compare(ls, b, a) < 0) {
+      *tail = b;
+      tail = &LIST_NEXT(ls, b);
+      b = *tail;
+    } else {
+      *tail = a;
+      tail = &LIST_NEXT(ls, a);
+      a = *tail;
+    }
+  }
+  *tail = (a != NULL) ? a : b;
+  return head;
+}
+
+/**
+ * @brief Compare two nodes.
+ *
+ * @param ls Layout of list.
+ * @param a First node.
+ * @param b Second node.
+ * @return Result of ls->compare on the nodes, or on their data for frames.
+ */
+int
+list_sort_compare(const ListSort* ls, void* a, void* b)
+{
+  if (ls->frames) {
+    return ls->compare(((StackFrame*) a)->data, ((StackFrame*) b)->data);
+  }
+  return ls->compare(a, b);
+}
+
+/** @} */
@@ -0,0 +1,25 @@
+/**
+ * @file
+ * @brief Linked list sort header file.
+ */
+#ifndef MY_LIST_SORT_
+#define MY_LIST_SORT_
+
+#include <stdlib.h>
+#include "stack.h"
+
+/**
+ * @def LIST_SORT_MAX_BINS
+ * @brief Number of pending merged runs kept by list_sort(). Bin k holds 2^k
+ * runs, so 64 bins suffice for any list. */
+#define LIST_SORT_MAX_BINS 64
+
+//##############################################################################
+//# LIST SORTS
+//##############################################################################
+
+void* list_sort(void* head, size_t next_offset,
+                int (*compare)(const void*, const void*));
+void stack_sort(Stack* stack, int (*compare)(const void*, const void*));
+
+#endif /* MY_LIST_SORT_ */
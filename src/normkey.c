@@ -0,0 +1,344 @@
+/**
+ * @file
+ * @brief Normalized (memcmp-comparable) sort key implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "normkey.h"
+#include "cosort.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup NormKey
+ * @struct NormKeySort
+ * @brief Struct to represent a sort by normalized keys in progress.
+ *
+ * Each record holds an element's normalized key, a byte which is nonzero if
+ * the key had to be truncated, and the element's index.
+ */
+typedef struct NormKeySort {
+  const char* arr; ///< Array being sorted (not moved until the end).
+  size_t size; ///< Size of each element in array.
+  const SortKeySpec* keys; ///< Keys, most significant first.
+  size_t nkeys; ///< Number of keys.
+  size_t width; ///< Bytes in each normalized key.
+  size_t index_offset; ///< Offset of index within record.
+  size_t stride; ///< Bytes in each record.
+  unsigned char* records; ///< Records being sorted.
+  unsigned char* aux; ///< Space for radix passes.
+} NormKeySort;
+
+static void normkey_msd(NormKeySort* ns, size_t lo, size_t hi, size_t depth);
+static void normkey_insert(NormKeySort* ns, size_t lo, size_t hi,
+                           size_t depth);
+static int normkey_fallback_compare(const void* a, const void* b, void* ctx);
+static int normkey_nullable(const SortKeySpec* key);
+static size_t normkey_prefix(const SortKeySpec* key);
+
+/**
+ * @addtogroup NormKey
+ * @{
+ */
+
+/**
+ * @brief Get length of normalized keys.
+ *
+ * @param keys Keys, most significant first.
+ * @param nkeys Number of keys.
+ * @return Bytes written by normkey_encode().
+ */
+size_t
+normkey_width(const SortKeySpec* keys, size_t nkeys)
+{
+  size_t width = 0;
+  for (size_t k = 0; k < nkeys; k++) {
+    width += normkey_nullable(&keys[k]);
+    if (keys[k].type == SORT_KEY_STR) {
+      width += normkey_prefix(&keys[k]) + 1;
+    } else {
+      width += sort_key_width(keys[k].type);
+    }
+  }
+  return width;
+}
+
+/**
+ * @brief Encode keys of element into a byte string whose memcmp() order is
+ * their order_by_compare() order.
+ *
+ * Each key in turn contributes:
+ *
+ * - If it may be NULL (strings always may), a byte ranking NULL before or
+ *   after every value.
+ * - For fixed-width types, sort_key_encode() in big-endian order: integers
+ *   with their sign bit flipped, floats with their sign bit set if positive
+ *   or all bits flipped if negative, inverted if descending.
+ * - For strings, the first prefix bytes, padded with zeros, and a byte which
+ *   is 1 if the string is longer than the prefix. All are inverted if
+ *   descending.
+ *
+ * NULL keys contribute zeros after their NULL rank, and keys after a
+ * truncated string contribute only zeros. Elements whose normalized keys
+ * differ are in that order; equal normalized keys with a truncated string
+ * must be compared with order_by_compare().
+ *
+ * @param keys Keys, most significant first.
+ * @param nkeys Number of keys.
+ * @param elem Element to encode keys of.
+ * @param out normkey_width() bytes of space for normalized key.
+ * @return Returns 1 if normalized key is exact, or 0 if a string was
+ * truncated.
+ */
+int
+normkey_encode(const SortKeySpec* keys, size_t nkeys, const void* elem,
+               unsigned char* out)
+{
+  for (size_t k = 0; k < nkeys; k++) {
+    const SortKeySpec* key = &keys[k];
+    const int null = sort_key_is_null(key, elem);
+    if (normkey_nullable(key)) {
+      *out++ = null ^ (key->nulls == SORT_KEY_NULLS_FIRST);
+    }
+    if (key->type == SORT_KEY_STR) {
+      const size_t prefix = normkey_prefix(key);
+      const unsigned char invert = key->order == SORT_KEY_DESC ? 0xFF : 0;
+      const char* str = NULL;
+      size_t len = 0;
+      if (!null) {
+        memcpy(&str, (const char*) elem + key->offset, sizeof(str));
+        while (len < prefix && str[len] != '\0') {
+          len++;
+        }
+      }
+      for (size_t b = 0; b < prefix; b++) {
+        out[b] = (b < len ? (unsigned char) str[b] : 0) ^ invert;
+      }
+      const int truncated = len == prefix && str[len] != '\0';
+      out[prefix] = (unsigned char) truncated ^ invert;
+      out += prefix + 1;
+      if (truncated) {
+        // Later keys only matter if this one ties, which bytes can't tell.
+        memset(out, 0, normkey_width(keys + k + 1, nkeys - k - 1));
+        return 0;
+      }
+    } else {
+      const size_t width = sort_key_width(key->type);
+      const uint64_t bits = sort_key_encode(key, elem);
+      for (size_t b = 0; b < width; b++) {
+        out[b] = (unsigned char)(bits >> (8 * (width - 1 - b)));
+      }
+      out += width;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Sort generic array by normalized keys.
+ *
+ * The same order as order_by(), by a different route: every element's keys
+ * are encoded once by normkey_encode(), and the normalized keys (with
+ * element indices) are sorted by MSD radix, a byte at a time. Buckets of up
+ * to NORMKEY_SMALL_NELEMS are finished by insertion sort on memcmp() of their
+ * remaining bytes, and bytes equal across a bucket take no pass. Only
+ * elements whose normalized keys tie after a string was truncated are
+ * compared with order_by_compare().
+ *
+ * Elements are moved once, at the end (see cosort_apply()). The sort is
+ * stable.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param keys Keys, most significant first.
+ * @param nkeys Number of keys.
+ * @return Void.
+ */
+void
+normkey_sort(void* arr, size_t nelems, size_t size,
+             const SortKeySpec* keys, size_t nkeys)
+{
+  if (nelems < 2 || nkeys == 0) {
+    return;
+  }
+  const size_t width = normkey_width(keys, nkeys);
+  const size_t index_offset = (width + 1 + sizeof(size_t) - 1)
+                              / sizeof(size_t) * sizeof(size_t);
+  NormKeySort ns = {
+    (const char*) arr, size, keys, nkeys, width, index_offset,
+    index_offset + sizeof(size_t), NULL, NULL
+  };
+  ns.records = malloc(nelems * ns.stride);
+  ns.aux = malloc(nelems * ns.stride);
+  size_t* perm = malloc(nelems * sizeof(size_t));
+  SORT_STATS_ADD(allocs, 3);
+  SORT_STATS_ADD(aux_bytes, nelems * (2 * ns.stride + sizeof(size_t)));
+
+  for (size_t i = 0; i < nelems; i++) {
+    unsigned char* record = ns.records+(i * ns.stride);
+    record[width] = !normkey_encode(keys, nkeys, ns.arr+(i * size), record);
+    memcpy(record+(index_offset), &i, sizeof(size_t));
+  }
+  normkey_msd(&ns, 0, nelems, 0);
+  for (size_t i = 0; i < nelems; i++) {
+    memcpy(&perm[i], ns.records+(i * ns.stride + index_offset),
+           sizeof(size_t));
+  }
+
+  // Break ties between truncated keys with the real comparison.
+  size_t* tmp = NULL;
+  size_t start = 0;
+  for (size_t i = 1; i <= nelems; i++) {
+    const unsigned char* first = ns.records+(start * ns.stride);
+    if (i < nelems
+        && memcmp(first, ns.records+(i * ns.stride), width) == 0) {
+      continue;
+    }
+    if (i - start > 1 && first[width]) {
+      if (tmp == NULL) {
+        tmp = malloc(nelems * sizeof(size_t));
+        SORT_STATS_ADD(allocs, 1);
+        SORT_STATS_ADD(aux_bytes, nelems * sizeof(size_t));
+      }
+      cosort_indices(ns.arr, ns.size, normkey_fallback_compare, &ns,
+                     perm + start, tmp, i - start);
+    }
+    start = i;
+  }
+
+  cosort_apply(arr, nelems, size, perm, NULL);
+  free(tmp);
+  free(perm);
+  free(ns.records);
+  free(ns.aux);
+}
+
+/**
+ * @brief Sort records by normalized key bytes from depth onwards.
+ *
+ * Records in [lo, hi) share their first depth bytes. They are distributed
+ * stably into buckets by byte depth, and each bucket is sorted by the bytes
+ * after it.
+ *
+ * @param ns Sort in progress.
+ * @param lo First record.
+ * @param hi Record after last.
+ * @param depth Bytes already sorted by.
+ * @return Void.
+ */
+void
+normkey_msd(NormKeySort* ns, size_t lo, size_t hi, size_t depth)
+{
+  enum { RADIX = 256 };
+  const size_t stride = ns->stride;
+  unsigned char* records = ns->records;
+  while (hi - lo > NORMKEY_SMALL_NELEMS && depth < ns->width) {
+    size_t counts[RADIX + 1] = { 0 };
+    for (size_t i = lo; i < hi; i++) {
+      counts[records[i * stride + depth] + 1]++;
+    }
+    if (counts[records[lo * stride + depth] + 1] == hi - lo) {
+      depth++;
+      continue;
+    }
+    for (size_t b = 0; b < RADIX; b++) {
+      counts[b + 1] += counts[b];
+    }
+    size_t pos[RADIX];
+    memcpy(pos, counts, sizeof(pos));
+    for (size_t i = lo; i < hi; i++) {
+      const unsigned char* record = records+(i * stride);
+      memcpy(ns->aux+((lo + pos[record[depth]]++) * stride), record, stride);
+    }
+    memcpy(records+(lo * stride), ns->aux+(lo * stride), (hi - lo) * stride);
+    SORT_STATS_ADD(bytes_moved, 2 * (hi - lo) * stride);
+    for (size_t b = 0; b < RADIX; b++) {
+      if (counts[b + 1] - counts[b] > 1) {
+        normkey_msd(ns, lo + counts[b], lo + counts[b + 1], depth + 1);
+      }
+    }
+    return;
+  }
+  if (depth < ns->width) {
+    normkey_insert(ns, lo, hi, depth);
+  }
+}
+
+/**
+ * @brief Sort a few records by insertion, comparing normalized key bytes
+ * from depth onwards with memcmp().
+ *
+ * @param ns Sort in progress.
+ * @param lo First record.
+ * @param hi Record after last.
+ * @param depth Bytes which all records share.
+ * @return Void.
+ */
+void
+normkey_insert(NormKeySort* ns, size_t lo, size_t hi, size_t depth)
+{
+  const size_t stride = ns->stride;
+  const size_t nbytes = ns->width - depth;
+  unsigned char* records = ns->records;
+  // Space in aux beyond [lo, hi) may belong to no other bucket, but aux[lo]
+  // is free while this bucket is being sorted.
+  unsigned char* selected = ns->aux+(lo * stride);
+  for (size_t i = lo + 1; i < hi; i++) {
+    size_t j = i;
+    memcpy(selected, records+(i * stride), stride);
+    while (j > lo && memcmp(records+((j - 1) * stride + depth),
+                            selected+(depth), nbytes) > 0) {
+      j--;
+    }
+    if (j < i) {
+      memmove(records+((j + 1) * stride), records+(j * stride),
+              (i - j) * stride);
+      memcpy(records+(j * stride), selected, stride);
+      SORT_STATS_ADD(bytes_moved, (i - j + 2) * stride);
+    }
+  }
+}
+
+/**
+ * @brief Compare elements whose normalized keys were truncated, for
+ * cosort_indices().
+ *
+ * @param a First element.
+ * @param b Second element.
+ * @param ctx Sort in progress (NormKeySort).
+ * @return Result of order_by_compare().
+ */
+int
+normkey_fallback_compare(const void* a, const void* b, void* ctx)
+{
+  const NormKeySort* ns = (const NormKeySort*) ctx;
+  return order_by_compare(a, b, ns->keys, ns->nkeys);
+}
+
+/**
+ * @brief Check whether normalized key has a NULL rank byte for key.
+ *
+ * @param key Key to check.
+ * @return Returns 1 if key may be NULL, else 0.
+ */
+int
+normkey_nullable(const SortKeySpec* key)
+{
+  return key->null_offset != ORDER_BY_NOT_NULL || key->type == SORT_KEY_STR;
+}
+
+/**
+ * @brief Get bytes of string key kept in normalized key.
+ *
+ * @param key String key.
+ * @return Prefix length.
+ */
+size_t
+normkey_prefix(const SortKeySpec* key)
+{
+  return key->prefix > 0 ? key->prefix : NORMKEY_STR_PREFIX;
+}
+
+/** @} */
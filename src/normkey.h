@@ -0,0 +1,32 @@
+/**
+ * @file
+ * @brief Normalized (memcmp-comparable) sort key header file.
+ */
+#ifndef MY_NORMKEY_
+#define MY_NORMKEY_
+
+#include <stdlib.h>
+
+#include "order_by.h"
+
+/**
+ * @def NORMKEY_STR_PREFIX
+ * @brief Default bytes of each string key kept in a normalized key. */
+#define NORMKEY_STR_PREFIX 16
+/**
+ * @def NORMKEY_SMALL_NELEMS
+ * @brief Maximum bucket length which normkey_sort() sorts by insertion
+ * rather than by another radix pass. */
+#define NORMKEY_SMALL_NELEMS 32
+
+//##############################################################################
+//# NORMALIZED KEYS
+//##############################################################################
+
+size_t normkey_width(const SortKeySpec* keys, size_t nkeys);
+int normkey_encode(const SortKeySpec* keys, size_t nkeys, const void* elem,
+                   unsigned char* out);
+void normkey_sort(void* arr, size_t nelems, size_t size,
+                  const SortKeySpec* keys, size_t nkeys);
+
+#endif /* MY_NORMKEY_ */
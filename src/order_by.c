@@ -0,0 +1,553 @@
+/**
+ * @file
+ * @brief ORDER BY-style multi-key sort implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "order_by.h"
+#include "cosort.h"
+#include "sorting.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup OrderBy
+ * @def ORDER_BY_SCATTER
+ * @brief Move digit strings of a constant width to the positions counted for
+ * digit d, so that each move compiles to a few loads and stores. */
+#define ORDER_BY_SCATTER(dst, src, nelems, width, offsets, d) \
+  for (size_t i = 0; i < (nelems); i++) { \
+    const unsigned char* digits = (src)+(i * (width)); \
+    memcpy((dst)+((offsets)[digits[d]]++ * (width)), digits, (width)); \
+  }
+
+/**
+ * @ingroup OrderBy
+ * @struct OrderByEntry
+ * @brief Struct to represent the current key of an element being sorted.
+ */
+typedef struct OrderByEntry {
+  uint64_t key; ///< Encoded fixed-width key (see sort_key_encode()).
+  const char* str; ///< String key.
+  size_t index; ///< Index of element in array.
+} OrderByEntry;
+
+/**
+ * @ingroup OrderBy
+ * @struct OrderBy
+ * @brief Struct to represent a multi-key sort in progress.
+ */
+typedef struct OrderBy {
+  const char* arr; ///< Array being sorted (not moved until the end).
+  size_t size; ///< Size of each element in array.
+  const SortKeySpec* keys; ///< Keys, most significant first.
+  size_t nkeys; ///< Number of keys.
+  size_t* perm; ///< Elements in current order.
+  OrderByEntry* entries; ///< Keys of the elements being sorted.
+  CosortEntry* radix; ///< Keys and space for radix passes (2 * nelems).
+} OrderBy;
+
+static void order_by_lsd(OrderBy* ob, size_t nelems);
+static void order_by_group(OrderBy* ob, size_t lo, size_t hi, size_t k);
+static int order_by_key_equal(const OrderBy* ob, const SortKeySpec* key,
+                              size_t a, size_t b);
+static const char* sort_key_str(const SortKeySpec* key, const void* elem);
+static int order_by_entry_compare(const void* a, const void* b);
+static int order_by_entry_compare_str(const void* a, const void* b);
+static int order_by_entry_compare_str_desc(const void* a, const void* b);
+
+/**
+ * @addtogroup OrderBy
+ * @{
+ */
+
+/**
+ * @brief Sort generic array lexicographically by several typed keys.
+ *
+ * Keys are fields of each element, described by SortKeySpec: the first key
+ * decides, then the second breaks ties, and so on, each in its own direction
+ * and with NULLs first or last (as in SQL's ORDER BY). No comparison function
+ * is called through a pointer per comparison:
+ *
+ * - If every key has a fixed width, elements are sorted by LSD radix over
+ *   the key list, least significant key first. Each key is encoded so that
+ *   unsigned order is the requested order (see sort_key_encode()), and sorted
+ *   a byte at a time by stable counting passes, skipping bytes which are
+ *   equal for every element. A nullable key takes one more pass on its NULL
+ *   rank.
+ * - Otherwise, elements are sorted by the first key only, and then each
+ *   group of elements with equal first keys is sorted by the second key,
+ *   and so on. Later keys are therefore only compared within groups which
+ *   are tied on every earlier key. Fixed-width keys are still sorted by
+ *   radix in groups of ORDER_BY_RADIX_NELEMS or more elements.
+ *
+ * Keys are sorted along with element indices, and elements are moved once,
+ * at the end (see cosort_apply()). The sort is stable.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param keys Keys, most significant first.
+ * @param nkeys Number of keys.
+ * @return Void.
+ *
+ * @see order_by_compare()
+ */
+void
+order_by(void* arr, size_t nelems, size_t size,
+         const SortKeySpec* keys, size_t nkeys)
+{
+  if (nelems < 2 || nkeys == 0) {
+    return;
+  }
+  OrderBy ob = {
+    (const char*) arr, size, keys, nkeys, malloc(nelems * sizeof(size_t)),
+    NULL, NULL
+  };
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, nelems * sizeof(size_t));
+  int fixed = 1;
+  for (size_t k = 0; k < nkeys; k++) {
+    fixed &= keys[k].type != SORT_KEY_STR;
+  }
+  if (fixed) {
+    order_by_lsd(&ob, nelems);
+  } else {
+    ob.entries = malloc(nelems * sizeof(OrderByEntry));
+    ob.radix = malloc(2 * nelems * sizeof(CosortEntry));
+    SORT_STATS_ADD(allocs, 2);
+    SORT_STATS_ADD(aux_bytes, nelems * sizeof(OrderByEntry)
+                              + 2 * nelems * sizeof(CosortEntry));
+    for (size_t i = 0; i < nelems; i++) {
+      ob.perm[i] = i;
+    }
+    order_by_group(&ob, 0, nelems, 0);
+    free(ob.entries);
+    free(ob.radix);
+  }
+  cosort_apply(arr, nelems, size, ob.perm, NULL);
+  free(ob.perm);
+}
+
+/**
+ * @brief Compare elements lexicographically by several typed keys.
+ *
+ * The order order_by() sorts into, for use where a single comparison is
+ * needed.
+ *
+ * @param a First element.
+ * @param b Second element.
+ * @param keys Keys, most significant first.
+ * @param nkeys Number of keys.
+ * @return Negative if a comes first, positive if b comes first, else 0.
+ */
+int
+order_by_compare(const void* a, const void* b,
+                 const SortKeySpec* keys, size_t nkeys)
+{
+  for (size_t k = 0; k < nkeys; k++) {
+    const SortKeySpec* key = &keys[k];
+    const int anull = sort_key_is_null(key, a);
+    const int bnull = sort_key_is_null(key, b);
+    if (anull || bnull) {
+      if (anull != bnull) {
+        return (anull == (key->nulls == SORT_KEY_NULLS_FIRST)) ? -1 : 1;
+      }
+      continue;
+    }
+    int cmp;
+    if (key->type == SORT_KEY_STR) {
+      cmp = strcmp(sort_key_str(key, a), sort_key_str(key, b));
+      cmp = (cmp > 0) - (cmp < 0);
+      cmp = key->order == SORT_KEY_DESC ? -cmp : cmp;
+    } else {
+      const uint64_t akey = sort_key_encode(key, a);
+      const uint64_t bkey = sort_key_encode(key, b);
+      cmp = (akey > bkey) - (akey < bkey);
+    }
+    if (cmp != 0) {
+      return cmp;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Check whether key of element is NULL.
+ *
+ * @param key Key to check.
+ * @param elem Element containing key.
+ * @return Returns 1 if key is NULL, else 0.
+ */
+int
+sort_key_is_null(const SortKeySpec* key, const void* elem)
+{
+  if (key->null_offset != ORDER_BY_NOT_NULL
+      && ((const unsigned char*) elem)[key->null_offset] != 0) {
+    return 1;
+  }
+  return key->type == SORT_KEY_STR && sort_key_str(key, elem) == NULL;
+}
+
+/**
+ * @brief Encode fixed-width key so that unsigned order is the key's order.
+ *
+ * Signed integers have their sign bit flipped. Floats have their sign bit
+ * set if positive, or all bits flipped if negative, after -0.0 is made 0.0
+ * and every NaN the same positive NaN. Descending keys are then inverted.
+ * Keys of 4 bytes occupy the low 32 bits.
+ *
+ * @param key Key to encode.
+ * @param elem Element containing key.
+ * @return Encoded key, or 0 if key is NULL or a string.
+ */
+uint64_t
+sort_key_encode(const SortKeySpec* key, const void* elem)
+{
+  const char* field = (const char*) elem + key->offset;
+  uint64_t bits;
+  if (sort_key_is_null(key, elem)) {
+    return 0;
+  }
+  switch (key->type) {
+    case SORT_KEY_I32: {
+      uint32_t u;
+      memcpy(&u, field, sizeof(u));
+      bits = u ^ ((uint32_t) 1 << 31);
+      break;
+    }
+    case SORT_KEY_I64:
+      memcpy(&bits, field, sizeof(bits));
+      bits ^= (uint64_t) 1 << 63;
+      break;
+    case SORT_KEY_U32: {
+      uint32_t u;
+      memcpy(&u, field, sizeof(u));
+      bits = u;
+      break;
+    }
+    case SORT_KEY_U64:
+      memcpy(&bits, field, sizeof(bits));
+      break;
+    case SORT_KEY_F32: {
+      float f;
+      uint32_t u;
+      memcpy(&f, field, sizeof(f));
+      f = (f == 0) ? 0.0f : f;
+      memcpy(&u, &f, sizeof(u));
+      u = (f != f) ? 0x7FC00000u : u;
+      bits = (u >> 31) ? (uint32_t) ~u : u | ((uint32_t) 1 << 31);
+      break;
+    }
+    case SORT_KEY_F64: {
+      double f;
+      memcpy(&f, field, sizeof(f));
+      f = (f == 0) ? 0.0 : f;
+      memcpy(&bits, &f, sizeof(bits));
+      bits = (f != f) ? 0x7FF8000000000000ULL : bits;
+      bits = (bits >> 63) ? ~bits : bits | ((uint64_t) 1 << 63);
+      break;
+    }
+    default:
+      return 0;
+  }
+  if (key->order == SORT_KEY_DESC) {
+    bits = sort_key_width(key->type) == 8 ? ~bits : (uint32_t) ~bits;
+  }
+  return bits;
+}
+
+/**
+ * @brief Get width of encoded key.
+ *
+ * @param type Type of key.
+ * @return Bytes in encoded key, or 0 for strings (which have no fixed-width
+ * encoding).
+ */
+size_t
+sort_key_width(SortKeyType type)
+{
+  switch (type) {
+    case SORT_KEY_I32:
+    case SORT_KEY_U32:
+    case SORT_KEY_F32:
+      return 4;
+    case SORT_KEY_STR:
+      return 0;
+    default:
+      return 8;
+  }
+}
+
+/**
+ * @brief Sort all elements by LSD radix over the key list.
+ *
+ * Every key of an element is encoded, once, into a single digit string
+ * followed by the element's index: the last key's bytes first, least
+ * significant first, each followed by its NULL rank if nullable. Stable
+ * counting passes over the digits, first to last, then sort by the last key
+ * first and the first key last. Passes move whole digit strings
+ * sequentially, so elements are only read while encoding.
+ *
+ * @param ob Sort in progress, with fixed-width keys only.
+ * @param nelems Number of elements in array.
+ * @return Void.
+ */
+void
+order_by_lsd(OrderBy* ob, size_t nelems)
+{
+  enum { RADIX = 256 };
+  size_t ndigits = 0;
+  for (size_t k = 0; k < ob->nkeys; k++) {
+    ndigits += sort_key_width(ob->keys[k].type)
+               + (ob->keys[k].null_offset != ORDER_BY_NOT_NULL);
+  }
+  // Narrow indices keep digit strings, moved by every pass, short.
+  const int narrow = nelems <= UINT32_MAX;
+  const size_t index_size = narrow ? sizeof(uint32_t) : sizeof(size_t);
+  const size_t index_offset = ndigits;
+  const size_t stride = (ndigits + index_size + sizeof(uint64_t) - 1)
+                        / sizeof(uint64_t) * sizeof(uint64_t);
+  unsigned char* src = malloc(nelems * stride);
+  unsigned char* dst = malloc(nelems * stride);
+  size_t (*counts)[RADIX] = calloc(ndigits, sizeof(*counts));
+  SORT_STATS_ADD(allocs, 3);
+  SORT_STATS_ADD(aux_bytes, 2 * nelems * stride 
+                            + ndigits * sizeof(*counts));
+
+  for (size_t i = 0; i < nelems; i++) {
+    unsigned char* digits = src+(i * stride);
+    const char* elem = ob->arr+(i * ob->size);
+    size_t d = 0;
+    for (size_t k = ob->nkeys; k-- > 0;) {
+      const SortKeySpec* key = &ob->keys[k];
+      const uint64_t bits = sort_key_encode(key, elem);
+      const size_t width = sort_key_width(key->type);
+      for (size_t b = 0; b < width; b++) {
+        digits[d++] = (unsigned char)(bits >> (8 * b));
+      }
+      if (key->null_offset != ORDER_BY_NOT_NULL) {
+        digits[d++] = sort_key_is_null(key, elem)
+                      ^ (key->nulls == SORT_KEY_NULLS_FIRST);
+      }
+    }
+    if (narrow) {
+      uint32_t index = (uint32_t) i;
+      memcpy(digits+(index_offset), &index, sizeof(index));
+    } else {
+      memcpy(digits+(index_offset), &i, sizeof(i));
+    }
+    for (d = 0; d < ndigits; d++) {
+      counts[d][digits[d]]++;
+    }
+  }
+
+  for (size_t d = 0; d < ndigits; d++) {
+    if (counts[d][src[d]] == nelems) {
+      continue;
+    }
+    size_t pos = 0;
+    for (size_t v = 0; v < RADIX; v++) {
+      size_t count = counts[d][v];
+      counts[d][v] = pos;
+      pos += count;
+    }
+    switch (stride) {
+      case 16:
+        ORDER_BY_SCATTER(dst, src, nelems, 16, counts[d], d);
+        break;
+      case 24:
+        ORDER_BY_SCATTER(dst, src, nelems, 24, counts[d], d);
+        break;
+      case 32:
+        ORDER_BY_SCATTER(dst, src, nelems, 32, counts[d], d);
+        break;
+      default:
+        ORDER_BY_SCATTER(dst, src, nelems, stride, counts[d], d);
+        break;
+    }
+    SORT_STATS_ADD(bytes_moved, nelems * stride);
+    unsigned char* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  for (size_t i = 0; i < nelems; i++) {
+    if (narrow) {
+      uint32_t index;
+      memcpy(&index, src+(i * stride + index_offset), sizeof(index));
+      ob->perm[i] = index;
+    } else {
+      memcpy(&ob->perm[i], src+(i * stride + index_offset), sizeof(size_t));
+    }
+  }
+  free(src);
+  free(dst);
+  free(counts);
+}
+
+/**
+ * @brief Sort range of elements by key k, then each group of equal keys by
+ * the keys after it.
+ *
+ * NULL keys are first moved, stably, to their end of the range, where they
+ * form one group.
+ *
+ * @param ob Sort in progress.
+ * @param lo First element of range (index into perm).
+ * @param hi Element after range.
+ * @param k Key to sort by.
+ * @return Void.
+ */
+void
+order_by_group(OrderBy* ob, size_t lo, size_t hi, size_t k)
+{
+  if (hi - lo < 2 || k == ob->nkeys) {
+    return;
+  }
+  const SortKeySpec* key = &ob->keys[k];
+  size_t* perm = ob->perm;
+  OrderByEntry* entries = ob->entries;
+
+  size_t nnulls = 0;
+  size_t nvalues = 0;
+  for (size_t i = lo; i < hi; i++) {
+    if (sort_key_is_null(key, ob->arr+(perm[i] * ob->size))) {
+      entries[nnulls++].index = perm[i];
+    } else {
+      perm[lo + nvalues++] = perm[i];
+    }
+  }
+  const int nulls_first = key->nulls == SORT_KEY_NULLS_FIRST;
+  const size_t nulls_lo = nulls_first ? lo : lo + nvalues;
+  const size_t values_lo = nulls_first ? lo + nnulls : lo;
+  if (nnulls > 0) {
+    memmove(&perm[values_lo], &perm[lo], nvalues * sizeof(size_t));
+    for (size_t i = 0; i < nnulls; i++) {
+      perm[nulls_lo + i] = entries[i].index;
+    }
+  }
+
+  if (key->type != SORT_KEY_STR && nvalues >= ORDER_BY_RADIX_NELEMS) {
+    CosortEntry* radix = ob->radix;
+    for (size_t i = 0; i < nvalues; i++) {
+      radix[i].key = sort_key_encode(key,
+                                     ob->arr+(perm[values_lo + i] * ob->size));
+      radix[i].index = perm[values_lo + i];
+    }
+    const CosortEntry* sorted = cosort_radix(radix, radix + nvalues, nvalues,
+                                             sort_key_width(key->type));
+    for (size_t i = 0; i < nvalues; i++) {
+      perm[values_lo + i] = sorted[i].index;
+    }
+  } else {
+    for (size_t i = 0; i < nvalues; i++) {
+      const char* elem = ob->arr+(perm[values_lo + i] * ob->size);
+      entries[i].index = perm[values_lo + i];
+      if (key->type == SORT_KEY_STR) {
+        entries[i].str = sort_key_str(key, elem);
+      } else {
+        entries[i].key = sort_key_encode(key, elem);
+      }
+    }
+    int (*compare)(const void*, const void*) = order_by_entry_compare;
+    if (key->type == SORT_KEY_STR) {
+      compare = key->order == SORT_KEY_DESC
+                ? order_by_entry_compare_str_desc : order_by_entry_compare_str;
+    }
+    merge_sort_tiled(entries, nvalues, sizeof(OrderByEntry), compare);
+    for (size_t i = 0; i < nvalues; i++) {
+      perm[values_lo + i] = entries[i].index;
+    }
+  }
+
+  // Entries are reused by each group, so groups are found again from perm.
+  size_t start = values_lo;
+  for (size_t i = values_lo + 1; i <= values_lo + nvalues; i++) {
+    if (i == values_lo + nvalues
+        || !order_by_key_equal(ob, key, perm[start], perm[i])) {
+      order_by_group(ob, start, i, k + 1);
+      start = i;
+    }
+  }
+  order_by_group(ob, nulls_lo, nulls_lo + nnulls, k + 1);
+}
+
+/**
+ * @brief Check whether two non-NULL keys are equal.
+ *
+ * @param ob Sort in progress.
+ * @param key Key to check.
+ * @param a Index of first element.
+ * @param b Index of second element.
+ * @return Returns 1 if equal, else 0.
+ */
+int
+order_by_key_equal(const OrderBy* ob, const SortKeySpec* key,
+                   size_t a, size_t b)
+{
+  const char* aelem = ob->arr+(a * ob->size);
+  const char* belem = ob->arr+(b * ob->size);
+  if (key->type == SORT_KEY_STR) {
+    return strcmp(sort_key_str(key, aelem), sort_key_str(key, belem)) == 0;
+  }
+  return sort_key_encode(key, aelem) == sort_key_encode(key, belem);
+}
+
+/**
+ * @brief Get string key of element.
+ *
+ * @param key String key.
+ * @param elem Element containing key.
+ * @return String, or NULL.
+ */
+const char*
+sort_key_str(const SortKeySpec* key, const void* elem)
+{
+  const char* str;
+  memcpy(&str, (const char*) elem + key->offset, sizeof(str));
+  return str;
+}
+
+/**
+ * @brief Compare entries by encoded key.
+ *
+ * @param a First entry.
+ * @param b Second entry.
+ * @return Negative, zero or positive as a's key is less, equal or greater.
+ */
+int
+order_by_entry_compare(const void* a, const void* b)
+{
+  uint64_t akey = ((const OrderByEntry*) a)->key;
+  uint64_t bkey = ((const OrderByEntry*) b)->key;
+  return (akey < bkey) ? -1 : (akey > bkey);
+}
+
+/**
+ * @brief Compare entries by string key, ascending.
+ *
+ * @param a First entry.
+ * @param b Second entry.
+ * @return Negative, zero or positive as a's key is less, equal or greater.
+ */
+int
+order_by_entry_compare_str(const void* a, const void* b)
+{
+  return strcmp(((const OrderByEntry*) a)->str, ((const OrderByEntry*) b)->str);
+}
+
+/**
+ * @brief Compare entries by string key, descending.
+ *
+ * @param a First entry.
+ * @param b Second entry.
+ * @return Negative, zero or positive as a's key is greater, equal or less.
+ */
+int
+order_by_entry_compare_str_desc(const void* a, const void* b)
+{
+  return strcmp(((const OrderByEntry*) b)->str, ((const OrderByEntry*) a)->str);
+}
+
+/** @} */
@@ -0,0 +1,89 @@
+/**
+ * @file
+ * @brief ORDER BY-style multi-key sort header file.
+ */
+#ifndef MY_ORDER_BY_
+#define MY_ORDER_BY_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def ORDER_BY_NOT_NULL
+ * @brief SortKeySpec null_offset of keys which are never NULL. */
+#define ORDER_BY_NOT_NULL SIZE_MAX
+/**
+ * @def ORDER_BY_RADIX_NELEMS
+ * @brief Minimum number of elements sorted by radix rather than by comparing
+ * encoded keys. */
+#define ORDER_BY_RADIX_NELEMS 256
+
+/**
+ * @ingroup OrderBy
+ * @enum SortKeyType
+ * @brief Types of sort keys.
+ */
+typedef enum SortKeyType {
+  SORT_KEY_I32, ///< int32_t.
+  SORT_KEY_I64, ///< int64_t.
+  SORT_KEY_U32, ///< uint32_t.
+  SORT_KEY_U64, ///< uint64_t.
+  SORT_KEY_F32, ///< float (NaNs sort after infinity).
+  SORT_KEY_F64, ///< double (NaNs sort after infinity).
+  SORT_KEY_STR ///< Pointer to NUL-terminated string (NULL pointer: NULL).
+} SortKeyType;
+
+/**
+ * @ingroup OrderBy
+ * @enum SortKeyOrder
+ * @brief Directions of sort keys.
+ */
+typedef enum SortKeyOrder {
+  SORT_KEY_ASC, ///< Smallest first.
+  SORT_KEY_DESC ///< Largest first.
+} SortKeyOrder;
+
+/**
+ * @ingroup OrderBy
+ * @enum SortKeyNulls
+ * @brief Placement of NULL keys, whatever the direction.
+ */
+typedef enum SortKeyNulls {
+  SORT_KEY_NULLS_LAST, ///< After all other keys.
+  SORT_KEY_NULLS_FIRST ///< Before all other keys.
+} SortKeyNulls;
+
+/**
+ * @ingroup OrderBy
+ * @struct SortKeySpec
+ * @brief Struct to represent one key of a lexicographic sort.
+ */
+typedef struct SortKeySpec {
+  size_t offset; ///< Offset of key within element.
+  SortKeyType type; ///< Type of key.
+  SortKeyOrder order; ///< Direction of key.
+  SortKeyNulls nulls; ///< Placement of NULL keys.
+  size_t null_offset; ///< Offset of byte which is nonzero if key is NULL,
+                      ///< or ORDER_BY_NOT_NULL.
+  size_t prefix; ///< Bytes of string key kept by normalized keys (0:
+                 ///< NORMKEY_STR_PREFIX).
+} SortKeySpec;
+
+//##############################################################################
+//# ORDER BY
+//##############################################################################
+
+void order_by(void* arr, size_t nelems, size_t size,
+              const SortKeySpec* keys, size_t nkeys);
+int order_by_compare(const void* a, const void* b,
+                     const SortKeySpec* keys, size_t nkeys);
+
+//##############################################################################
+//# SORT KEYS
+//##############################################################################
+
+int sort_key_is_null(const SortKeySpec* key, const void* elem);
+uint64_t sort_key_encode(const SortKeySpec* key, const void* elem);
+size_t sort_key_width(SortKeyType type);
+
+#endif /* MY_ORDER_BY_ */
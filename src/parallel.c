@@ -0,0 +1,130 @@
+/**
+ * @file
+ * @brief Parallel loop implementation.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "parallel.h"
+#include "trace.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup Parallel
+ * @struct ParallelLoop
+ * @brief Struct to represent a loop shared by the threads of parallel_for().
+ */
+typedef struct ParallelLoop {
+  size_t n; ///< Number of iterations.
+  size_t next; ///< Next unclaimed iteration (updated atomically).
+  void (*fn)(size_t i, void* ctx); ///< Loop body.
+  void* ctx; ///< Argument passed to loop body.
+} ParallelLoop;
+
+static void* parallel_worker(void* arg);
+static void* parallel_thread(void* arg);
+
+/**
+ * @addtogroup Parallel
+ * @{
+ */
+
+/**
+ * @brief Get number of online processors.
+ *
+ * @return Number of processors (at least 1).
+ */
+size_t
+parallel_ncpus()
+{
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  return ncpus > 0 ? (size_t) ncpus : 1;
+}
+
+/**
+ * @brief Call fn(i, ctx) for every i in [0, n), spread across threads.
+ *
+ * Iterations are claimed one at a time, so iterations of uneven cost are
+ * balanced across threads. The calling thread takes part, and the function
+ * returns once every iteration has completed. Iterations may run in any order
+ * and must not depend on one another.
+ *
+ * If threads cannot be created, the remaining iterations run on fewer
+ * threads (at worst, all on the calling thread).
+ *
+ * @param n Number of iterations.
+ * @param nthreads Maximum number of threads, including the calling thread. If
+ * 0, one per processor.
+ * @param fn Loop body.
+ * @param ctx Argument passed to every call of fn.
+ * @return Void.
+ */
+void
+parallel_for(size_t n, size_t nthreads, void (*fn)(size_t i, void* ctx),
+             void* ctx)
+{
+  if (nthreads == 0) {
+    nthreads = parallel_ncpus();
+  }
+  if (nthreads > n) {
+    nthreads = n;
+  }
+  ParallelLoop loop = { n, 0, fn, ctx };
+  if (nthreads <= 1) {
+    parallel_worker(&loop);
+    return;
+  }
+
+  pthread_t* threads = malloc((nthreads - 1) * sizeof(pthread_t));
+  size_t started = 0;
+  while (started < nthreads - 1
+         && pthread_create(&threads[started], NULL, parallel_thread,
+                           &loop) == 0) {
+    started++;
+  }
+  parallel_worker(&loop);
+  for (size_t t = 0; t < started; t++) {
+    pthread_join(threads[t], NULL);
+  }
+  free(threads);
+}
+
+/**
+ * @brief Run iterations of loop until none are left unclaimed.
+ *
+ * Each iteration is traced as a "parallel_task" phase of the thread which ran
+ * it, with its index.
+ *
+ * @param arg Loop to run (ParallelLoop).
+ * @return NULL.
+ */
+void*
+parallel_worker(void* arg)
+{
+  ParallelLoop* loop = (ParallelLoop*) arg;
+  size_t i;
+  while ((i = __atomic_fetch_add(&loop->next, 1, __ATOMIC_RELAXED)) < loop->n) {
+    TRACE_BEGIN_ARGS("parallel_task", "index", i, "ntasks", loop->n);
+    loop->fn(i, loop->ctx);
+    TRACE_END("parallel_task");
+  }
+  return NULL;
+}
+
+/**
+ * @brief Run loop on a thread started by parallel_for().
+ *
+ * @param arg Loop to run (ParallelLoop).
+ * @return NULL.
+ */
+void*
+parallel_thread(void* arg)
+{
+  TRACE_THREAD_NAME("parallel_for worker");
+  return parallel_worker(arg);
+}
+
+/** @} */
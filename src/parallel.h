@@ -0,0 +1,18 @@
+/**
+ * @file
+ * @brief Parallel loop header file.
+ */
+#ifndef MY_PARALLEL_
+#define MY_PARALLEL_
+
+#include <stdlib.h>
+
+//##############################################################################
+//# PARALLEL
+//##############################################################################
+
+size_t parallel_ncpus();
+void parallel_for(size_t n, size_t nthreads,
+                  void (*fn)(size_t i, void* ctx), void* ctx);
+
+#endif /* MY_PARALLEL_ */
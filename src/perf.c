@@ -0,0 +1,279 @@
+/**
+ * @file
+ * @brief Hardware performance counter implementation.
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perf.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup Perf
+ * @brief Maximum nesting depth of phases.
+ */
+enum { PERF_MAX_DEPTH = 16 };
+
+/**
+ * @ingroup Perf
+ * @brief State used to attribute counts to phases.
+ */
+static struct {
+  PerfCounters* pc; ///< Attached counters (NULL: phases disabled).
+  PerfSample last; ///< Counts at last phase transition.
+  PerfSample totals[PERF_NUM_PHASES]; ///< Counts attributed to each phase.
+  PerfPhase stack[PERF_MAX_DEPTH]; ///< Stack of entered phases.
+  int depth; ///< Current number of entered phases.
+} perf_phases;
+
+static void perf_phase_attribute(PerfSample now);
+
+/**
+ * @addtogroup Perf
+ * @{
+ */
+
+/**
+ * @brief Open a counter for each event for the calling thread.
+ *
+ * Counters are opened independently, so that events which the CPU or kernel
+ * do not support are simply marked unavailable.
+ *
+ * @param pc Counters to open.
+ * @return Number of events which can be counted (0 if none).
+ */
+int
+perf_counters_open(PerfCounters* pc)
+{
+  int available = 0;
+  memset(pc, 0, sizeof(PerfCounters));
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    pc->fds[e] = -1;
+#ifdef __linux__
+    static const uint64_t configs[PERF_NUM_EVENTS] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_BRANCH_MISSES,
+      PERF_COUNT_HW_CACHE_MISSES
+    };
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[e];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    pc->fds[e] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (pc->fds[e] >= 0) {
+      ioctl(pc->fds[e], PERF_EVENT_IOC_RESET, 0);
+      ioctl(pc->fds[e], PERF_EVENT_IOC_ENABLE, 0);
+      available++;
+    } else {
+      pc->fds[e] = -1;
+    }
+#endif
+  }
+  return available;
+}
+
+/**
+ * @brief Close all counters.
+ *
+ * @param pc Counters to close.
+ * @return Void.
+ */
+void
+perf_counters_close(PerfCounters* pc)
+{
+  if (perf_phases.pc == pc) {
+    perf_phases_detach();
+  }
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    if (pc->fds[e] >= 0) {
+      close(pc->fds[e]);
+      pc->fds[e] = -1;
+    }
+  }
+}
+
+/**
+ * @brief Read current (running) value of all counters.
+ *
+ * @param pc Counters to read.
+ * @return Current counts. Unavailable events read as 0.
+ */
+PerfSample
+perf_counters_read(PerfCounters* pc)
+{
+  PerfSample sample;
+  memset(&sample, 0, sizeof(sample));
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    if (pc->fds[e] >= 0
+        && read(pc->fds[e], &sample.values[e], sizeof(uint64_t))
+           == sizeof(uint64_t)) {
+      sample.valid[e] = 1;
+    } else {
+      sample.values[e] = 0;
+    }
+  }
+  return sample;
+}
+
+/**
+ * @brief Begin bracketing a region of code (e.g. a single sort call).
+ *
+ * @param pc Counters to use.
+ * @return Void.
+ *
+ * @see perf_counters_stop()
+ */
+void
+perf_counters_start(PerfCounters* pc)
+{
+  pc->start = perf_counters_read(pc);
+}
+
+/**
+ * @brief End bracketing a region of code.
+ *
+ * @param pc Counters to use.
+ * @return Counts accumulated since matching perf_counters_start().
+ */
+PerfSample
+perf_counters_stop(PerfCounters* pc)
+{
+  PerfSample sample = perf_counters_read(pc);
+  for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+    sample.values[e] -= pc->start.values[e];
+  }
+  return sample;
+}
+
+/**
+ * @brief Get printable name of event.
+ *
+ * @param event Event to name.
+ * @return Name of event (e.g. "branch_misses").
+ */
+const char*
+perf_event_name(PerfEvent event)
+{
+  static const char* names[PERF_NUM_EVENTS] = {
+    "cycles", "instructions", "branch_misses", "cache_misses"
+  };
+  return event < PERF_NUM_EVENTS ? names[event] : "unknown";
+}
+
+/**
+ * @brief Start attributing counts to the phases of sorts built with
+ * -DSORT_PERF.
+ *
+ * Resets all phase totals.
+ *
+ * @param pc Open counters to read at each phase transition.
+ * @return Void.
+ *
+ * @see perf_phase_total()
+ */
+void
+perf_phases_attach(PerfCounters* pc)
+{
+  memset(&perf_phases, 0, sizeof(perf_phases));
+  perf_phases.pc = pc;
+}
+
+/**
+ * @brief Stop attributing counts to phases.
+ *
+ * Phase totals are kept until next call to perf_phases_attach().
+ *
+ * @return Void.
+ */
+void
+perf_phases_detach()
+{
+  perf_phases.pc = NULL;
+  perf_phases.depth = 0;
+}
+
+/**
+ * @brief Get counts attributed to phase since perf_phases_attach().
+ *
+ * @param phase Phase to query.
+ * @return Counts attributed to phase.
+ */
+PerfSample
+perf_phase_total(PerfPhase phase)
+{
+  return perf_phases.totals[phase];
+}
+
+/**
+ * @brief Enter phase.
+ *
+ * Counts since the previous transition are attributed to the enclosing phase
+ * (if any). Phases nest, and counts are always attributed to the innermost
+ * phase.
+ *
+ * @param phase Phase being entered.
+ * @return Void.
+ */
+void
+perf_phase_enter(PerfPhase phase)
+{
+  if (perf_phases.pc == NULL) {
+    return;
+  }
+  perf_phase_attribute(perf_counters_read(perf_phases.pc));
+  if (perf_phases.depth < PERF_MAX_DEPTH) {
+    perf_phases.stack[perf_phases.depth] = phase;
+  }
+  perf_phases.depth++;
+}
+
+/**
+ * @brief Exit innermost phase.
+ *
+ * @return Void.
+ */
+void
+perf_phase_exit()
+{
+  if (perf_phases.pc == NULL || perf_phases.depth == 0) {
+    return;
+  }
+  perf_phase_attribute(perf_counters_read(perf_phases.pc));
+  perf_phases.depth--;
+}
+
+/**
+ * @brief Attribute counts since previous transition to innermost phase.
+ *
+ * @param now Current counts.
+ * @return Void.
+ */
+void
+perf_phase_attribute(PerfSample now)
+{
+  if (perf_phases.depth > 0 && perf_phases.depth <= PERF_MAX_DEPTH) {
+    PerfSample* total = &perf_phases.totals[
+      perf_phases.stack[perf_phases.depth - 1]];
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+      total->values[e] += now.values[e] - perf_phases.last.values[e];
+      total->valid[e] = now.valid[e];
+    }
+  }
+  perf_phases.last = now;
+}
+
+/** @} */
@@ -0,0 +1,95 @@
+/**
+ * @file
+ * @brief Hardware performance counter header file.
+ *
+ * Counters are read through Linux perf_event_open(). On other platforms, or
+ * where the kernel refuses access (e.g. inside containers), counters are
+ * reported as unavailable and read as zero.
+ *
+ * Sorts attribute counts to their internal phases only when compiled with
+ * -DSORT_PERF (e.g. `make SORT_PERF=1`). Otherwise, the PERF_PHASE_* macros
+ * expand to nothing.
+ */
+#ifndef MY_PERF_
+#define MY_PERF_
+
+#include <stdint.h>
+
+/**
+ * @ingroup Perf
+ * @brief Hardware events which can be counted.
+ */
+typedef enum PerfEvent {
+  PERF_CYCLES, ///< CPU cycles.
+  PERF_INSTRUCTIONS, ///< Retired instructions.
+  PERF_BRANCH_MISSES, ///< Mispredicted branches.
+  PERF_CACHE_MISSES, ///< Last level cache misses.
+  PERF_NUM_EVENTS
+} PerfEvent;
+
+/**
+ * @ingroup Perf
+ * @brief Sort phases to which counts can be attributed.
+ */
+typedef enum PerfPhase {
+  PERF_PHASE_FIND_RUNS, ///< Timsort: run detection and padding.
+  PERF_PHASE_MERGE, ///< Timsort: merging runs.
+  PERF_NUM_PHASES
+} PerfPhase;
+
+/**
+ * @ingroup Perf
+ * @struct PerfSample
+ * @brief Struct to represent counts of each event.
+ */
+typedef struct PerfSample {
+  uint64_t values[PERF_NUM_EVENTS]; ///< Count of each event.
+  int valid[PERF_NUM_EVENTS]; ///< Whether each event could be counted.
+} PerfSample;
+
+/**
+ * @ingroup Perf
+ * @struct PerfCounters
+ * @brief Struct to represent a set of open counters.
+ */
+typedef struct PerfCounters {
+  int fds[PERF_NUM_EVENTS]; ///< Counter file descriptors (-1: unavailable).
+  PerfSample start; ///< Counts at last call to perf_counters_start().
+} PerfCounters;
+
+//##############################################################################
+//# COUNTERS
+//##############################################################################
+
+int perf_counters_open(PerfCounters* pc);
+void perf_counters_close(PerfCounters* pc);
+PerfSample perf_counters_read(PerfCounters* pc);
+void perf_counters_start(PerfCounters* pc);
+PerfSample perf_counters_stop(PerfCounters* pc);
+const char* perf_event_name(PerfEvent event);
+
+//##############################################################################
+//# PHASES
+//##############################################################################
+
+void perf_phases_attach(PerfCounters* pc);
+void perf_phases_detach();
+PerfSample perf_phase_total(PerfPhase phase);
+void perf_phase_enter(PerfPhase phase);
+void perf_phase_exit();
+
+#ifdef SORT_PERF
+/**
+ * @def PERF_PHASE_ENTER
+ * @brief Attribute subsequent counts to phase until matching exit. */
+#define PERF_PHASE_ENTER(phase) perf_phase_enter(phase)
+/**
+ * @def PERF_PHASE_EXIT
+ * @brief Return to attributing counts to enclosing phase. */
+#define PERF_PHASE_EXIT() perf_phase_exit()
+#else
+#define PERF_PHASE_ENTER(phase) ((void)0)
+#define PERF_PHASE_EXIT() ((void)0)
+#endif
+
+#endif /* MY_PERF_ */
@@ -0,0 +1,190 @@
+/**
+ * @file
+ * @brief Prefix sort implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "prefix_sort.h"
+#include "cosort.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup PrefixSort
+ * @struct PrefixSortPair
+ * @brief Struct to represent an element by its key prefix and index.
+ */
+typedef struct PrefixSortPair {
+  uint64_t prefix; ///< Order-preserving prefix of element's key.
+  size_t index; ///< Index of element in array.
+} PrefixSortPair;
+
+static void prefix_sort_pairs(PrefixSortPair* pairs, PrefixSortPair* aux,
+                              size_t nelems);
+static int prefix_sort_compare(const void* a, const void* b, void* ctx);
+
+/**
+ * @addtogroup PrefixSort
+ * @{
+ */
+
+/**
+ * @brief Sort generic array by cached key prefixes, comparing elements only
+ * when their prefixes are equal.
+ *
+ * prefix() must preserve order: if prefix(a) < prefix(b) then a sorts before
+ * b. It is called once per element, and the (prefix, index) pairs are sorted
+ * by a merge sort on integers which never touches the array. Only runs of
+ * equal prefixes are then sorted with compare(). Elements are moved once, at
+ * the end (see cosort_apply()).
+ *
+ * Pays off when elements are large or compare() follows pointers, so that
+ * each comparison would be a cache miss. The sort is stable.
+ *
+ * Uses nelems * (2 * sizeof(PrefixSortPair) + 2 * sizeof(size_t)) bytes of
+ * auxillary space, plus that of cosort_apply().
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to be used to compare elements.
+ * @param prefix Function to get order-preserving key prefix of an element.
+ * @return Void.
+ */
+void
+prefix_sort(void* arr, size_t nelems, size_t size,
+            int (*compare)(const void*, const void*),
+            uint64_t (*prefix)(const void*))
+{
+  SORT_STATS_WRAP(compare);
+  if (nelems < 2) {
+    return;
+  }
+  const char* arr_p = (const char*) arr;
+  PrefixSortPair* pairs = malloc(2 * nelems * sizeof(PrefixSortPair));
+  size_t* perm = malloc(2 * nelems * sizeof(size_t));
+  SORT_STATS_ADD(allocs, 2);
+  SORT_STATS_ADD(aux_bytes, 2 * nelems * (sizeof(PrefixSortPair)
+                                          + sizeof(size_t)));
+  for (size_t i = 0; i < nelems; i++) {
+    pairs[i].prefix = prefix(arr_p+(i * size));
+    pairs[i].index = i;
+  }
+  prefix_sort_pairs(pairs, pairs + nelems, nelems);
+  for (size_t i = 0; i < nelems; i++) {
+    perm[i] = pairs[i].index;
+  }
+
+  size_t start = 0;
+  for (size_t i = 1; i <= nelems; i++) {
+    if (i < nelems && pairs[i].prefix == pairs[start].prefix) {
+      continue;
+    }
+    if (i - start > 1) {
+      cosort_indices(arr_p, size, prefix_sort_compare, &compare,
+                     perm + start, perm + nelems, i - start);
+    }
+    start = i;
+  }
+
+  cosort_apply(arr, nelems, size, perm, NULL);
+  free(pairs);
+  free(perm);
+}
+
+/**
+ * @brief Get order-preserving prefix of string: its first 8 bytes, big-endian
+ * and padded with zeros.
+ *
+ * Strings in strcmp() order have prefixes in ascending order.
+ *
+ * @param str String.
+ * @return Prefix of string.
+ */
+uint64_t
+prefix_sort_str(const char* str)
+{
+  uint64_t prefix = 0;
+  unsigned char c = 1;
+  for (size_t i = 0; i < sizeof(uint64_t); i++) {
+    c = c != '\0' ? (unsigned char) str[i] : 0;
+    prefix = (prefix << 8) | c;
+  }
+  return prefix;
+}
+
+/**
+ * @brief Stably sort pairs by prefix.
+ *
+ * Runs of PREFIX_SORT_RUN pairs are sorted by insertion, then merged
+ * bottom-up between pairs and aux.
+ *
+ * @param pairs Pairs to sort.
+ * @param aux Space for nelems pairs.
+ * @param nelems Number of pairs.
+ * @return Void.
+ */
+void
+prefix_sort_pairs(PrefixSortPair* pairs, PrefixSortPair* aux, size_t nelems)
+{
+  for (size_t lo = 0; lo < nelems; lo += PREFIX_SORT_RUN) {
+    const size_t hi = nelems - lo < PREFIX_SORT_RUN ? nelems
+                                                     : lo + PREFIX_SORT_RUN;
+    for (size_t i = lo + 1; i < hi; i++) {
+      const PrefixSortPair selected = pairs[i];
+      size_t j = i;
+      while (j > lo && pairs[j - 1].prefix > selected.prefix) {
+        pairs[j] = pairs[j - 1];
+        j--;
+      }
+      pairs[j] = selected;
+    }
+  }
+
+  PrefixSortPair* src = pairs;
+  PrefixSortPair* dst = aux;
+  for (size_t width = PREFIX_SORT_RUN; width < nelems; width *= 2) {
+    for (size_t lo = 0; lo < nelems; lo += 2 * width) {
+      const size_t mid = nelems - lo < width ? nelems : lo + width;
+      const size_t hi = nelems - mid < width ? nelems : mid + width;
+      size_t i = lo;
+      size_t j = mid;
+      size_t k = lo;
+      while (i < mid && j < hi) {
+        dst[k++] = src[j].prefix < src[i].prefix ? src[j++] : src[i++];
+      }
+      while (i < mid) {
+        dst[k++] = src[i++];
+      }
+      while (j < hi) {
+        dst[k++] = src[j++];
+      }
+    }
+    SORT_STATS_ADD(merges, 1);
+    PrefixSortPair* swap = src;
+    src = dst;
+    dst = swap;
+  }
+  if (src != pairs) {
+    memcpy(pairs, src, nelems * sizeof(PrefixSortPair));
+  }
+}
+
+/**
+ * @brief Compare elements with equal prefixes, for cosort_indices().
+ *
+ * @param a First element.
+ * @param b Second element.
+ * @param ctx Function to be used to compare elements (pointer to it).
+ * @return Result of the comparison function.
+ */
+int
+prefix_sort_compare(const void* a, const void* b, void* ctx)
+{
+  int (**compare)(const void*, const void*) =
+      (int (**)(const void*, const void*)) ctx;
+  return (*compare)(a, b);
+}
+
+/** @} */
@@ -0,0 +1,25 @@
+/**
+ * @file
+ * @brief Prefix sort header file.
+ */
+#ifndef MY_PREFIX_SORT_
+#define MY_PREFIX_SORT_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def PREFIX_SORT_RUN
+ * @brief Length of runs of prefixes sorted by insertion before merging. */
+#define PREFIX_SORT_RUN 16
+
+//##############################################################################
+//# PREFIX SORT
+//##############################################################################
+
+void prefix_sort(void* arr, size_t nelems, size_t size,
+                 int (*compare)(const void*, const void*),
+                 uint64_t (*prefix)(const void*));
+uint64_t prefix_sort_str(const char* str);
+
+#endif /* MY_PREFIX_SORT_ */
@@ -0,0 +1,279 @@
+/**
+ * @file
+ * @brief Presortedness metrics implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "presorted.h"
+#include "parallel.h"
+#include "sorting.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup Presortedness
+ * @struct PresortednessState
+ * @brief Struct to represent an index sort shared by parallel tasks.
+ */
+typedef struct PresortednessState {
+  const char* arr; ///< Array being measured (never modified).
+  size_t size; ///< Size of each element in array.
+  int (*compare)(const void*, const void*); ///< Function to compare elements.
+  size_t* idx; ///< Indices of elements, sorted in place.
+  size_t* aux; ///< Scratch space for merges.
+  size_t* bounds; ///< Start of each chunk, followed by nelems.
+  size_t nchunks; ///< Number of chunks sorted independently.
+  size_t width; ///< Current merge round: chunks on each side of a merge.
+  uint64_t* inversions; ///< Inversions counted by each task of a round.
+} PresortednessState;
+
+static uint64_t presortedness_sort(PresortednessState* st, size_t lo,
+                                   size_t hi);
+static uint64_t presortedness_merge(PresortednessState* st, size_t lo,
+                                    size_t mid, size_t hi);
+static void presortedness_sort_chunk(size_t i, void* ctx);
+static void presortedness_merge_chunks(size_t i, void* ctx);
+
+/**
+ * @addtogroup Presortedness
+ * @{
+ */
+
+/**
+ * @brief Measure how sorted an array is, without modifying it.
+ *
+ * Arrays of at least PRESORTEDNESS_PARALLEL_NELEMS elements are measured
+ * using one thread per processor.
+ *
+ * @param arr Array to measure.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @return Presortedness of array.
+ *
+ * @see measure_presortedness_parallel()
+ */
+Presortedness
+measure_presortedness(const void* arr, size_t nelems, size_t size,
+                      int (*compare)(const void*, const void*))
+{
+  return measure_presortedness_parallel(
+      arr, nelems, size, compare,
+      nelems >= PRESORTEDNESS_PARALLEL_NELEMS ? 0 : 1);
+}
+
+/**
+ * @brief Measure how sorted an array is, using up to nthreads threads.
+ *
+ * Runs are found with timsort_count_run(), exactly as Timsort would find
+ * them (before padding to minrun).
+ *
+ * Inversions, duplicates and displacements are exact. They are found by merge
+ * sorting an array of element indices, stably, counting inversions as each
+ * merge takes an element from its right half ahead of the elements left in its
+ * left half. The index array is split into one chunk per thread, the chunks
+ * are sorted in parallel, and then merged pairwise in parallel rounds.
+ *
+ * Costs O(nelems log nelems) comparisons and 2 * nelems * sizeof(size_t)
+ * bytes of scratch space.
+ *
+ * @param arr Array to measure.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @param nthreads Maximum number of threads. If 0, one per processor.
+ * @return Presortedness of array.
+ */
+Presortedness
+measure_presortedness_parallel(const void* arr, size_t nelems, size_t size,
+                               int (*compare)(const void*, const void*),
+                               size_t nthreads)
+{
+  const char* arr_p = (const char*) arr;
+  Presortedness p;
+  memset(&p, 0, sizeof(p));
+  p.nelems = nelems;
+  if (nelems == 0) {
+    return p;
+  }
+
+  for (size_t start = 0; start < nelems;) {
+    int descending;
+    size_t len = timsort_count_run(arr_p+(start * size), nelems - start, size,
+                                   compare, &descending);
+    if (descending) {
+      p.desc_runs++;
+    } else {
+      p.asc_runs++;
+    }
+    p.longest_run = len > p.longest_run ? len : p.longest_run;
+    start += len;
+  }
+
+  if (nthreads == 0) {
+    nthreads = parallel_ncpus();
+  }
+  size_t nchunks = nelems / PRESORTEDNESS_LEAF_NELEMS;
+  nchunks = nchunks < nthreads ? nchunks : nthreads;
+  nchunks = nchunks > 0 ? nchunks : 1;
+
+  PresortednessState st = {
+    arr_p, size, compare,
+    malloc(nelems * sizeof(size_t)),
+    malloc(nelems * sizeof(size_t)),
+    malloc((nchunks + 1) * sizeof(size_t)),
+    nchunks, 0,
+    calloc(nchunks, sizeof(uint64_t))
+  };
+  for (size_t i = 0; i < nelems; i++) {
+    st.idx[i] = i;
+  }
+  for (size_t c = 0; c <= nchunks; c++) {
+    st.bounds[c] = c * nelems / nchunks;
+  }
+
+  parallel_for(nchunks, nthreads, presortedness_sort_chunk, &st);
+  for (size_t c = 0; c < nchunks; c++) {
+    p.inversions += st.inversions[c];
+  }
+  for (st.width = 1; st.width < nchunks; st.width *= 2) {
+    size_t nmerges = (nchunks + 2 * st.width - 1) / (2 * st.width);
+    memset(st.inversions, 0, nchunks * sizeof(uint64_t));
+    parallel_for(nmerges, nthreads, presortedness_merge_chunks, &st);
+    for (size_t m = 0; m < nmerges; m++) {
+      p.inversions += st.inversions[m];
+    }
+  }
+
+  for (size_t i = 0; i < nelems; i++) {
+    if (i > 0 && compare(arr_p+(st.idx[i - 1] * size),
+                         arr_p+(st.idx[i] * size)) == 0) {
+      p.duplicates++;
+    }
+    size_t displacement = st.idx[i] > i ? st.idx[i] - i : i - st.idx[i];
+    if (displacement > p.max_displacement) {
+      p.max_displacement = displacement;
+    }
+  }
+
+  free(st.idx);
+  free(st.aux);
+  free(st.bounds);
+  free(st.inversions);
+  return p;
+}
+
+/**
+ * @brief Sort chunk of index array, counting its inversions.
+ *
+ * @param i Chunk to sort.
+ * @param ctx Shared state (PresortednessState).
+ * @return Void.
+ */
+void
+presortedness_sort_chunk(size_t i, void* ctx)
+{
+  PresortednessState* st = (PresortednessState*) ctx;
+  st->inversions[i] = presortedness_sort(st, st->bounds[i], st->bounds[i + 1]);
+}
+
+/**
+ * @brief Merge two adjacent groups of sorted chunks, counting inversions
+ * between them.
+ *
+ * @param i Merge of current round (each merge joins 2 * width chunks).
+ * @param ctx Shared state (PresortednessState).
+ * @return Void.
+ */
+void
+presortedness_merge_chunks(size_t i, void* ctx)
+{
+  PresortednessState* st = (PresortednessState*) ctx;
+  size_t first = i * 2 * st->width;
+  size_t mid = first + st->width;
+  size_t last = mid + st->width;
+  if (mid >= st->nchunks) {
+    return;
+  }
+  last = last < st->nchunks ? last : st->nchunks;
+  st->inversions[i] = presortedness_merge(st, st->bounds[first],
+                                          st->bounds[mid], st->bounds[last]);
+}
+
+/**
+ * @brief Recursively merge sort indices in [lo, hi), counting inversions.
+ *
+ * @param st Shared state.
+ * @param lo Lower index bound (inclusive).
+ * @param hi Upper index bound (exclusive).
+ * @return Number of inversions among elements in [lo, hi).
+ */
+uint64_t
+presortedness_sort(PresortednessState* st, size_t lo, size_t hi)
+{
+  if (hi - lo <= PRESORTEDNESS_LEAF_NELEMS) {
+    // Insertion sort: each shift undoes exactly one inversion.
+    uint64_t inversions = 0;
+    for (size_t i = lo + 1; i < hi; i++) {
+      size_t x = st->idx[i];
+      size_t j = i;
+      while (j > lo && st->compare(st->arr+(st->idx[j - 1] * st->size),
+                                   st->arr+(x * st->size)) > 0) {
+        st->idx[j] = st->idx[j - 1];
+        j--;
+        inversions++;
+      }
+      st->idx[j] = x;
+    }
+    return inversions;
+  }
+  size_t mid = lo + (hi - lo) / 2;
+  return presortedness_sort(st, lo, mid) + presortedness_sort(st, mid, hi)
+         + presortedness_merge(st, lo, mid, hi);
+}
+
+/**
+ * @brief Merge sorted indices in [lo, mid) and [mid, hi), counting
+ * inversions between them.
+ *
+ * @param st Shared state.
+ * @param lo Lower index bound of left half (inclusive).
+ * @param mid Lower index bound of right half (inclusive).
+ * @param hi Upper index bound of right half (exclusive).
+ * @return Number of pairs (left, right) with left > right.
+ */
+uint64_t
+presortedness_merge(PresortednessState* st, size_t lo, size_t mid, size_t hi)
+{
+  const char* arr_p = st->arr;
+  const size_t size = st->size;
+  if (lo == mid || mid == hi
+      || st->compare(arr_p+(st->idx[mid - 1] * size),
+                     arr_p+(st->idx[mid] * size)) <= 0) {
+    return 0;
+  }
+
+  uint64_t inversions = 0;
+  memcpy(st->aux+(lo), st->idx+(lo), (hi - lo) * sizeof(size_t));
+  size_t l = lo;
+  size_t r = mid;
+  size_t k = lo;
+  while (l < mid && r < hi) {
+    if (st->compare(arr_p+(st->aux[r] * size),
+                    arr_p+(st->aux[l] * size)) < 0) {
+      inversions += mid - l;
+      st->idx[k++] = st->aux[r++];
+    } else {
+      st->idx[k++] = st->aux[l++];
+    }
+  }
+  while (l < mid) {
+    st->idx[k++] = st->aux[l++];
+  }
+  while (r < hi) {
+    st->idx[k++] = st->aux[r++];
+  }
+  return inversions;
+}
+
+/** @} */
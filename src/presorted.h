@@ -0,0 +1,48 @@
+/**
+ * @file
+ * @brief Presortedness metrics header file.
+ */
+#ifndef MY_PRESORTED_
+#define MY_PRESORTED_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def PRESORTEDNESS_PARALLEL_NELEMS
+ * @brief Minimum array length measured in parallel by measure_presortedness().
+ */
+#define PRESORTEDNESS_PARALLEL_NELEMS (1 << 16)
+/**
+ * @def PRESORTEDNESS_LEAF_NELEMS
+ * @brief Maximum subarray length counted by insertion rather than merging. */
+#define PRESORTEDNESS_LEAF_NELEMS 16
+
+/**
+ * @ingroup Presortedness
+ * @struct Presortedness
+ * @brief Struct to represent how close an array is to being sorted.
+ */
+typedef struct Presortedness {
+  size_t nelems; ///< Number of elements measured.
+  size_t asc_runs; ///< Non-descending runs (as found by Timsort).
+  size_t desc_runs; ///< Strictly descending runs (as found by Timsort).
+  size_t longest_run; ///< Length of longest run of either kind.
+  size_t duplicates; ///< Elements equal to another, earlier element.
+  uint64_t inversions; ///< Pairs i < j with arr[i] > arr[j].
+  size_t max_displacement; ///< Largest distance of an element from its
+                           ///< position after a stable sort.
+} Presortedness;
+
+//##############################################################################
+//# PRESORTEDNESS
+//##############################################################################
+
+Presortedness measure_presortedness(const void* arr, size_t nelems,
+                                    size_t size,
+                                    int (*compare)(const void*, const void*));
+Presortedness measure_presortedness_parallel(
+    const void* arr, size_t nelems, size_t size,
+    int (*compare)(const void*, const void*), size_t nthreads);
+
+#endif /* MY_PRESORTED_ */
@@ -0,0 +1,324 @@
+/**
+ * @file
+ * @brief Parallel sample sort implementation.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sample_sort.h"
+#include "parallel.h"
+#include "sorting.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup SampleSort
+ * @struct SampleSort
+ * @brief Struct to represent a sample sort shared by parallel tasks.
+ */
+typedef struct SampleSort {
+  char* arr; ///< Array being sorted.
+  char* aux; ///< Buckets, scattered from arr.
+  size_t nelems; ///< Number of elements in array.
+  size_t size; ///< Size of each element in array.
+  int (*compare)(const void*, const void*); ///< Function to compare elements.
+  const char* tree; ///< Splitters in breadth-first order, from index 1.
+  const char* splitters; ///< Splitters in sorted order.
+  size_t levels; ///< Depth of splitter tree (log2 of nbuckets).
+  size_t nbuckets; ///< Number of leaves of the splitter tree (a power of 2).
+  int equal_buckets; ///< Whether elements equal to a splitter get a bucket.
+  size_t nclasses; ///< Number of buckets (nbuckets, or 2 * nbuckets).
+  size_t nstripes; ///< Number of stripes classified independently.
+  uint16_t* oracle; ///< Bucket of each element.
+  size_t* counts; ///< Elements per stripe and bucket, then scatter offsets.
+  size_t* bucket_starts; ///< First element of each bucket, then nelems.
+} SampleSort;
+
+static void sample_sort_splitters(SampleSort* ss, char* tree,
+                                  char* splitters);
+static void sample_sort_classify(size_t stripe, void* ctx);
+static void sample_sort_scatter(size_t stripe, void* ctx);
+static void sample_sort_bucket(size_t bucket, void* ctx);
+static size_t sample_sort_stripe_start(const SampleSort* ss, size_t stripe);
+
+/**
+ * @addtogroup SampleSort
+ * @{
+ */
+
+/**
+ * @brief Sort generic array by splitting it into buckets sorted in parallel.
+ *
+ * Splitters are chosen from a sorted random sample of SAMPLE_SORT_OVERSAMPLE
+ * elements per bucket, and stored as an implicit binary search tree. In
+ * parallel, stripes of the array are then classified by descending the tree,
+ * SAMPLE_SORT_UNROLL elements at a time. Each step adds the comparison result
+ * to the node index instead of branching on it (as in Super Scalar Sample
+ * Sort), so the descents of those elements overlap. Bucket counts per stripe
+ * give every stripe its own offsets within each bucket, and stripes scatter
+ * their elements into an auxillary array in parallel, without locks. Finally,
+ * buckets are sorted independently with quick_sort() and copied back, one
+ * bucket per task.
+ *
+ * If two adjacent splitters are equal, the input has heavy duplicates, so
+ * (as in IPS4o) each splitter also gets an equality bucket: after the descent,
+ * an element is compared once more with the splitter bounding its bucket,
+ * and moved to that splitter's equality bucket if equal. Equality buckets
+ * need no sorting, so an array of all equal keys takes linear time.
+ *
+ * There is no sequential partitioning step: every pass over the whole array
+ * is spread across threads. Arrays shorter than SAMPLE_SORT_MIN_NELEMS are
+ * sorted by quick_sort() on the calling thread.
+ *
+ * Uses nelems * (size + 2) bytes of auxillary space. Not stable. With
+ * SORT_STATS, counts from concurrent tasks may be lost.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param nthreads Maximum number of threads, including the calling thread. If
+ * 0, one per processor.
+ * @return Void.
+ */
+void
+sample_sort_parallel(void* arr, size_t nelems, size_t size,
+                     int (*compare)(const void*, const void*),
+                     size_t nthreads)
+{
+  if (nelems < SAMPLE_SORT_MIN_NELEMS) {
+    quick_sort(arr, nelems, size, compare);
+    return;
+  }
+  if (nthreads == 0) {
+    nthreads = parallel_ncpus();
+  }
+
+  // Enough buckets to balance threads, with samples at most 1/16 of input.
+  size_t levels = 1;
+  while ((size_t) 1 << levels < nthreads * SAMPLE_SORT_BUCKETS_PER_THREAD
+         && (size_t) 2 << levels <= SAMPLE_SORT_MAX_BUCKETS
+         && ((size_t) 2 << levels) * SAMPLE_SORT_OVERSAMPLE * 16 <= nelems) {
+    levels++;
+  }
+  const size_t nbuckets = (size_t) 1 << levels;
+  const size_t nstripes = nthreads * SAMPLE_SORT_STRIPES_PER_THREAD;
+
+  char* tree = malloc(nbuckets * size);
+  char* splitters = malloc(nbuckets * size);
+  SampleSort ss = {
+    (char*) arr, malloc(nelems * size), nelems, size, compare, tree,
+    splitters, levels, nbuckets, 0, nbuckets, nstripes,
+    malloc(nelems * sizeof(uint16_t)), NULL, NULL
+  };
+  sample_sort_splitters(&ss, tree, splitters);
+  const size_t nclasses = ss.nclasses;
+  ss.counts = calloc(nstripes * nclasses, sizeof(size_t));
+  ss.bucket_starts = malloc((nclasses + 1) * sizeof(size_t));
+  SORT_STATS_ADD(allocs, 6);
+  SORT_STATS_ADD(aux_bytes, 2 * nbuckets * size + nelems * size
+                            + nelems * sizeof(uint16_t)
+                            + nstripes * nclasses * sizeof(size_t)
+                            + (nclasses + 1) * sizeof(size_t));
+
+  parallel_for(nstripes, nthreads, sample_sort_classify, &ss);
+
+  // Bucket-major prefix sums: stripe s writes bucket b after stripes < s.
+  size_t pos = 0;
+  for (size_t b = 0; b < nclasses; b++) {
+    ss.bucket_starts[b] = pos;
+    for (size_t s = 0; s < nstripes; s++) {
+      size_t count = ss.counts[s * nclasses + b];
+      ss.counts[s * nclasses + b] = pos;
+      pos += count;
+    }
+  }
+  ss.bucket_starts[nclasses] = nelems;
+
+  parallel_for(nstripes, nthreads, sample_sort_scatter, &ss);
+  parallel_for(nclasses, nthreads, sample_sort_bucket, &ss);
+
+  free(tree);
+  free(splitters);
+  free(ss.aux);
+  free(ss.oracle);
+  free(ss.counts);
+  free(ss.bucket_starts);
+}
+
+/**
+ * @brief Choose splitters from a sorted random sample.
+ *
+ * Node j of the tree (1 <= j < nbuckets) at depth d holds the splitter which
+ * an in-order walk would visit at that position, so that descending from
+ * node 1 to 2j (element not greater) or 2j + 1 (element greater) is a binary
+ * search of the sorted splitters. Enables equality buckets if any two
+ * adjacent splitters are equal.
+ *
+ * @param ss Sort being set up.
+ * @param tree Space for nbuckets splitters (index 0 unused).
+ * @param splitters Space for nbuckets - 1 splitters, in sorted order.
+ * @return Void.
+ */
+void
+sample_sort_splitters(SampleSort* ss, char* tree, char* splitters)
+{
+  const size_t size = ss->size;
+  const size_t nsamples = ss->nbuckets * SAMPLE_SORT_OVERSAMPLE;
+  char* samples = malloc(nsamples * size);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, nsamples * size);
+  uint64_t rng = 0x9E3779B97F4A7C15ULL ^ ss->nelems;
+  for (size_t i = 0; i < nsamples; i++) {
+    // xorshift64*
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    size_t index = (size_t)((rng * 0x2545F4914F6CDD1DULL) % ss->nelems);
+    memcpy(samples+(i * size), ss->arr+(index * size), size);
+  }
+  quick_sort(samples, nsamples, size, ss->compare);
+
+  for (size_t k = 0; k + 1 < ss->nbuckets; k++) {
+    memcpy(splitters+(k * size),
+           samples+(((k + 1) * SAMPLE_SORT_OVERSAMPLE - 1) * size), size);
+    if (k > 0 && ss->compare(splitters+((k - 1) * size),
+                             splitters+(k * size)) == 0) {
+      ss->equal_buckets = 1;
+    }
+  }
+  ss->nclasses = ss->equal_buckets ? 2 * ss->nbuckets : ss->nbuckets;
+
+  for (size_t j = 1; j < ss->nbuckets; j++) {
+    size_t depth = 0;
+    while ((size_t) 2 << depth <= j) {
+      depth++;
+    }
+    size_t in_order = ((2 * (j - ((size_t) 1 << depth)) + 1)
+                       << (ss->levels - depth - 1)) - 1;
+    memcpy(tree+(j * size), splitters+(in_order * size), size);
+  }
+  free(samples);
+}
+
+/**
+ * @brief Count elements of one stripe per bucket, remembering each one's
+ * bucket.
+ *
+ * With equality buckets, leaf b of the splitter tree splits into bucket 2b,
+ * for elements less than splitter b, and bucket 2b + 1, for elements equal
+ * to it. The last leaf has no splitter above it, so bucket 2b + 1 stays
+ * empty.
+ *
+ * @param stripe Stripe to classify.
+ * @param ctx Sort in progress (SampleSort).
+ * @return Void.
+ */
+void
+sample_sort_classify(size_t stripe, void* ctx)
+{
+  SampleSort* ss = (SampleSort*) ctx;
+  const size_t size = ss->size;
+  const char* tree = ss->tree;
+  const size_t nbuckets = ss->nbuckets;
+  size_t* counts = ss->counts + stripe * ss->nclasses;
+  const size_t hi = sample_sort_stripe_start(ss, stripe + 1);
+  size_t i = sample_sort_stripe_start(ss, stripe);
+
+  for (; i + SAMPLE_SORT_UNROLL <= hi; i += SAMPLE_SORT_UNROLL) {
+    size_t j[SAMPLE_SORT_UNROLL];
+    for (int u = 0; u < SAMPLE_SORT_UNROLL; u++) {
+      j[u] = 1;
+    }
+    for (size_t l = 0; l < ss->levels; l++) {
+      for (int u = 0; u < SAMPLE_SORT_UNROLL; u++) {
+        j[u] = 2 * j[u] + (ss->compare(tree+(j[u] * size),
+                                       ss->arr+((i + u) * size)) < 0);
+      }
+    }
+    for (int u = 0; u < SAMPLE_SORT_UNROLL; u++) {
+      size_t b = j[u] - nbuckets;
+      if (ss->equal_buckets) {
+        b = 2 * b + (b + 1 < nbuckets
+                     && ss->compare(ss->splitters+(b * size),
+                                    ss->arr+((i + u) * size)) == 0);
+      }
+      ss->oracle[i + u] = (uint16_t) b;
+      counts[b]++;
+    }
+  }
+  for (; i < hi; i++) {
+    size_t j = 1;
+    for (size_t l = 0; l < ss->levels; l++) {
+      j = 2 * j + (ss->compare(tree+(j * size), ss->arr+(i * size)) < 0);
+    }
+    size_t b = j - nbuckets;
+    if (ss->equal_buckets) {
+      b = 2 * b + (b + 1 < nbuckets
+                   && ss->compare(ss->splitters+(b * size),
+                                  ss->arr+(i * size)) == 0);
+    }
+    ss->oracle[i] = (uint16_t) b;
+    counts[b]++;
+  }
+}
+
+/**
+ * @brief Copy elements of one stripe to their buckets.
+ *
+ * @param stripe Stripe to scatter.
+ * @param ctx Sort in progress (SampleSort).
+ * @return Void.
+ */
+void
+sample_sort_scatter(size_t stripe, void* ctx)
+{
+  SampleSort* ss = (SampleSort*) ctx;
+  const size_t size = ss->size;
+  size_t* offsets = ss->counts + stripe * ss->nclasses;
+  const size_t hi = sample_sort_stripe_start(ss, stripe + 1);
+  for (size_t i = sample_sort_stripe_start(ss, stripe); i < hi; i++) {
+    memcpy(ss->aux+(offsets[ss->oracle[i]]++ * size), ss->arr+(i * size),
+           size);
+  }
+  SORT_STATS_ADD(bytes_moved, (hi - sample_sort_stripe_start(ss, stripe))
+                              * size);
+}
+
+/**
+ * @brief Sort one bucket and copy it back to the array. Equality buckets are
+ * only copied.
+ *
+ * @param bucket Bucket to sort.
+ * @param ctx Sort in progress (SampleSort).
+ * @return Void.
+ */
+void
+sample_sort_bucket(size_t bucket, void* ctx)
+{
+  SampleSort* ss = (SampleSort*) ctx;
+  const size_t lo = ss->bucket_starts[bucket] * ss->size;
+  const size_t nelems = ss->bucket_starts[bucket + 1]
+                        - ss->bucket_starts[bucket];
+  if (nelems > 1 && !(ss->equal_buckets && bucket % 2 == 1)) {
+    quick_sort(ss->aux+(lo), nelems, ss->size, ss->compare);
+  }
+  memcpy(ss->arr+(lo), ss->aux+(lo), nelems * ss->size);
+  SORT_STATS_ADD(bytes_moved, nelems * ss->size);
+}
+
+/**
+ * @brief Get first element of stripe.
+ *
+ * @param ss Sort in progress.
+ * @param stripe Stripe index (nstripes for the end of the array).
+ * @return Index of first element of stripe.
+ */
+size_t
+sample_sort_stripe_start(const SampleSort* ss, size_t stripe)
+{
+  return (size_t)((uint64_t) ss->nelems * stripe / ss->nstripes);
+}
+
+/** @} */
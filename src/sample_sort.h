@@ -0,0 +1,48 @@
+/**
+ * @file
+ * @brief Parallel sample sort header file.
+ */
+#ifndef MY_SAMPLE_SORT_
+#define MY_SAMPLE_SORT_
+
+#include <stdlib.h>
+
+/**
+ * @def SAMPLE_SORT_MIN_NELEMS
+ * @brief Minimum array length split into buckets by sample_sort_parallel().
+ * Shorter arrays are sorted by quick_sort() on the calling thread. */
+#define SAMPLE_SORT_MIN_NELEMS (1 << 16)
+/**
+ * @def SAMPLE_SORT_BUCKETS_PER_THREAD
+ * @brief Buckets per thread (rounded up to a power of 2), so that threads
+ * which finish early pick up further buckets. */
+#define SAMPLE_SORT_BUCKETS_PER_THREAD 16
+/**
+ * @def SAMPLE_SORT_MAX_BUCKETS
+ * @brief Maximum number of buckets (a power of 2), which keeps the splitter
+ * tree in cache. */
+#define SAMPLE_SORT_MAX_BUCKETS 4096
+/**
+ * @def SAMPLE_SORT_OVERSAMPLE
+ * @brief Samples taken per bucket. Splitters are every
+ * SAMPLE_SORT_OVERSAMPLE-th sorted sample. */
+#define SAMPLE_SORT_OVERSAMPLE 32
+/**
+ * @def SAMPLE_SORT_STRIPES_PER_THREAD
+ * @brief Stripes of the array classified and scattered per thread. */
+#define SAMPLE_SORT_STRIPES_PER_THREAD 4
+/**
+ * @def SAMPLE_SORT_UNROLL
+ * @brief Elements descending the splitter tree together during
+ * classification. */
+#define SAMPLE_SORT_UNROLL 4
+
+//##############################################################################
+//# SAMPLE SORT
+//##############################################################################
+
+void sample_sort_parallel(void* arr, size_t nelems, size_t size,
+                          int (*compare)(const void*, const void*),
+                          size_t nthreads);
+
+#endif /* MY_SAMPLE_SORT_ */
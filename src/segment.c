@@ -0,0 +1,391 @@
+/**
+ * @file
+ * @brief Sorted segment file implementation.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "segment.h"
+#include "sorting.h"
+#include "doxygen.h"
+
+static const char SEGMENT_MAGIC[8] = { 'S', 'O', 'R', 'T', 'S', 'E', 'G', '1' };
+
+static size_t segment_page_nkeys(size_t size);
+static int segment_pad(FILE* file, size_t from, size_t to);
+static size_t segment_partition(const char* base, size_t nelems, size_t size,
+                                int (*compare)(const void*, const void*),
+                                const void* target, int bound);
+static size_t segment_bound(Segment* seg,
+                            int (*compare)(const void*, const void*),
+                            const void* target, int bound);
+
+/**
+ * @addtogroup Segment
+ * @{
+ */
+
+/**
+ * @brief Write sorted array to segment file.
+ *
+ * A segment file is laid out as follows:
+ * -# One page containing the SegmentHeader.
+ * -# A page-aligned sparse index holding a copy of the first element of every
+ *    data block.
+ * -# A page-aligned data region holding the elements themselves, grouped into
+ *    blocks of block_nelems elements.
+ *
+ * The array must already be sorted according to the comparison function that
+ * will later be used to query the segment.
+ *
+ * @param path Path of file to create (or truncate).
+ * @param arr Sorted array to write.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param block_nelems Number of elements per data block. If 0, blocks are sized
+ * to fit in a single page.
+ * @return Returns 0 if unable to write file else 1.
+ *
+ * @see segment_sort_write()
+ * @see segment_open()
+ */
+int
+segment_write(const char* path, const void* arr, size_t nelems, size_t size,
+              size_t block_nelems)
+{
+  if (size == 0) {
+    return 0;
+  }
+  if (block_nelems == 0) {
+    block_nelems = SEGMENT_PAGE_SIZE / size > 0 ? SEGMENT_PAGE_SIZE / size : 1;
+  }
+  const char* arr_p = (const char*) arr;
+  const size_t block_size = block_nelems * size;
+  const size_t nblocks = (nelems + block_nelems - 1) / block_nelems;
+  const size_t index_size = nblocks * size;
+
+  SegmentHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SEGMENT_MAGIC, sizeof(header.magic));
+  header.nelems = nelems;
+  header.size = size;
+  header.block_nelems = block_nelems;
+  header.nblocks = nblocks;
+  header.index_offset = SEGMENT_PAGE_SIZE;
+  header.data_offset = header.index_offset
+                       + ((index_size + SEGMENT_PAGE_SIZE - 1)
+                          / SEGMENT_PAGE_SIZE) * SEGMENT_PAGE_SIZE;
+
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    return 0;
+  }
+  int ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && segment_pad(file, sizeof(header), header.index_offset);
+  for (size_t b = 0; ok && b < nblocks; b++) {
+    ok = fwrite(arr_p+(b * block_size), size, 1, file) == 1;
+  }
+  ok = ok && segment_pad(file, header.index_offset + index_size,
+                         header.data_offset);
+  if (ok && nelems > 0) {
+    ok = fwrite(arr_p, size, nelems, file) == nelems;
+  }
+  if (fclose(file) != 0) {
+    ok = 0;
+  }
+  return ok;
+}
+
+/**
+ * @brief Sort array using Timsort and write result to segment file.
+ *
+ * @param path Path of file to create (or truncate).
+ * @param arr Array to be sorted and written.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @param block_nelems Number of elements per data block (0 for default).
+ * @return Returns 0 if unable to write file else 1.
+ *
+ * @see segment_write()
+ */
+int
+segment_sort_write(const char* path, void* arr, size_t nelems, size_t size,
+                   int (*compare)(const void*, const void*),
+                   size_t block_nelems)
+{
+  timsort(arr, nelems, size, compare);
+  return segment_write(path, arr, nelems, size, block_nelems);
+}
+
+/**
+ * @brief Open segment file for reading.
+ *
+ * The whole file is mapped read-only. In addition, the first index key of every
+ * index page (the fences) is copied to the heap, so that a lookup only has to
+ * touch a single index page and a single data block of the mapping.
+ *
+ * @param path Path of segment file.
+ * @return New segment, or NULL if file could not be opened or is malformed.
+ *
+ * @see segment_close()
+ */
+Segment*
+segment_open(const char* path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(SegmentHeader)) {
+    close(fd);
+    return NULL;
+  }
+  char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  Segment* seg = malloc(sizeof(Segment));
+  seg->map = map;
+  seg->map_len = st.st_size;
+  seg->fences = NULL;
+  memcpy(&seg->header, map, sizeof(SegmentHeader));
+
+  // Bounds are checked by division, so that crafted sizes can't overflow.
+  const SegmentHeader* h = &seg->header;
+  if (memcmp(h->magic, SEGMENT_MAGIC, sizeof(h->magic)) != 0
+      || h->size == 0 || h->block_nelems == 0
+      || h->nblocks != h->nelems / h->block_nelems
+                       + (h->nelems % h->block_nelems != 0)
+      || h->data_offset > seg->map_len
+      || h->nelems > (seg->map_len - h->data_offset) / h->size
+      || h->index_offset > h->data_offset
+      || h->nblocks > (h->data_offset - h->index_offset) / h->size) {
+    segment_close(&seg);
+    return NULL;
+  }
+
+  seg->index = map + h->index_offset;
+  seg->data = map + h->data_offset;
+  seg->page_nkeys = segment_page_nkeys(h->size);
+  seg->nfences = (h->nblocks + seg->page_nkeys - 1) / seg->page_nkeys;
+  seg->fences = malloc(seg->nfences * h->size + 1);
+  for (size_t p = 0; p < seg->nfences; p++) {
+    memcpy(seg->fences+(p * h->size),
+           seg->index+(p * seg->page_nkeys * h->size), h->size);
+  }
+  return seg;
+}
+
+/**
+ * @brief Find index of first element in segment not less than target.
+ *
+ * @param seg Segment to search.
+ * @param compare Function used to sort the segment.
+ * @param target Element to search for.
+ * @return Index of first element >= target, or total number of elements if
+ * no such element exists.
+ *
+ * @see segment_upper_bound()
+ */
+size_t
+segment_lower_bound(Segment* seg, int (*compare)(const void*, const void*),
+                    const void* target)
+{
+  return segment_bound(seg, compare, target, 0);
+}
+
+/**
+ * @brief Find index of first element in segment greater than target.
+ *
+ * @param seg Segment to search.
+ * @param compare Function used to sort the segment.
+ * @param target Element to search for.
+ * @return Index of first element > target, or total number of elements if
+ * no such element exists.
+ *
+ * @see segment_lower_bound()
+ */
+size_t
+segment_upper_bound(Segment* seg, int (*compare)(const void*, const void*),
+                    const void* target)
+{
+  return segment_bound(seg, compare, target, 1);
+}
+
+/**
+ * @brief Find elements in segment within closed interval [lo, hi].
+ *
+ * Matching elements are contiguous and can be scanned using segment_get()
+ * from index *first onwards.
+ *
+ * @param seg Segment to search.
+ * @param compare Function used to sort the segment.
+ * @param lo Lower bound of interval (inclusive).
+ * @param hi Upper bound of interval (inclusive).
+ * @param first Set to index of first matching element.
+ * @return Number of matching elements.
+ */
+size_t
+segment_range(Segment* seg, int (*compare)(const void*, const void*),
+              const void* lo, const void* hi, size_t* first)
+{
+  size_t begin = segment_lower_bound(seg, compare, lo);
+  size_t end = segment_upper_bound(seg, compare, hi);
+  *first = begin;
+  return end > begin ? end - begin : 0;
+}
+
+/**
+ * @brief Get pointer to element of segment.
+ *
+ * @param seg Segment containing element.
+ * @param i Index of element.
+ * @return Pointer to element (read-only), or NULL if index is out of bounds.
+ */
+void*
+segment_get(Segment* seg, size_t i)
+{
+  if (i >= seg->header.nelems) {
+    return NULL;
+  }
+  return seg->data+(i * seg->header.size);
+}
+
+/**
+ * @brief Unmap and free segment.
+ *
+ * @param seg Segment to close.
+ * @return Void.
+ */
+void
+segment_close(Segment** seg)
+{
+  munmap((*seg)->map, (*seg)->map_len);
+  free((*seg)->fences);
+  free(*seg);
+  *seg = NULL;
+}
+
+/**
+ * @brief Find number of index keys stored per index page.
+ *
+ * @param size Size of each element.
+ * @return Number of keys per index page (at least 1).
+ */
+size_t
+segment_page_nkeys(size_t size)
+{
+  return SEGMENT_PAGE_SIZE / size > 0 ? SEGMENT_PAGE_SIZE / size : 1;
+}
+
+/**
+ * @brief Write zero bytes to file until offset is reached.
+ *
+ * @param file File to write to.
+ * @param from Current offset in file.
+ * @param to Target offset in file.
+ * @return Returns 0 if unable to write padding else 1.
+ */
+int
+segment_pad(FILE* file, size_t from, size_t to)
+{
+  static const char zeros[SEGMENT_PAGE_SIZE];
+  while (from < to) {
+    size_t chunk = to - from < sizeof(zeros) ? to - from : sizeof(zeros);
+    if (fwrite(zeros, 1, chunk, file) != chunk) {
+      return 0;
+    }
+    from += chunk;
+  }
+  return 1;
+}
+
+/**
+ * @brief Count leading elements of sorted array which precede target.
+ *
+ * @param base Sorted array.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @param target Element to search for.
+ * @param bound If 0, count elements < target; if 1, elements <= target.
+ * @return Number of leading elements which precede target.
+ */
+size_t
+segment_partition(const char* base, size_t nelems, size_t size,
+                  int (*compare)(const void*, const void*),
+                  const void* target, int bound)
+{
+  size_t l = 0;
+  size_t r = nelems;
+  while (l < r) {
+    size_t m = l + (r - l) / 2;
+    if (compare(base+(m * size), target) < bound) {
+      l = m + 1;
+    } else {
+      r = m;
+    }
+  }
+  return l;
+}
+
+/**
+ * @brief Find lower or upper bound of target in segment.
+ *
+ * The search proceeds in three steps, each of which narrows the next:
+ * -# Binary search the in-memory fences to select one index page.
+ * -# Binary search that index page to select one data block.
+ * -# Binary search that data block.
+ *
+ * @param seg Segment to search.
+ * @param compare Function used to sort the segment.
+ * @param target Element to search for.
+ * @param bound If 0, find lower bound; if 1, find upper bound.
+ * @return Index of bound in segment.
+ */
+size_t
+segment_bound(Segment* seg, int (*compare)(const void*, const void*),
+              const void* target, int bound)
+{
+  const size_t size = seg->header.size;
+  const size_t block_nelems = seg->header.block_nelems;
+
+  size_t page = segment_partition(seg->fences, seg->nfences, size,
+                                  compare, target, bound);
+  if (page == 0) {
+    return 0;
+  }
+  page--;
+
+  size_t first_block = page * seg->page_nkeys;
+  size_t page_blocks = seg->header.nblocks - first_block;
+  if (page_blocks > seg->page_nkeys) {
+    page_blocks = seg->page_nkeys;
+  }
+  size_t block = first_block
+                 + segment_partition(seg->index+(first_block * size),
+                                     page_blocks, size, compare, target, bound)
+                 - 1;
+
+  size_t first_elem = block * block_nelems;
+  size_t block_len = seg->header.nelems - first_elem;
+  if (block_len > block_nelems) {
+    block_len = block_nelems;
+  }
+  return first_elem + segment_partition(seg->data+(first_elem * size),
+                                        block_len, size, compare, target,
+                                        bound);
+}
+
+/** @} */
@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @brief Sorted segment file header file.
+ */
+#ifndef MY_SEGMENT_
+#define MY_SEGMENT_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def SEGMENT_PAGE_SIZE
+ * @brief Alignment of the index and data regions of a segment file. */
+#define SEGMENT_PAGE_SIZE 4096
+
+/**
+ * @ingroup Segment
+ * @struct SegmentHeader
+ * @brief Struct to represent the on-disk header of a segment file.
+ */
+typedef struct SegmentHeader {
+  char magic[8]; ///< File signature ("SORTSEG1").
+  uint64_t nelems; ///< Total number of elements in segment.
+  uint64_t size; ///< Size of each element in segment.
+  uint64_t block_nelems; ///< Number of elements in each data block.
+  uint64_t nblocks; ///< Total number of data blocks.
+  uint64_t index_offset; ///< File offset of sparse index.
+  uint64_t data_offset; ///< File offset of first data block.
+} SegmentHeader;
+
+/**
+ * @ingroup Segment
+ * @struct Segment
+ * @brief Struct to represent an open, memory-mapped segment file.
+ */
+typedef struct Segment {
+  char* map; ///< Memory mapping of entire file.
+  size_t map_len; ///< Length of memory mapping.
+  SegmentHeader header; ///< Copy of on-disk header.
+  char* index; ///< First element of each data block (inside mapping).
+  char* data; ///< Start of data blocks (inside mapping).
+  char* fences; ///< First element of each index page (heap copy).
+  size_t nfences; ///< Total number of index pages.
+  size_t page_nkeys; ///< Number of index keys per index page.
+} Segment;
+
+//##############################################################################
+//# WRITER
+//##############################################################################
+
+int segment_write(const char* path, const void* arr, size_t nelems,
+                  size_t size, size_t block_nelems);
+int segment_sort_write(const char* path, void* arr, size_t nelems, size_t size,
+                       int (*compare)(const void*, const void*),
+                       size_t block_nelems);
+
+//##############################################################################
+//# READER
+//##############################################################################
+
+Segment* segment_open(const char* path);
+size_t segment_lower_bound(Segment* seg,
+                           int (*compare)(const void*, const void*),
+                           const void* target);
+size_t segment_upper_bound(Segment* seg,
+                           int (*compare)(const void*, const void*),
+                           const void* target);
+size_t segment_range(Segment* seg, int (*compare)(const void*, const void*),
+                     const void* lo, const void* hi, size_t* first);
+void* segment_get(Segment* seg, size_t i);
+void segment_close(Segment** seg);
+
+#endif /* MY_SEGMENT_ */
@@ -0,0 +1,291 @@
+/**
+ * @file
+ * @brief Segmented sort implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "segmented.h"
+#include "parallel.h"
+#include "sorting.h"
+#include "sort_auto.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup SegmentedSort
+ * @struct SegmentedTask
+ * @brief Struct to represent segments sorted by one parallel task.
+ */
+typedef struct SegmentedTask {
+  size_t nelems; ///< Elements in task's segments (plus one per segment).
+  size_t first; ///< First segment of task.
+  size_t last; ///< Segment after last segment of task.
+  int batch; ///< Whether task only sorts the short segments in its range.
+} SegmentedTask;
+
+/**
+ * @ingroup SegmentedSort
+ * @struct SegmentedSort
+ * @brief Struct to represent a segmented sort shared by parallel tasks.
+ */
+typedef struct SegmentedSort {
+  char* arr; ///< Array containing segments.
+  size_t size; ///< Size of each element in array.
+  int (*compare)(const void*, const void*); ///< Function to compare elements.
+  const size_t* offsets; ///< Start of each segment, followed by the end.
+  const SegmentedTask* tasks; ///< Tasks, longest first.
+} SegmentedSort;
+
+static void segmented_sort_segment(char* arr, size_t size,
+                                   int (*compare)(const void*, const void*),
+                                   size_t nelems);
+static void segmented_sort_network(char* arr, size_t size,
+                                   int (*compare)(const void*, const void*),
+                                   size_t nelems);
+static void segmented_sort_cswap(char* a, char* b, size_t size,
+                                 int (*compare)(const void*, const void*));
+static void segmented_sort_task(size_t task, void* ctx);
+static int segmented_task_compare(const void* a, const void* b);
+
+/**
+ * @addtogroup SegmentedSort
+ * @{
+ */
+
+/**
+ * @brief Sort each of many back-to-back segments of an array.
+ *
+ * Segment i holds the elements [offsets[i], offsets[i + 1]). Segments are
+ * sorted independently, by length: sorting networks for up to
+ * SEGMENTED_NETWORK_NELEMS elements, insertion sort for up to
+ * SEGMENTED_SMALL_NELEMS, and sort_auto() beyond that. Nothing is allocated
+ * for short segments, which are typically the vast majority.
+ *
+ * Arrays of SEGMENTED_PARALLEL_NELEMS elements or more are sorted using one
+ * thread per processor (see segmented_sort_parallel()).
+ *
+ * @param arr Array containing segments.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param offsets nsegments + 1 non-decreasing element indices.
+ * @param nsegments Number of segments.
+ * @return Void.
+ */
+void
+segmented_sort(void* arr, size_t size,
+               int (*compare)(const void*, const void*),
+               const size_t* offsets, size_t nsegments)
+{
+  size_t nelems = nsegments > 0 ? offsets[nsegments] - offsets[0] : 0;
+  segmented_sort_parallel(arr, size, compare, offsets, nsegments,
+                          nelems >= SEGMENTED_PARALLEL_NELEMS ? 0 : 1);
+}
+
+/**
+ * @brief Sort each of many back-to-back segments of an array, spread across
+ * threads.
+ *
+ * Each segment longer than SEGMENTED_SMALL_NELEMS is a task of its own, and
+ * consecutive shorter segments are batched into tasks of about
+ * SEGMENTED_BATCH_NELEMS elements. Tasks are handed out longest first, which
+ * approximates longest-processing-time-first scheduling: a few huge
+ * segments start straight away instead of being left to finish last on a
+ * single thread.
+ *
+ * On one thread, segments are simply sorted in order.
+ *
+ * @param arr Array containing segments.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param offsets nsegments + 1 non-decreasing element indices.
+ * @param nsegments Number of segments.
+ * @param nthreads Maximum number of threads, including the calling thread. If
+ * 0, one per processor.
+ * @return Void.
+ */
+void
+segmented_sort_parallel(void* arr, size_t size,
+                        int (*compare)(const void*, const void*),
+                        const size_t* offsets, size_t nsegments,
+                        size_t nthreads)
+{
+  SORT_STATS_WRAP(compare);
+  char* arr_p = (char*) arr;
+  if (nthreads == 0) {
+    nthreads = parallel_ncpus();
+  }
+  if (nthreads <= 1) {
+    for (size_t s = 0; s < nsegments; s++) {
+      segmented_sort_segment(arr_p+(offsets[s] * size), size, compare,
+                             offsets[s + 1] - offsets[s]);
+    }
+    return;
+  }
+
+  // Every task holds at least one segment, so nsegments tasks suffice.
+  SegmentedTask* tasks = malloc(nsegments * sizeof(SegmentedTask) + 1);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, nsegments * sizeof(SegmentedTask));
+  size_t ntasks = 0;
+  SegmentedTask batch = { 0, 0, 0, 1 };
+  for (size_t s = 0; s < nsegments; s++) {
+    const size_t nelems = offsets[s + 1] - offsets[s];
+    if (nelems > SEGMENTED_SMALL_NELEMS) {
+      tasks[ntasks++] = (SegmentedTask){ nelems, s, s + 1, 0 };
+      continue;
+    }
+    // Count segments too, so that batches of empty segments stay bounded.
+    if (batch.nelems == 0) {
+      batch.first = s;
+    }
+    batch.nelems += nelems + 1;
+    batch.last = s + 1;
+    if (batch.nelems >= SEGMENTED_BATCH_NELEMS) {
+      tasks[ntasks++] = batch;
+      batch.nelems = 0;
+    }
+  }
+  if (batch.nelems > 0) {
+    tasks[ntasks++] = batch;
+  }
+  quick_sort(tasks, ntasks, sizeof(SegmentedTask), segmented_task_compare);
+
+  SegmentedSort ss = { arr_p, size, compare, offsets, tasks };
+  parallel_for(ntasks, nthreads, segmented_sort_task, &ss);
+  free(tasks);
+}
+
+/**
+ * @brief Sort one segment with the engine for its length.
+ *
+ * @param arr First element of segment.
+ * @param size Size of each element.
+ * @param compare Function to be used to compare elements.
+ * @param nelems Number of elements in segment.
+ * @return Void.
+ */
+void
+segmented_sort_segment(char* arr, size_t size,
+                       int (*compare)(const void*, const void*),
+                       size_t nelems)
+{
+  if (nelems < 2) {
+    return;
+  } else if (nelems <= SEGMENTED_NETWORK_NELEMS) {
+    segmented_sort_network(arr, size, compare, nelems);
+  } else if (nelems <= SEGMENTED_SMALL_NELEMS) {
+    insert_sort(arr, nelems, size, compare);
+  } else {
+    sort_auto(arr, nelems, size, compare);
+  }
+}
+
+/**
+ * @brief Sort 2 to 4 elements with an optimal sorting network.
+ *
+ * Networks perform a fixed sequence of compare-and-swaps, with no loop
+ * bookkeeping: 1 for 2 elements, 3 for 3 and 5 for 4.
+ *
+ * @param arr First element.
+ * @param size Size of each element.
+ * @param compare Function to be used to compare elements.
+ * @param nelems Number of elements (2 to SEGMENTED_NETWORK_NELEMS).
+ * @return Void.
+ */
+void
+segmented_sort_network(char* arr, size_t size,
+                       int (*compare)(const void*, const void*),
+                       size_t nelems)
+{
+  char* e0 = arr;
+  char* e1 = arr+(size);
+  char* e2 = arr+(2 * size);
+  char* e3 = arr+(3 * size);
+  switch (nelems) {
+    case 2:
+      segmented_sort_cswap(e0, e1, size, compare);
+      break;
+    case 3:
+      segmented_sort_cswap(e1, e2, size, compare);
+      segmented_sort_cswap(e0, e2, size, compare);
+      segmented_sort_cswap(e0, e1, size, compare);
+      break;
+    default:
+      segmented_sort_cswap(e0, e1, size, compare);
+      segmented_sort_cswap(e2, e3, size, compare);
+      segmented_sort_cswap(e0, e2, size, compare);
+      segmented_sort_cswap(e1, e3, size, compare);
+      segmented_sort_cswap(e1, e2, size, compare);
+      break;
+  }
+}
+
+/**
+ * @brief Swap two elements if they are out of order.
+ *
+ * Elements of any size are swapped through a small buffer on the stack.
+ *
+ * @param a Element which should be first.
+ * @param b Element which should be second.
+ * @param size Size of each element.
+ * @param compare Function to be used to compare elements.
+ * @return Void.
+ */
+void
+segmented_sort_cswap(char* a, char* b, size_t size,
+                     int (*compare)(const void*, const void*))
+{
+  enum { CSWAP_CHUNK = 64 };
+  if (compare(b, a) >= 0) {
+    return;
+  }
+  char tmp[CSWAP_CHUNK];
+  for (size_t i = 0; i < size; i += CSWAP_CHUNK) {
+    size_t n = (size - i < CSWAP_CHUNK) ? size - i : CSWAP_CHUNK;
+    memcpy(tmp, a+(i), n);
+    memcpy(a+(i), b+(i), n);
+    memcpy(b+(i), tmp, n);
+  }
+  SORT_STATS_ADD(swaps, 1);
+  SORT_STATS_ADD(bytes_moved, 3 * size);
+}
+
+/**
+ * @brief Sort the segments of one task.
+ *
+ * @param task Task to run.
+ * @param ctx Sort in progress (SegmentedSort).
+ * @return Void.
+ */
+void
+segmented_sort_task(size_t task, void* ctx)
+{
+  const SegmentedSort* ss = (const SegmentedSort*) ctx;
+  const SegmentedTask* t = &ss->tasks[task];
+  for (size_t s = t->first; s < t->last; s++) {
+    const size_t nelems = ss->offsets[s + 1] - ss->offsets[s];
+    if (t->batch && nelems > SEGMENTED_SMALL_NELEMS) {
+      continue; // Task of its own.
+    }
+    segmented_sort_segment(ss->arr+(ss->offsets[s] * ss->size), ss->size,
+                           ss->compare, nelems);
+  }
+}
+
+/**
+ * @brief Compare tasks so that longer tasks come first.
+ *
+ * @param a First task.
+ * @param b Second task.
+ * @return Negative if a is longer than b, positive if shorter, else 0.
+ */
+int
+segmented_task_compare(const void* a, const void* b)
+{
+  size_t alen = ((const SegmentedTask*) a)->nelems;
+  size_t blen = ((const SegmentedTask*) b)->nelems;
+  return (alen > blen) ? -1 : (alen < blen);
+}
+
+/** @} */
@@ -0,0 +1,40 @@
+/**
+ * @file
+ * @brief Segmented sort header file.
+ */
+#ifndef MY_SEGMENTED_SORT_
+#define MY_SEGMENTED_SORT_
+
+#include <stdlib.h>
+
+/**
+ * @def SEGMENTED_NETWORK_NELEMS
+ * @brief Maximum segment length sorted by a sorting network. */
+#define SEGMENTED_NETWORK_NELEMS 4
+/**
+ * @def SEGMENTED_SMALL_NELEMS
+ * @brief Maximum segment length sorted by insertion sort. Longer segments are
+ * sorted by sort_auto() and scheduled on their own. */
+#define SEGMENTED_SMALL_NELEMS 32
+/**
+ * @def SEGMENTED_BATCH_NELEMS
+ * @brief Elements of small segments sorted together by one parallel task. */
+#define SEGMENTED_BATCH_NELEMS 4096
+/**
+ * @def SEGMENTED_PARALLEL_NELEMS
+ * @brief Minimum total length sorted in parallel by segmented_sort(). */
+#define SEGMENTED_PARALLEL_NELEMS (1 << 16)
+
+//##############################################################################
+//# SEGMENTED SORT
+//##############################################################################
+
+void segmented_sort(void* arr, size_t size,
+                    int (*compare)(const void*, const void*),
+                    const size_t* offsets, size_t nsegments);
+void segmented_sort_parallel(void* arr, size_t size,
+                             int (*compare)(const void*, const void*),
+                             const size_t* offsets, size_t nsegments,
+                             size_t nthreads);
+
+#endif /* MY_SEGMENTED_SORT_ */
@@ -0,0 +1,231 @@
+/**
+ * @file
+ * @brief Adaptive sort dispatcher implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_auto.h"
+#include "sorting.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+static const char* sort_auto_choice_names[SORT_AUTO_NCHOICES] = {
+  "binary_insert_sort", "timsort", "quick_sort_3way", "quick_sort",
+  "merge_sort_tiled"
+};
+
+static void sort_auto_sample_runs(const char* arr_p, size_t nelems,
+                                  size_t size,
+                                  int (*compare)(const void*, const void*),
+                                  SortAutoSample* sample);
+static void sort_auto_sample_distinct(const char* arr_p, size_t nelems,
+                                      size_t size,
+                                      int (*compare)(const void*, const void*),
+                                      SortAutoSample* sample);
+
+/**
+ * @addtogroup AutoSort
+ * @{
+ */
+
+/**
+ * @brief Sort generic array using the sort best suited to its contents.
+ *
+ * The input is sampled by sort_auto_choose() and handed to the chosen sort.
+ * With -DSORT_STATS, the choice is recorded in SortStats::auto_choice.
+ *
+ * @note Not stable: elements which compare equal may be reordered.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @return Void.
+ */
+void
+sort_auto(void* arr, size_t nelems, size_t size,
+          int (*compare)(const void*, const void*))
+{
+  SORT_STATS_WRAP(compare);
+  SortAutoChoice choice = sort_auto_choose(arr, nelems, size, compare, NULL);
+  SORT_STATS_ADD(auto_dispatches, 1);
+  SORT_STATS_SET(auto_choice, choice);
+  switch (choice) {
+    case SORT_AUTO_INSERT:
+      binary_insert_sort(arr, nelems, size, compare);
+      break;
+    case SORT_AUTO_TIMSORT:
+      timsort(arr, nelems, size, compare);
+      break;
+    case SORT_AUTO_QUICK_3WAY:
+      quick_sort_3way(arr, nelems, size, compare);
+      break;
+    case SORT_AUTO_MERGE:
+      merge_sort_tiled(arr, nelems, size, compare);
+      break;
+    default:
+      quick_sort(arr, nelems, size, compare);
+      break;
+  }
+}
+
+/**
+ * @brief Choose sort for array by sampling its contents.
+ *
+ * Sampling costs roughly 1,400 comparisons regardless of array length:
+ * -# Arrays shorter than SORT_AUTO_INSERT_NELEMS elements and at most
+ *    SORT_AUTO_INSERT_BYTES long use binary insertion sort, which beats the
+ *    O(n log n) sorts below there (the byte limit is reached first for
+ *    elements wider than 16 bytes, whose moves dominate).
+ * -# SORT_AUTO_WINDOWS evenly spaced windows are scanned for turns, where an
+ *    ascending run ends and a strictly descending one starts (or vice versa).
+ *    If the estimated mean run length is at least SORT_AUTO_MIN_RUN, Timsort
+ *    is chosen.
+ * -# Up to SORT_AUTO_DISTINCT_NELEMS evenly spaced elements (one in 16) are
+ *    sorted. If at most half of them are distinct, 3-way quicksort is chosen.
+ *    Short arrays, where such a sample would cost more than it saves, skip
+ *    this step.
+ * -# Otherwise, quicksort is chosen, unless elements are wider than
+ *    SORT_AUTO_MAX_SWAP_SIZE. Each quicksort swap then costs three copies
+ *    through a heap buffer, and merge_sort_tiled() (one copy per move) is
+ *    chosen.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param sample If not NULL, set to the sampled statistics.
+ * @return Chosen sort.
+ */
+SortAutoChoice
+sort_auto_choose(const void* arr, size_t nelems, size_t size,
+                 int (*compare)(const void*, const void*),
+                 SortAutoSample* sample)
+{
+  const char* arr_p = (const char*) arr;
+  SortAutoSample s;
+  memset(&s, 0, sizeof(s));
+  SortAutoChoice choice;
+
+  if (nelems < SORT_AUTO_INSERT_NELEMS
+      && nelems * size <= SORT_AUTO_INSERT_BYTES) {
+    choice = SORT_AUTO_INSERT;
+  } else {
+    sort_auto_sample_runs(arr_p, nelems, size, compare, &s);
+    if ((s.turns + 1) * SORT_AUTO_MIN_RUN <= s.pairs) {
+      choice = SORT_AUTO_TIMSORT;
+    } else {
+      sort_auto_sample_distinct(arr_p, nelems, size, compare, &s);
+      if (s.sampled > 0 && s.distinct * 2 <= s.sampled) {
+        choice = SORT_AUTO_QUICK_3WAY;
+      } else if (size > SORT_AUTO_MAX_SWAP_SIZE) {
+        choice = SORT_AUTO_MERGE;
+      } else {
+        choice = SORT_AUTO_QUICK;
+      }
+    }
+  }
+
+  if (sample != NULL) {
+    *sample = s;
+  }
+  return choice;
+}
+
+/**
+ * @brief Get name of sort chosen by sort_auto().
+ *
+ * @param choice Chosen sort.
+ * @return Name of sorting function, or "unknown".
+ */
+const char*
+sort_auto_choice_name(SortAutoChoice choice)
+{
+  if ((int)choice < 0 || choice >= SORT_AUTO_NCHOICES) {
+    return "unknown";
+  }
+  return sort_auto_choice_names[choice];
+}
+
+/**
+ * @brief Count ordered and descending adjacent pairs, and turns between them,
+ * in sampled windows.
+ *
+ * Arrays shorter than the total length of all windows are scanned whole.
+ *
+ * @param arr_p Array to sample.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param sample Sample to update.
+ * @return Void.
+ */
+void
+sort_auto_sample_runs(const char* arr_p, size_t nelems, size_t size,
+                      int (*compare)(const void*, const void*),
+                      SortAutoSample* sample)
+{
+  size_t nwindows = SORT_AUTO_WINDOWS;
+  size_t window = SORT_AUTO_WINDOW_NELEMS;
+  if (nelems <= nwindows * window) {
+    nwindows = 1;
+    window = nelems;
+  }
+  for (size_t w = 0; w < nwindows; w++) {
+    size_t start = nwindows > 1 ? w * (nelems - window) / (nwindows - 1) : 0;
+    int prev_desc = -1;
+    for (size_t i = start + 1; i < start + window; i++) {
+      int desc = compare(arr_p+((i - 1) * size), arr_p+(i * size)) > 0;
+      if (desc) {
+        sample->desc_pairs++;
+      } else {
+        sample->asc_pairs++;
+      }
+      sample->turns += prev_desc >= 0 && desc != prev_desc;
+      sample->pairs++;
+      prev_desc = desc;
+    }
+  }
+}
+
+/**
+ * @brief Count distinct values among evenly spaced elements.
+ *
+ * Arrays too short to spare SORT_AUTO_MIN_DISTINCT_SAMPLE elements (one in
+ * 16) are not sampled.
+ *
+ * @param arr_p Array to sample.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param sample Sample to update.
+ * @return Void.
+ */
+void
+sort_auto_sample_distinct(const char* arr_p, size_t nelems, size_t size,
+                          int (*compare)(const void*, const void*),
+                          SortAutoSample* sample)
+{
+  size_t m = nelems / 16 < SORT_AUTO_DISTINCT_NELEMS
+             ? nelems / 16 : SORT_AUTO_DISTINCT_NELEMS;
+  if (m < SORT_AUTO_MIN_DISTINCT_SAMPLE) {
+    return;
+  }
+  char* buf = malloc(m * size);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, m * size);
+  for (size_t k = 0; k < m; k++) {
+    memcpy(buf+(k * size), arr_p+((k * nelems / m) * size), size);
+  }
+  binary_insert_sort(buf, m, size, compare);
+  size_t distinct = 1;
+  for (size_t k = 1; k < m; k++) {
+    distinct += compare(buf+((k - 1) * size), buf+(k * size)) != 0;
+  }
+  sample->sampled = m;
+  sample->distinct = distinct;
+  free(buf);
+}
+
+/** @} */
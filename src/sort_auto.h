@@ -0,0 +1,83 @@
+/**
+ * @file
+ * @brief Adaptive sort dispatcher header file.
+ */
+#ifndef MY_SORT_AUTO_
+#define MY_SORT_AUTO_
+
+#include <stdlib.h>
+
+/**
+ * @def SORT_AUTO_INSERT_NELEMS
+ * @brief Number of elements below which insertion sort is chosen. */
+#define SORT_AUTO_INSERT_NELEMS 256
+/**
+ * @def SORT_AUTO_INSERT_BYTES
+ * @brief Largest array, in bytes, for which insertion sort is chosen. */
+#define SORT_AUTO_INSERT_BYTES 4096
+/**
+ * @def SORT_AUTO_WINDOWS
+ * @brief Number of contiguous windows sampled for runs. */
+#define SORT_AUTO_WINDOWS 32
+/**
+ * @def SORT_AUTO_WINDOW_NELEMS
+ * @brief Number of elements in each sampled window. */
+#define SORT_AUTO_WINDOW_NELEMS 32
+/**
+ * @def SORT_AUTO_DISTINCT_NELEMS
+ * @brief Number of elements sampled to estimate the duplicate ratio. */
+#define SORT_AUTO_DISTINCT_NELEMS 64
+/**
+ * @def SORT_AUTO_MIN_DISTINCT_SAMPLE
+ * @brief Minimum number of elements worth sampling for duplicates. */
+#define SORT_AUTO_MIN_DISTINCT_SAMPLE 16
+/**
+ * @def SORT_AUTO_MAX_SWAP_SIZE
+ * @brief Largest element size for which quicksort is chosen over
+ * merge_sort_tiled(). */
+#define SORT_AUTO_MAX_SWAP_SIZE 8
+/**
+ * @def SORT_AUTO_MIN_RUN
+ * @brief Estimated mean run length at which Timsort is chosen. */
+#define SORT_AUTO_MIN_RUN 16
+
+/**
+ * @ingroup AutoSort
+ * @enum SortAutoChoice
+ * @brief Sort chosen by sort_auto().
+ */
+typedef enum SortAutoChoice {
+  SORT_AUTO_INSERT, ///< Tiny input: binary_insert_sort().
+  SORT_AUTO_TIMSORT, ///< Long ascending or descending runs: timsort().
+  SORT_AUTO_QUICK_3WAY, ///< Many duplicates: quick_sort_3way().
+  SORT_AUTO_QUICK, ///< Otherwise: quick_sort().
+  SORT_AUTO_MERGE, ///< Otherwise, for wide elements: merge_sort_tiled().
+  SORT_AUTO_NCHOICES
+} SortAutoChoice;
+
+/**
+ * @ingroup AutoSort
+ * @struct SortAutoSample
+ * @brief Struct to represent the presortedness estimated from a sample.
+ */
+typedef struct SortAutoSample {
+  size_t pairs; ///< Adjacent pairs compared within windows.
+  size_t asc_pairs; ///< Pairs which are in order (a <= b).
+  size_t desc_pairs; ///< Pairs which are strictly descending (a > b).
+  size_t turns; ///< Pairs whose direction differs from the previous pair.
+  size_t sampled; ///< Elements sampled for duplicates.
+  size_t distinct; ///< Distinct values among sampled elements.
+} SortAutoSample;
+
+//##############################################################################
+//# AUTO SORT
+//##############################################################################
+
+void sort_auto(void* arr, size_t nelems, size_t size,
+               int (*compare)(const void*, const void*));
+SortAutoChoice sort_auto_choose(const void* arr, size_t nelems, size_t size,
+                                int (*compare)(const void*, const void*),
+                                SortAutoSample* sample);
+const char* sort_auto_choice_name(SortAutoChoice choice);
+
+#endif /* MY_SORT_AUTO_ */
@@ -0,0 +1,223 @@
+/**
+ * @file
+ * @brief Sort by extracted key implementation.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sort_by_key.h"
+#include "cosort.h"
+#include "sort_stats.h"
+#include "doxygen.h"
+
+static void sort_by_key_radix(const char* arr, size_t nelems, size_t size,
+                              void (*key_fn)(const void*, void*),
+                              size_t key_size, size_t* perm);
+static void sort_by_key_bytes(const char* arr, size_t nelems, size_t size,
+                              void (*key_fn)(const void*, void*),
+                              size_t key_size, size_t* perm);
+static uint64_t sort_by_key_load(const unsigned char* key, size_t key_size);
+static uint64_t sort_by_key_load_bytes(const unsigned char* key,
+                                       size_t nbytes);
+
+/**
+ * @addtogroup SortByKey
+ * @{
+ */
+
+/**
+ * @brief Sort generic array by a key computed once per element.
+ *
+ * A Schwartzian transform: key_fn() writes the key_size byte key of each
+ * element, once, and the keys are sorted with their indices, so that neither
+ * key_fn() nor the elements are touched again until the elements are moved
+ * once, at the end (see cosort_apply()). Worth it when keys are costly to
+ * compute, e.g. parsed from strings, which a comparison function would do
+ * twice per comparison.
+ *
+ * If key_compare is NULL, keys of 1, 2, 4 or 8 bytes are unsigned integers,
+ * and are sorted by LSD radix, skipping bytes which are equal across all
+ * keys. Other integer keys (e.g. signed ones) can be mapped onto unsigned
+ * ones by key_fn(). Keys of any other size are byte strings, ordered as by
+ * memcmp() (see sort_by_key_bytes()). Otherwise, keys are sorted with
+ * key_compare by cosort_permutation().
+ *
+ * The sort is stable.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param key_fn Function to write key of element (first argument) to
+ * key_size bytes (second argument).
+ * @param key_size Size of each key.
+ * @param key_compare Function to be used to compare keys, or NULL for
+ * unsigned integer or byte string keys.
+ * @return Void.
+ */
+void
+sort_by_key(void* arr, size_t nelems, size_t size,
+            void (*key_fn)(const void*, void*), size_t key_size,
+            int (*key_compare)(const void*, const void*))
+{
+  if (nelems < 2) {
+    return;
+  }
+  const char* arr_p = (const char*) arr;
+  size_t* perm = malloc(nelems * sizeof(size_t));
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, nelems * sizeof(size_t));
+  if (key_compare == NULL && (key_size == 1 || key_size == 2
+                              || key_size == 4 || key_size == 8)) {
+    sort_by_key_radix(arr_p, nelems, size, key_fn, key_size, perm);
+  } else if (key_compare == NULL) {
+    sort_by_key_bytes(arr_p, nelems, size, key_fn, key_size, perm);
+  } else {
+    SORT_STATS_WRAP(key_compare);
+    char* keys = malloc(nelems * key_size + 1);
+    SORT_STATS_ADD(allocs, 1);
+    SORT_STATS_ADD(aux_bytes, nelems * key_size);
+    for (size_t i = 0; i < nelems; i++) {
+      key_fn(arr_p+(i * size), keys+(i * key_size));
+    }
+    cosort_permutation(keys, nelems, key_size, key_compare, perm);
+    free(keys);
+  }
+  cosort_apply(arr, nelems, size, perm, NULL);
+  free(perm);
+}
+
+/**
+ * @brief Stably sort unsigned integer keys by LSD radix, a byte at a time.
+ *
+ * Keys are widened to 64 bits, paired with their indices and sorted by
+ * cosort_radix().
+ *
+ * @param arr Array being sorted (not moved).
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param key_fn Function to write key of element.
+ * @param key_size Size of each key (1, 2, 4 or 8).
+ * @param perm Set so that perm[i] is the index of the element which belongs
+ * at i.
+ * @return Void.
+ */
+void
+sort_by_key_radix(const char* arr, size_t nelems, size_t size,
+                  void (*key_fn)(const void*, void*), size_t key_size,
+                  size_t* perm)
+{
+  CosortEntry* entries = malloc(2 * nelems * sizeof(CosortEntry));
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, 2 * nelems * sizeof(CosortEntry));
+  for (size_t i = 0; i < nelems; i++) {
+    unsigned char key[sizeof(uint64_t)];
+    key_fn(arr+(i * size), key);
+    entries[i].key = sort_by_key_load(key, key_size);
+    entries[i].index = i;
+  }
+  const CosortEntry* sorted = cosort_radix(entries, entries + nelems, nelems,
+                                           key_size);
+  for (size_t i = 0; i < nelems; i++) {
+    perm[i] = sorted[i].index;
+  }
+  free(entries);
+}
+
+/**
+ * @brief Stably sort byte string keys in memcmp() order.
+ *
+ * Keys are written once into a buffer. Then, from the last 8 bytes to the
+ * first, each 8-byte chunk is read big-endian into a CosortEntry and sorted
+ * by cosort_radix() in the order left by the previous chunk.
+ *
+ * @param arr Array being sorted (not moved).
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param key_fn Function to write key of element.
+ * @param key_size Size of each key.
+ * @param perm Set so that perm[i] is the index of the element which belongs
+ * at i.
+ * @return Void.
+ */
+void
+sort_by_key_bytes(const char* arr, size_t nelems, size_t size,
+                  void (*key_fn)(const void*, void*), size_t key_size,
+                  size_t* perm)
+{
+  unsigned char* keys = malloc(nelems * key_size + 1);
+  CosortEntry* entries = malloc(2 * nelems * sizeof(CosortEntry));
+  SORT_STATS_ADD(allocs, 2);
+  SORT_STATS_ADD(aux_bytes, nelems * key_size
+                            + 2 * nelems * sizeof(CosortEntry));
+  for (size_t i = 0; i < nelems; i++) {
+    key_fn(arr+(i * size), keys+(i * key_size));
+    perm[i] = i;
+  }
+  for (size_t end = key_size; end > 0;) {
+    const size_t nbytes = end < sizeof(uint64_t) ? end : sizeof(uint64_t);
+    end -= nbytes;
+    for (size_t i = 0; i < nelems; i++) {
+      entries[i].key = sort_by_key_load_bytes(keys+(perm[i] * key_size + end),
+                                              nbytes);
+      entries[i].index = perm[i];
+    }
+    const CosortEntry* sorted = cosort_radix(entries, entries + nelems,
+                                             nelems, nbytes);
+    for (size_t i = 0; i < nelems; i++) {
+      perm[i] = sorted[i].index;
+    }
+  }
+  free(entries);
+  free(keys);
+}
+
+/**
+ * @brief Widen unsigned integer key to 64 bits.
+ *
+ * @param key Key, in native byte order.
+ * @param key_size Size of key (1, 2, 4 or 8).
+ * @return Value of key.
+ */
+uint64_t
+sort_by_key_load(const unsigned char* key, size_t key_size)
+{
+  uint8_t u8;
+  uint16_t u16;
+  uint32_t u32;
+  uint64_t u64;
+  switch (key_size) {
+    case 1:
+      memcpy(&u8, key, sizeof(u8));
+      return u8;
+    case 2:
+      memcpy(&u16, key, sizeof(u16));
+      return u16;
+    case 4:
+      memcpy(&u32, key, sizeof(u32));
+      return u32;
+    default:
+      memcpy(&u64, key, sizeof(u64));
+      return u64;
+  }
+}
+
+/**
+ * @brief Read bytes as a big-endian unsigned integer, so that integer order
+ * is memcmp() order.
+ *
+ * @param key Bytes to read.
+ * @param nbytes Number of bytes (at most 8).
+ * @return Value of bytes.
+ */
+uint64_t
+sort_by_key_load_bytes(const unsigned char* key, size_t nbytes)
+{
+  uint64_t value = 0;
+  for (size_t b = 0; b < nbytes; b++) {
+    value = value << 8 | key[b];
+  }
+  return value;
+}
+
+/** @} */
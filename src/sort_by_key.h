@@ -0,0 +1,18 @@
+/**
+ * @file
+ * @brief Sort by extracted key header file.
+ */
+#ifndef MY_SORT_BY_KEY_
+#define MY_SORT_BY_KEY_
+
+#include <stdlib.h>
+
+//##############################################################################
+//# SORT BY KEY
+//##############################################################################
+
+void sort_by_key(void* arr, size_t nelems, size_t size,
+                 void (*key_fn)(const void*, void*), size_t key_size,
+                 int (*key_compare)(const void*, const void*));
+
+#endif /* MY_SORT_BY_KEY_ */
@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @brief Sort control (cancellation and deadlines) implementation.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <time.h>
+
+#include "sort_control.h"
+#include "doxygen.h"
+
+/**
+ * @addtogroup SortControl
+ * @{
+ */
+
+/**
+ * @brief Initialize control with no deadline, not cancelled.
+ *
+ * @param control Control to initialize.
+ * @return Void.
+ */
+void
+sort_control_init(SortControl* control)
+{
+  control->cancelled = 0;
+  control->deadline_ns = 0;
+}
+
+/**
+ * @brief Ask sorts using control to stop.
+ *
+ * Safe to call from any thread while a sort is running.
+ *
+ * @param control Control to cancel.
+ * @return Void.
+ */
+void
+sort_control_cancel(SortControl* control)
+{
+  __atomic_store_n(&control->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Set deadline to given time from now.
+ *
+ * @param control Control to set deadline of.
+ * @param timeout_ns Nanoseconds from now.
+ * @return Void.
+ */
+void
+sort_control_set_timeout(SortControl* control, uint64_t timeout_ns)
+{
+  control->deadline_ns = sort_control_now() + timeout_ns;
+}
+
+/**
+ * @brief Check whether a sort using control should stop.
+ *
+ * Cancellation takes precedence over the deadline.
+ *
+ * @param control Control to check.
+ * @return SORT_OK if sort should continue, else reason to stop.
+ */
+SortStatus
+sort_control_poll(const SortControl* control)
+{
+  if (__atomic_load_n(&control->cancelled, __ATOMIC_RELAXED)) {
+    return SORT_CANCELLED;
+  }
+  if (control->deadline_ns != 0 && sort_control_now() >= control->deadline_ns) {
+    return SORT_DEADLINE_EXCEEDED;
+  }
+  return SORT_OK;
+}
+
+/**
+ * @brief Get current time on the clock deadlines are measured against.
+ *
+ * @return Nanoseconds of CLOCK_MONOTONIC.
+ */
+uint64_t
+sort_control_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/** @} */
@@ -0,0 +1,49 @@
+/**
+ * @file
+ * @brief Sort control (cancellation and deadlines) header file.
+ */
+#ifndef MY_SORT_CONTROL_
+#define MY_SORT_CONTROL_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def SORT_CONTROL_NELEMS
+ * @brief Controlled sorts only poll their SortControl before merging or
+ * partitioning at least this many elements, so that polling stays cheap
+ * relative to the work between polls. */
+#define SORT_CONTROL_NELEMS 4096
+
+/**
+ * @ingroup SortControl
+ * @enum SortStatus
+ * @brief Outcomes of a controlled sort.
+ */
+typedef enum SortStatus {
+  SORT_OK, ///< Sorted.
+  SORT_CANCELLED, ///< Stopped by sort_control_cancel().
+  SORT_DEADLINE_EXCEEDED ///< Stopped at the deadline.
+} SortStatus;
+
+/**
+ * @ingroup SortControl
+ * @struct SortControl
+ * @brief Struct to represent conditions under which a sort should stop.
+ */
+typedef struct SortControl {
+  int cancelled; ///< Set by sort_control_cancel(), from any thread.
+  uint64_t deadline_ns; ///< Absolute sort_control_now() deadline (0: none).
+} SortControl;
+
+//##############################################################################
+//# SORT CONTROL
+//##############################################################################
+
+void sort_control_init(SortControl* control);
+void sort_control_cancel(SortControl* control);
+void sort_control_set_timeout(SortControl* control, uint64_t timeout_ns);
+SortStatus sort_control_poll(const SortControl* control);
+uint64_t sort_control_now();
+
+#endif /* MY_SORT_CONTROL_ */
@@ -0,0 +1,372 @@
+/**
+ * @file
+ * @brief Asynchronous sort job implementation.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "sort_job.h"
+#include "parallel.h"
+#include "trace.h"
+#include "doxygen.h"
+
+static void* sort_pool_worker(void* arg);
+static SortJobHandle* sort_pool_take(SortPool* pool);
+static void sort_pool_enqueue(SortPool* pool, SortJobHandle* handle);
+static void sort_job_finish(SortJobHandle* handle, SortJobStatus status);
+
+/**
+ * @addtogroup AsyncSort
+ * @{
+ */
+
+/**
+ * @brief Start pool of worker threads which run submitted sort jobs.
+ *
+ * @param nthreads Number of worker threads. If 0, one per processor.
+ * @return New pool, or NULL if no worker thread could be started.
+ */
+SortPool*
+sort_pool_init(size_t nthreads)
+{
+  if (nthreads == 0) {
+    nthreads = parallel_ncpus();
+  }
+  SortPool* pool = malloc(sizeof(SortPool));
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  for (int p = 0; p < SORT_JOB_NPRIORITIES; p++) {
+    pool->heads[p] = NULL;
+    pool->tails[p] = NULL;
+  }
+  pool->stopping = 0;
+  pool->nsubmitted = 0;
+  pool->threads = malloc(nthreads * sizeof(pthread_t));
+  pool->nthreads = 0;
+  while (pool->nthreads < nthreads
+         && pthread_create(&pool->threads[pool->nthreads], NULL,
+                           sort_pool_worker, pool) == 0) {
+    pool->nthreads++;
+  }
+  if (pool->nthreads == 0) {
+    sort_pool_free(&pool);
+  }
+  return pool;
+}
+
+/**
+ * @brief Stop pool, once running jobs have finished.
+ *
+ * Jobs still queued are cancelled (their callbacks are called with
+ * SORT_JOB_CANCELLED on this thread). Afterwards, only sort_poll() and
+ * sort_handle_free() may be used on the pool's handles.
+ *
+ * @param pool Pool to free.
+ * @return Void.
+ */
+void
+sort_pool_free(SortPool** pool)
+{
+  SortPool* p = *pool;
+  pthread_mutex_lock(&p->lock);
+  p->stopping = 1;
+  SortJobHandle* cancelled = NULL;
+  SortJobHandle* handle;
+  while ((handle = sort_pool_take(p)) != NULL) {
+    __atomic_store_n(&handle->status, SORT_JOB_RUNNING, __ATOMIC_RELEASE);
+    handle->next = cancelled;
+    cancelled = handle;
+  }
+  pthread_cond_broadcast(&p->work);
+  pthread_mutex_unlock(&p->lock);
+
+  for (size_t t = 0; t < p->nthreads; t++) {
+    pthread_join(p->threads[t], NULL);
+  }
+  while (cancelled != NULL) {
+    handle = cancelled;
+    cancelled = cancelled->next;
+    sort_job_finish(handle, SORT_JOB_CANCELLED);
+  }
+
+  pthread_cond_destroy(&p->work);
+  pthread_cond_destroy(&p->done);
+  pthread_mutex_destroy(&p->lock);
+  free(p->threads);
+  free(p);
+  *pool = NULL;
+}
+
+/**
+ * @brief Queue sort job to be run by pool.
+ *
+ * The job may run at once; the caller must not touch its array until the job
+ * is done or cancelled.
+ *
+ * @param pool Pool to run job.
+ * @param job Job to run (copied).
+ * @return Handle to poll, wait for, cancel and finally free the job.
+ */
+SortJobHandle*
+sort_submit(SortPool* pool, const SortJob* job)
+{
+  SortJobHandle* handle;
+  sort_submit_batch(pool, job, 1, &handle);
+  return handle;
+}
+
+/**
+ * @brief Queue several sort jobs at once.
+ *
+ * Jobs are queued under a single lock acquisition and workers are woken
+ * once, rather than once per job.
+ *
+ * @param pool Pool to run jobs.
+ * @param jobs Jobs to run (copied).
+ * @param njobs Number of jobs.
+ * @param handles Set to a handle for each job.
+ * @return Void.
+ */
+void
+sort_submit_batch(SortPool* pool, const SortJob* jobs, size_t njobs,
+                  SortJobHandle** handles)
+{
+  for (size_t j = 0; j < njobs; j++) {
+    handles[j] = malloc(sizeof(SortJobHandle));
+    handles[j]->job = jobs[j];
+    if (handles[j]->job.priority >= SORT_JOB_NPRIORITIES) {
+      handles[j]->job.priority = SORT_JOB_LOW;
+    }
+    handles[j]->status = SORT_JOB_QUEUED;
+    handles[j]->pool = pool;
+    handles[j]->next = NULL;
+  }
+  pthread_mutex_lock(&pool->lock);
+  for (size_t j = 0; j < njobs; j++) {
+    handles[j]->id = pool->nsubmitted++;
+    sort_pool_enqueue(pool, handles[j]);
+  }
+  if (njobs == 1) {
+    pthread_cond_signal(&pool->work);
+  } else if (njobs > 1) {
+    pthread_cond_broadcast(&pool->work);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Get status of job without blocking.
+ *
+ * @param handle Job to check.
+ * @return Current status of job.
+ */
+SortJobStatus
+sort_poll(SortJobHandle* handle)
+{
+  return __atomic_load_n(&handle->status, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Block until job is done or cancelled.
+ *
+ * @param handle Job to wait for.
+ * @return SORT_JOB_DONE or SORT_JOB_CANCELLED.
+ */
+SortJobStatus
+sort_wait(SortJobHandle* handle)
+{
+  SortPool* pool = handle->pool;
+  pthread_mutex_lock(&pool->lock);
+  while (handle->status == SORT_JOB_QUEUED
+         || handle->status == SORT_JOB_RUNNING) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  SortJobStatus status = handle->status;
+  pthread_mutex_unlock(&pool->lock);
+  return status;
+}
+
+/**
+ * @brief Cancel job if it has not started yet.
+ *
+ * A cancelled job's callback is called with SORT_JOB_CANCELLED on this
+ * thread before returning.
+ *
+ * @param handle Job to cancel.
+ * @return Returns 1 if job was cancelled, 0 if it already started.
+ */
+int
+sort_cancel(SortJobHandle* handle)
+{
+  SortPool* pool = handle->pool;
+  const SortJobPriority p = handle->job.priority;
+  pthread_mutex_lock(&pool->lock);
+  if (handle->status != SORT_JOB_QUEUED) {
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+  }
+  SortJobHandle** link = &pool->heads[p];
+  SortJobHandle* prev = NULL;
+  while (*link != handle) {
+    prev = *link;
+    link = &(*link)->next;
+  }
+  *link = handle->next;
+  if (pool->tails[p] == handle) {
+    pool->tails[p] = prev;
+  }
+  __atomic_store_n(&handle->status, SORT_JOB_RUNNING, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&pool->lock);
+  sort_job_finish(handle, SORT_JOB_CANCELLED);
+  return 1;
+}
+
+/**
+ * @brief Free handle of finished job.
+ *
+ * @note Must not be called from the job's callback, nor before the job is
+ * done or cancelled.
+ *
+ * @param handle Handle to free.
+ * @return Void.
+ */
+void
+sort_handle_free(SortJobHandle** handle)
+{
+  free(*handle);
+  *handle = NULL;
+}
+
+/**
+ * @brief Run jobs until pool stops and its queues are empty.
+ *
+ * A small job is followed by further queued small jobs of the same priority,
+ * taken under the same lock acquisition, up to SORT_JOB_BATCH_NELEMS
+ * elements in total.
+ *
+ * Each job is traced as a "sort_job" phase of the worker which ran it, with
+ * its id.
+ *
+ * @param arg Pool (SortPool).
+ * @return NULL.
+ */
+void*
+sort_pool_worker(void* arg)
+{
+  SortPool* pool = (SortPool*) arg;
+  TRACE_THREAD_NAME("sort_pool worker");
+  pthread_mutex_lock(&pool->lock);
+  while (1) {
+    SortJobHandle* batch = sort_pool_take(pool);
+    if (batch == NULL) {
+      if (pool->stopping) {
+        break;
+      }
+      pthread_cond_wait(&pool->work, &pool->lock);
+      continue;
+    }
+    __atomic_store_n(&batch->status, SORT_JOB_RUNNING, __ATOMIC_RELEASE);
+    SortJobHandle* last = batch;
+    size_t nelems = batch->job.nelems;
+    const SortJobPriority p = batch->job.priority;
+    while (nelems <= SORT_JOB_BATCH_NELEMS && pool->heads[p] != NULL
+           && nelems + pool->heads[p]->job.nelems <= SORT_JOB_BATCH_NELEMS) {
+      SortJobHandle* more = sort_pool_take(pool);
+      if (more == NULL) {
+        break;
+      }
+      __atomic_store_n(&more->status, SORT_JOB_RUNNING, __ATOMIC_RELEASE);
+      nelems += more->job.nelems;
+      last->next = more;
+      last = more;
+    }
+    last->next = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    while (batch != NULL) {
+      SortJobHandle* next = batch->next;
+      const SortJob* job = &batch->job;
+      TRACE_BEGIN_ARGS("sort_job", "id", batch->id, "nelems", job->nelems);
+      job->sort(job->arr, job->nelems, job->size, job->compare);
+      TRACE_END("sort_job");
+      sort_job_finish(batch, SORT_JOB_DONE);
+      batch = next;
+    }
+    pthread_mutex_lock(&pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/**
+ * @brief Remove first job of highest priority queue.
+ *
+ * @note Pool must be locked.
+ *
+ * @param pool Pool to take job from.
+ * @return Job, or NULL if all queues are empty.
+ */
+SortJobHandle*
+sort_pool_take(SortPool* pool)
+{
+  for (int p = 0; p < SORT_JOB_NPRIORITIES; p++) {
+    SortJobHandle* handle = pool->heads[p];
+    if (handle != NULL) {
+      pool->heads[p] = handle->next;
+      if (pool->heads[p] == NULL) {
+        pool->tails[p] = NULL;
+      }
+      return handle;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Append job to queue of its priority.
+ *
+ * @note Pool must be locked.
+ *
+ * @param pool Pool to queue job in.
+ * @param handle Job to queue.
+ * @return Void.
+ */
+void
+sort_pool_enqueue(SortPool* pool, SortJobHandle* handle)
+{
+  const SortJobPriority p = handle->job.priority;
+  if (pool->tails[p] == NULL) {
+    pool->heads[p] = handle;
+  } else {
+    pool->tails[p]->next = handle;
+  }
+  pool->tails[p] = handle;
+}
+
+/**
+ * @brief Call job's callback, then publish its final status.
+ *
+ * The status is set last, so that a thread which sees it may free the
+ * handle.
+ *
+ * @param handle Job which has finished.
+ * @param status SORT_JOB_DONE or SORT_JOB_CANCELLED.
+ * @return Void.
+ */
+void
+sort_job_finish(SortJobHandle* handle, SortJobStatus status)
+{
+  if (handle->job.callback != NULL) {
+    handle->job.callback(&handle->job, status);
+  }
+  SortPool* pool = handle->pool;
+  pthread_mutex_lock(&pool->lock);
+  __atomic_store_n(&handle->status, status, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&pool->done);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/** @} */
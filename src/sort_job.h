@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Asynchronous sort job header file.
+ */
+#ifndef MY_SORT_JOB_
+#define MY_SORT_JOB_
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/**
+ * @def SORT_JOB_BATCH_NELEMS
+ * @brief Jobs of at most this many elements are small, and a worker runs
+ * queued small jobs of equal priority back to back until their total length
+ * reaches this many elements. */
+#define SORT_JOB_BATCH_NELEMS 4096
+
+/**
+ * @ingroup AsyncSort
+ * @enum SortJobPriority
+ * @brief Priorities of sort jobs. Queued jobs of a higher priority always run
+ * before those of a lower one.
+ */
+typedef enum SortJobPriority {
+  SORT_JOB_HIGH, ///< Latency-critical.
+  SORT_JOB_NORMAL, ///< Default.
+  SORT_JOB_LOW, ///< Bulk work.
+  SORT_JOB_NPRIORITIES
+} SortJobPriority;
+
+/**
+ * @ingroup AsyncSort
+ * @enum SortJobStatus
+ * @brief States of a submitted sort job.
+ */
+typedef enum SortJobStatus {
+  SORT_JOB_QUEUED, ///< Waiting for a worker.
+  SORT_JOB_RUNNING, ///< Being sorted (or its callback is running).
+  SORT_JOB_DONE, ///< Sorted.
+  SORT_JOB_CANCELLED ///< Cancelled before it started (array untouched).
+} SortJobStatus;
+
+/**
+ * @ingroup AsyncSort
+ * @struct SortJob
+ * @brief Struct to represent a sort to be run asynchronously.
+ */
+typedef struct SortJob {
+  void (*sort)(void* arr, size_t nelems, size_t size,
+               int (*compare)(const void*, const void*)); ///< Sort to run.
+  void* arr; ///< Array to be sorted.
+  size_t nelems; ///< Number of elements in array.
+  size_t size; ///< Size of each element in array.
+  int (*compare)(const void*, const void*); ///< Function to compare elements.
+  SortJobPriority priority; ///< Queue the job waits in.
+  void (*callback)(const struct SortJob* job, SortJobStatus status);
+      ///< Called once the job is done or cancelled (NULL: none).
+  void* ctx; ///< Passed through to callback.
+} SortJob;
+
+/**
+ * @ingroup AsyncSort
+ * @struct SortJobHandle
+ * @brief Struct to represent a submitted sort job.
+ */
+typedef struct SortJobHandle {
+  SortJob job; ///< Copy of submitted job.
+  SortJobStatus status; ///< Current state (read with sort_poll()).
+  struct SortPool* pool; ///< Pool the job was submitted to.
+  struct SortJobHandle* next; ///< Next job in the same queue.
+  size_t id; ///< Number of jobs submitted to pool before this one.
+} SortJobHandle;
+
+/**
+ * @ingroup AsyncSort
+ * @struct SortPool
+ * @brief Struct to represent worker threads and their job queues.
+ */
+typedef struct SortPool {
+  pthread_mutex_t lock; ///< Guards queues, statuses and stopping.
+  pthread_cond_t work; ///< Signalled when jobs are queued or pool stops.
+  pthread_cond_t done; ///< Broadcast when any job finishes.
+  SortJobHandle* heads[SORT_JOB_NPRIORITIES]; ///< First queued job.
+  SortJobHandle* tails[SORT_JOB_NPRIORITIES]; ///< Last queued job.
+  int stopping; ///< Whether workers should exit.
+  size_t nsubmitted; ///< Number of jobs submitted so far.
+  size_t nthreads; ///< Number of worker threads.
+  pthread_t* threads; ///< Worker threads.
+} SortPool;
+
+//##############################################################################
+//# SORT POOL
+//##############################################################################
+
+SortPool* sort_pool_init(size_t nthreads);
+void sort_pool_free(SortPool** pool);
+
+//##############################################################################
+//# SORT JOBS
+//##############################################################################
+
+SortJobHandle* sort_submit(SortPool* pool, const SortJob* job);
+void sort_submit_batch(SortPool* pool, const SortJob* jobs, size_t njobs,
+                       SortJobHandle** handles);
+SortJobStatus sort_poll(SortJobHandle* handle);
+SortJobStatus sort_wait(SortJobHandle* handle);
+int sort_cancel(SortJobHandle* handle);
+void sort_handle_free(SortJobHandle** handle);
+
+#endif /* MY_SORT_JOB_ */
@@ -0,0 +1,181 @@
+/**
+ * @file
+ * @brief Sort statistics implementation.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort_stats.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup SortStats
+ * @brief Counters updated by sorts built with -DSORT_STATS.
+ *
+ * @note Counters are global and not synchronized. Collect statistics from one
+ * sorting thread at a time.
+ */
+SortStats sort_stats;
+
+/**
+ * @ingroup SortStats
+ * @brief Comparison functions wrapped by sort_stats_wrap(), one per slot.
+ *
+ * A slot is claimed by the first comparison function wrapped in it and never
+ * changes afterwards, so that a wrapped function stays valid on any thread,
+ * however sorts nest.
+ */
+static int (*sort_stats_user_compares[SORT_STATS_NSLOTS])(const void*,
+                                                          const void*);
+
+/**
+ * @ingroup SortStats
+ * @def SORT_STATS_COMPARE
+ * @brief Define counting comparison function which defers to slot n. */
+#define SORT_STATS_COMPARE(n) \
+  static int \
+  sort_stats_compare_##n(const void* a, const void* b) \
+  { \
+    sort_stats.compares++; \
+    return __atomic_load_n(&sort_stats_user_compares[n], __ATOMIC_ACQUIRE)( \
+        a, b); \
+  }
+
+SORT_STATS_COMPARE(0)
+SORT_STATS_COMPARE(1)
+SORT_STATS_COMPARE(2)
+SORT_STATS_COMPARE(3)
+SORT_STATS_COMPARE(4)
+SORT_STATS_COMPARE(5)
+SORT_STATS_COMPARE(6)
+SORT_STATS_COMPARE(7)
+SORT_STATS_COMPARE(8)
+SORT_STATS_COMPARE(9)
+SORT_STATS_COMPARE(10)
+SORT_STATS_COMPARE(11)
+SORT_STATS_COMPARE(12)
+SORT_STATS_COMPARE(13)
+SORT_STATS_COMPARE(14)
+SORT_STATS_COMPARE(15)
+
+/**
+ * @ingroup SortStats
+ * @brief Counting comparison function of each slot.
+ */
+static int (* const sort_stats_compares[SORT_STATS_NSLOTS])(const void*,
+                                                            const void*) = {
+  sort_stats_compare_0, sort_stats_compare_1, sort_stats_compare_2,
+  sort_stats_compare_3, sort_stats_compare_4, sort_stats_compare_5,
+  sort_stats_compare_6, sort_stats_compare_7, sort_stats_compare_8,
+  sort_stats_compare_9, sort_stats_compare_10, sort_stats_compare_11,
+  sort_stats_compare_12, sort_stats_compare_13, sort_stats_compare_14,
+  sort_stats_compare_15
+};
+
+/**
+ * @addtogroup SortStats
+ * @{
+ */
+
+/**
+ * @brief Reset all counters to zero.
+ *
+ * Call before a sort to collect statistics for that sort alone.
+ *
+ * @return Void.
+ */
+void
+sort_stats_reset()
+{
+  memset(&sort_stats, 0, sizeof(sort_stats));
+}
+
+/**
+ * @brief Get current value of all counters.
+ *
+ * @return Copy of counters. All zero if not built with -DSORT_STATS.
+ */
+SortStats
+sort_stats_get()
+{
+  return sort_stats;
+}
+
+/**
+ * @brief Check whether statistics are collected by this build.
+ *
+ * @return Returns 1 if built with -DSORT_STATS else 0.
+ */
+int
+sort_stats_enabled()
+{
+#ifdef SORT_STATS
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * @brief Wrap comparison function so that its calls are counted.
+ *
+ * Sorts call this on entry (via SORT_STATS_WRAP). Because sorts call one
+ * another (e.g. merge_sort() defers to insert_sort()), an already wrapped
+ * function is returned unchanged.
+ *
+ * Each distinct comparison function is bound to a slot of its own for the
+ * life of the process, so sorts which nest with different comparison
+ * functions (e.g. segmented_sort_parallel() sorting its tasks), or which run
+ * on several threads, each keep calling their own. Beyond SORT_STATS_NSLOTS
+ * distinct functions, calls are no longer counted.
+ *
+ * @param compare Function to compare elements.
+ * @return Counting comparison function, or compare if all slots are taken.
+ */
+int
+(*sort_stats_wrap(int (*compare)(const void*, const void*)))
+    (const void*, const void*)
+{
+  for (int s = 0; s < SORT_STATS_NSLOTS; s++) {
+    if (compare == sort_stats_compares[s]) {
+      return compare;
+    }
+  }
+  for (int s = 0; s < SORT_STATS_NSLOTS; s++) {
+    int (*user)(const void*, const void*) =
+        __atomic_load_n(&sort_stats_user_compares[s], __ATOMIC_ACQUIRE);
+    if (user == NULL
+        && __atomic_compare_exchange_n(&sort_stats_user_compares[s], &user,
+                                       compare, 0, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_ACQUIRE)) {
+      return sort_stats_compares[s];
+    }
+    if (user == compare) {
+      return sort_stats_compares[s];
+    }
+  }
+  return compare;
+}
+
+/**
+ * @brief Record new value of Timsort's galloping threshold.
+ *
+ * @param min_gallop New value of min_gallop.
+ * @return Void.
+ */
+void
+sort_stats_min_gallop(int min_gallop)
+{
+  if (sort_stats.min_gallop_updates == 0
+      || min_gallop < sort_stats.min_gallop_min) {
+    sort_stats.min_gallop_min = min_gallop;
+  }
+  if (sort_stats.min_gallop_updates == 0
+      || min_gallop > sort_stats.min_gallop_max) {
+    sort_stats.min_gallop_max = min_gallop;
+  }
+  sort_stats.min_gallop_last = min_gallop;
+  sort_stats.min_gallop_updates++;
+}
+
+/** @} */
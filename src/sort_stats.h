@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Sort statistics header file.
+ *
+ * Statistics are only collected when the library is compiled with
+ * -DSORT_STATS (e.g. `make SORT_STATS=1`). Otherwise, every SORT_STATS_*
+ * macro expands to nothing and sorts run without any overhead.
+ */
+#ifndef MY_SORT_STATS_
+#define MY_SORT_STATS_
+
+#include <stdlib.h>
+
+/**
+ * @def SORT_STATS_NSLOTS
+ * @brief Maximum number of distinct comparison functions whose calls are
+ * counted. */
+#define SORT_STATS_NSLOTS 16
+
+/**
+ * @ingroup SortStats
+ * @struct SortStats
+ * @brief Struct to represent counters collected during sorts.
+ */
+typedef struct SortStats {
+  size_t compares; ///< Total calls to comparison function.
+  size_t bytes_moved; ///< Total bytes copied while moving elements.
+  size_t swaps; ///< Total element swaps.
+  size_t allocs; ///< Total heap allocations.
+  size_t aux_bytes; ///< Total bytes of heap allocations.
+  size_t runs; ///< Timsort: total runs pushed onto the runs stack.
+  size_t merges; ///< Timsort: total merges of two runs.
+  size_t gallop_enters; ///< Timsort: total entries into galloping mode.
+  size_t gallop_exits; ///< Timsort: total exits from galloping mode.
+  size_t min_gallop_updates; ///< Timsort: total changes to min_gallop.
+  int min_gallop_min; ///< Timsort: smallest value reached by min_gallop.
+  int min_gallop_max; ///< Timsort: largest value reached by min_gallop.
+  int min_gallop_last; ///< Timsort: final value of min_gallop.
+  size_t auto_dispatches; ///< sort_auto(): total dispatches.
+  int auto_choice; ///< sort_auto(): last SortAutoChoice made.
+  size_t merge_passes; ///< merge_sort_tiled(): total passes over the array.
+} SortStats;
+
+//##############################################################################
+//# SORT STATS
+//##############################################################################
+
+void sort_stats_reset();
+SortStats sort_stats_get();
+int sort_stats_enabled();
+
+int (*sort_stats_wrap(int (*compare)(const void*, const void*)))
+    (const void*, const void*);
+void sort_stats_min_gallop(int min_gallop);
+
+#ifdef SORT_STATS
+extern SortStats sort_stats;
+/**
+ * @def SORT_STATS_ADD
+ * @brief Add n to the given SortStats counter. */
+#define SORT_STATS_ADD(field, n) (sort_stats.field += (n))
+/**
+ * @def SORT_STATS_SET
+ * @brief Set the given SortStats field to v. */
+#define SORT_STATS_SET(field, v) (sort_stats.field = (v))
+/**
+ * @def SORT_STATS_WRAP
+ * @brief Replace comparison function with one which counts its calls. */
+#define SORT_STATS_WRAP(compare) ((compare) = sort_stats_wrap(compare))
+/**
+ * @def SORT_STATS_MIN_GALLOP
+ * @brief Record new value of Timsort's galloping threshold. */
+#define SORT_STATS_MIN_GALLOP(min_gallop) sort_stats_min_gallop(min_gallop)
+#else
+#define SORT_STATS_ADD(field, n) ((void)0)
+#define SORT_STATS_SET(field, v) ((void)0)
+#define SORT_STATS_WRAP(compare) ((void)0)
+#define SORT_STATS_MIN_GALLOP(min_gallop) ((void)0)
+#endif
+
+#endif /* MY_SORT_STATS_ */
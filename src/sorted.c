@@ -0,0 +1,228 @@
+/**
+ * @file
+ * @brief Sorted order checks implementation.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "sorted.h"
+#include "doxygen.h"
+
+/*
+ * Typed scans compare every adjacent pair of a block without branching, so
+ * that the compiler can vectorize the inner loop (e.g. GCC at -O3), and only
+ * branch once per block of SORTED_BLOCK_NELEMS elements. 'out_of_order' is
+ * an expression in a[j] and a[j + 1].
+ */
+#define SORTED_SCAN(type, arr, nelems, out_of_order)                   \
+  do {                                                                 \
+    const type* a = (arr);                                             \
+    for (size_t i = 0; i + 1 < (nelems); i += SORTED_BLOCK_NELEMS) {   \
+      size_t end = i + SORTED_BLOCK_NELEMS < (nelems) - 1              \
+                   ? i + SORTED_BLOCK_NELEMS : (nelems) - 1;           \
+      int bad = 0;                                                     \
+      for (size_t j = i; j < end; j++) {                               \
+        bad |= (out_of_order);                                         \
+      }                                                                \
+      if (bad) {                                                       \
+        return 0;                                                      \
+      }                                                                \
+    }                                                                  \
+    return 1;                                                          \
+  } while (0)
+
+/**
+ * @addtogroup Sorted
+ * @{
+ */
+
+/**
+ * @brief Check whether array is sorted (non-descending).
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @return Returns 1 if no element is greater than its successor else 0.
+ *
+ * @see is_sorted_i32()
+ */
+int
+is_sorted(const void* arr, size_t nelems, size_t size,
+          int (*compare)(const void*, const void*))
+{
+  const char* arr_p = (const char*) arr;
+  for (size_t i = 1; i < nelems; i++) {
+    if (compare(arr_p+((i - 1) * size), arr_p+(i * size)) > 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Check whether array is strictly descending.
+ *
+ * Equal neighbours are rejected, so that an array which passes can be
+ * reversed in place without breaking stability.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @return Returns 1 if every element is greater than its successor else 0.
+ *
+ * @see is_reverse_sorted_i32()
+ */
+int
+is_reverse_sorted(const void* arr, size_t nelems, size_t size,
+                  int (*compare)(const void*, const void*))
+{
+  const char* arr_p = (const char*) arr;
+  for (size_t i = 1; i < nelems; i++) {
+    if (compare(arr_p+((i - 1) * size), arr_p+(i * size)) <= 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Check whether array of 32-bit signed integers is sorted.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is non-descending else 0.
+ */
+int
+is_sorted_i32(const int32_t* arr, size_t nelems)
+{
+  SORTED_SCAN(int32_t, arr, nelems, a[j] > a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of 32-bit unsigned integers is sorted.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is non-descending else 0.
+ */
+int
+is_sorted_u32(const uint32_t* arr, size_t nelems)
+{
+  SORTED_SCAN(uint32_t, arr, nelems, a[j] > a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of 64-bit signed integers is sorted.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is non-descending else 0.
+ */
+int
+is_sorted_i64(const int64_t* arr, size_t nelems)
+{
+  SORTED_SCAN(int64_t, arr, nelems, a[j] > a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of 64-bit unsigned integers is sorted.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is non-descending else 0.
+ */
+int
+is_sorted_u64(const uint64_t* arr, size_t nelems)
+{
+  SORTED_SCAN(uint64_t, arr, nelems, a[j] > a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of doubles is sorted.
+ *
+ * @note Pairs involving NaN are unordered and never count as out of order.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is non-descending else 0.
+ */
+int
+is_sorted_f64(const double* arr, size_t nelems)
+{
+  SORTED_SCAN(double, arr, nelems, a[j] > a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of 32-bit signed integers is strictly
+ * descending.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is strictly descending else 0.
+ */
+int
+is_reverse_sorted_i32(const int32_t* arr, size_t nelems)
+{
+  SORTED_SCAN(int32_t, arr, nelems, a[j] <= a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of 32-bit unsigned integers is strictly
+ * descending.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is strictly descending else 0.
+ */
+int
+is_reverse_sorted_u32(const uint32_t* arr, size_t nelems)
+{
+  SORTED_SCAN(uint32_t, arr, nelems, a[j] <= a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of 64-bit signed integers is strictly
+ * descending.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is strictly descending else 0.
+ */
+int
+is_reverse_sorted_i64(const int64_t* arr, size_t nelems)
+{
+  SORTED_SCAN(int64_t, arr, nelems, a[j] <= a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of 64-bit unsigned integers is strictly
+ * descending.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is strictly descending else 0.
+ */
+int
+is_reverse_sorted_u64(const uint64_t* arr, size_t nelems)
+{
+  SORTED_SCAN(uint64_t, arr, nelems, a[j] <= a[j + 1]);
+}
+
+/**
+ * @brief Check whether array of doubles is strictly descending.
+ *
+ * @note Pairs involving NaN are unordered and never count as out of order.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @return Returns 1 if array is strictly descending else 0.
+ */
+int
+is_reverse_sorted_f64(const double* arr, size_t nelems)
+{
+  SORTED_SCAN(double, arr, nelems, a[j] <= a[j + 1]);
+}
+
+/** @} */
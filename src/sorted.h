@@ -0,0 +1,41 @@
+/**
+ * @file
+ * @brief Sorted order checks header file.
+ */
+#ifndef MY_SORTED_
+#define MY_SORTED_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def SORTED_BLOCK_NELEMS
+ * @brief Number of elements checked between early exits by typed scans. */
+#define SORTED_BLOCK_NELEMS 64
+
+//##############################################################################
+//# GENERIC
+//##############################################################################
+
+int is_sorted(const void* arr, size_t nelems, size_t size,
+              int (*compare)(const void*, const void*));
+int is_reverse_sorted(const void* arr, size_t nelems, size_t size,
+                      int (*compare)(const void*, const void*));
+
+//##############################################################################
+//# TYPED
+//##############################################################################
+
+int is_sorted_i32(const int32_t* arr, size_t nelems);
+int is_sorted_u32(const uint32_t* arr, size_t nelems);
+int is_sorted_i64(const int64_t* arr, size_t nelems);
+int is_sorted_u64(const uint64_t* arr, size_t nelems);
+int is_sorted_f64(const double* arr, size_t nelems);
+
+int is_reverse_sorted_i32(const int32_t* arr, size_t nelems);
+int is_reverse_sorted_u32(const uint32_t* arr, size_t nelems);
+int is_reverse_sorted_i64(const int64_t* arr, size_t nelems);
+int is_reverse_sorted_u64(const uint64_t* arr, size_t nelems);
+int is_reverse_sorted_f64(const double* arr, size_t nelems);
+
+#endif /* MY_SORTED_ */
@@ -12,8 +12,62 @@
 
 #include "sorting.h"
 #include "stack.h"
+#include "sort_control.h"
+#include "sort_stats.h"
+#include "perf.h"
+#include "trace.h"
 #include "doxygen.h"
 
+/*
+ * Building with -DSORT_TUNED includes the table generated for this machine by
+ * `make autotune` in place of the defaults below.
+ */
+#ifdef SORT_TUNED
+#include "sort_tuning_gen.h"
+#endif
+
+#ifndef SORT_TUNING_TABLE
+#define SORT_TUNING_DEFAULT \
+  { LENGTH_THRESHOLD, MIN_GALLOP, TIMSORT_MIN_NELEMS, COMB_SHRINK }
+#define SORT_TUNING_TABLE { \
+  SORT_TUNING_DEFAULT, SORT_TUNING_DEFAULT, SORT_TUNING_DEFAULT, \
+  SORT_TUNING_DEFAULT, SORT_TUNING_DEFAULT, SORT_TUNING_DEFAULT, \
+  SORT_TUNING_DEFAULT, SORT_TUNING_DEFAULT \
+}
+#endif
+
+/**
+ * @ingroup Tuning
+ * @brief Tuning of each element size class.
+ */
+static SortTuning sort_tunings[SORT_TUNING_NCLASSES] = SORT_TUNING_TABLE;
+
+/**
+ * @ingroup Precheck
+ * @brief Whether sorts first check for sorted or reversed input.
+ */
+static int sort_precheck_enabled = 0;
+
+/**
+ * @ingroup Precheck
+ * @def SORT_PRECHECK
+ * @brief Returns nonzero if array was already sorted (or has been reversed
+ * into sorted order) by an enabled pre-check. */
+#define SORT_PRECHECK(arr, nelems, size, compare) \
+  (sort_precheck_enabled && sort_precheck(arr, nelems, size, compare))
+
+/**
+ * @ingroup SortControl
+ * @brief Control of the controlled sort running on this thread (NULL: none).
+ */
+static __thread const SortControl* sort_control = NULL;
+
+/**
+ * @ingroup SortControl
+ * @brief Why the controlled sort running on this thread stopped, if it has.
+ */
+static __thread SortStatus sort_control_status = SORT_OK;
+
 /**
  * @ingroup Timsort
  * @struct TimsortRun.
@@ -53,6 +107,10 @@ void
 insert_sort(void* arr, size_t nelems, size_t size, 
             int (*compare)(const void*, const void*))
 {
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
   if (nelems == 0) {
     return;
   }
@@ -77,6 +135,8 @@ insert_sort_partial(void* arr, size_t size,
 {
   char* arr_p = (char*) arr;
   void* curr = malloc(size);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, size);
   size_t j;
   for (size_t i = lo + size; i <= hi; i += size) {
     memcpy(curr, arr_p+(i), size);
@@ -87,6 +147,7 @@ insert_sort_partial(void* arr, size_t size,
     j = (j > hi) ? lo : j + size;
     memmove(arr_p+(j + size), arr_p+(j), i - j);
     memcpy(arr_p+(j), curr, size);
+    SORT_STATS_ADD(bytes_moved, i - j + 2 * size);
   }
   free(curr);
 }
@@ -105,6 +166,10 @@ void
 binary_insert_sort(void* arr, size_t nelems, size_t size, 
                    int (*compare)(const void*, const void*)) 
 {
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
   if (nelems == 0) {
     return;
   }
@@ -141,7 +206,9 @@ binary_insert_sort_partial(void* arr, size_t size,
 {
   char* arr_p = (char*) arr;
   void* selected = malloc(size);
-  
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, size);
+
   size_t m;
   size_t l;
   size_t r;
@@ -157,6 +224,7 @@ binary_insert_sort_partial(void* arr, size_t size,
     }
     memmove(arr_p+(r + size), arr_p+(r), i - r);
     memcpy(arr_p+(r), selected, size);
+    SORT_STATS_ADD(bytes_moved, i - r + 2 * size);
   }
 
   free(selected);
@@ -176,6 +244,10 @@ void
 select_sort(void* arr, size_t nelems, size_t size, 
             int (*compare)(const void*, const void*))
 {
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
   /**
    * @brief To avoid issues with size_t wrapping, and as an empty array is
    * sorted, return immediately if nelems is 0.
@@ -227,9 +299,13 @@ void
 comb_sort(void* arr, size_t nelems, size_t size, 
           int (*compare)(const void*, const void*))
 {
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
   char* arr_p = (char*) arr;
   const size_t max_mem = nelems * size;
-  const double shrink = 1.3 * size;
+  const double shrink = sort_tuning_get(size)->comb_shrink * size;
 
   size_t gap = max_mem;
   size_t i = 0;
@@ -260,7 +336,8 @@ comb_sort(void* arr, size_t nelems, size_t size,
  * @brief Sort generic array using merge sort.
  *
  * Merge sort is not efficient for small arrays. As such, merge sort is only
- * performed if the length of the array is above LENGTH_THRESHOLD.
+ * performed if the length of the array is above the length threshold (see
+ * SortTuning).
  *
  * The function creates an auxillary array to make merging more efficient.
  * Without the auxillary array, each merge would require updating the
@@ -284,11 +361,18 @@ void
 merge_sort(void* arr, size_t nelems, size_t size, 
            int (*compare)(const void*, const void*))
 {
-  if (nelems <= LENGTH_THRESHOLD) {
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
+  if (nelems <= sort_tuning_get(size)->length_threshold) {
     insert_sort(arr, nelems, size, compare);
   } else {
     void* aux = malloc(size * nelems);
+    SORT_STATS_ADD(allocs, 1);
+    SORT_STATS_ADD(aux_bytes, size * nelems);
     memcpy(aux, arr, size * nelems);
+    SORT_STATS_ADD(bytes_moved, size * nelems);
     merge_sort_recursive(aux, arr, size, compare, 0, (nelems - 1) * size);
     free(aux);
   }
@@ -329,12 +413,23 @@ merge_sort_recursive(void* arr, void* aux, size_t size,
 {
   if (hi <= lo) {
     return;
-  } else if (hi - lo <= (LENGTH_THRESHOLD * size)) {
+  } else if (hi - lo <= sort_tuning_get(size)->length_threshold * size) {
     insert_sort_partial(aux, size, compare, lo, hi);
   } else {
+    /*
+     * Both arrays hold the subarray's elements on entry, and each call leaves
+     * them that way whether it merges or not. A stopped sort therefore
+     * leaves a permutation in both.
+     */
+    if (sort_control_stop((hi - lo) / size)) {
+      return;
+    }
     size_t mid = ((hi + lo) / 2 / size) * size;
     merge_sort_recursive(aux, arr, size, compare, lo, mid);
     merge_sort_recursive(aux, arr, size, compare, mid + size, hi);
+    if (sort_control_stop(0)) {
+      return;
+    }
     merge_sort_merge(arr, aux, size, compare, lo, mid, hi);
   }
 }
@@ -370,6 +465,269 @@ merge_sort_merge(void* arr, void* aux, size_t size,
       j += size;
     }
   }
+  SORT_STATS_ADD(bytes_moved, hi - lo + size);
+}
+
+/**
+ * @ingroup MergeSort
+ * @brief Sort generic array using bottom-up merge sort.
+ *
+ * Same merges as merge_sort(), without recursion: blocks of length_threshold
+ * + 1 elements are first sorted by insertion sort, then adjacent blocks of
+ * doubling width are merged, alternating between the array and a single
+ * auxillary array. The result is copied back only if it ends up in the
+ * auxillary array. Uses O(1) call stack regardless of nelems, for callers
+ * running on small stacks.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @return Void.
+ *
+ * @see merge_sort()
+ * @see merge_sort_merge()
+ */
+void
+merge_sort_iterative(void* arr, size_t nelems, size_t size, 
+                     int (*compare)(const void*, const void*))
+{
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
+  const size_t threshold = sort_tuning_get(size)->length_threshold;
+  if (nelems <= threshold) {
+    insert_sort(arr, nelems, size, compare);
+    return;
+  }
+  const size_t total = nelems * size;
+  const size_t block = (threshold + 1) * size;
+  for (size_t lo = 0; lo < total; lo += block) {
+    size_t hi = (total - lo > block) ? lo + block : total;
+    insert_sort_partial(arr, size, compare, lo, hi - size);
+  }
+
+  void* aux = malloc(total);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, total);
+  char* src = (char*) arr;
+  char* dst = (char*) aux;
+  for (size_t width = block; width < total; width *= 2) {
+    for (size_t lo = 0; lo < total; lo += 2 * width) {
+      if (total - lo <= width) {
+        // Lone final block, nothing to merge it with.
+        memcpy(dst+(lo), src+(lo), total - lo);
+        SORT_STATS_ADD(bytes_moved, total - lo);
+      } else {
+        size_t hi = (total - lo > 2 * width) ? lo + 2 * width : total;
+        merge_sort_merge(src, dst, size, compare, lo, lo + width - size,
+                         hi - size);
+      }
+    }
+    char* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  if (src != (char*) arr) {
+    memcpy(arr, src, total);
+    SORT_STATS_ADD(bytes_moved, total);
+  }
+  free(aux);
+}
+
+/**
+ * @ingroup MergeSort
+ * @brief Sort generic array using cache-aware bottom-up merge sort.
+ *
+ * The array is cut into tiles of about MERGE_SORT_TILE_BYTES, and each tile is
+ * sorted while it is in cache: blocks of length_threshold + 1 elements by
+ * insertion sort, then 4-way merges within the tile. Tiles are then merged
+ * 4 at a time, so that sorting n bytes makes 1 + log4(n / tile) passes through
+ * memory, half as many as with 2-way merges.
+ *
+ * Passes alternate between the array and a single auxillary array. Counting
+ * the passes up front decides which of the two the tiles are sorted into, so
+ * that the last pass ends in the array without an initial or final copy of
+ * the whole array.
+ *
+ * Unlike merge_sort(), ties are taken from the earlier run, so the sort is
+ * stable.
+ *
+ * With SORT_STATS, merge_passes counts passes through memory (the tile phase
+ * counts as one).
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @return Void.
+ *
+ * @see merge_sort()
+ * @see merge_sort_merge4()
+ */
+void
+merge_sort_tiled(void* arr, size_t nelems, size_t size, 
+                 int (*compare)(const void*, const void*))
+{
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
+  const size_t threshold = sort_tuning_get(size)->length_threshold;
+  if (nelems <= threshold) {
+    insert_sort(arr, nelems, size, compare);
+    return;
+  }
+  const size_t total = nelems * size;
+  const size_t block = (threshold + 1) * size;
+  const size_t tile_blocks = MERGE_SORT_TILE_BYTES / block;
+  const size_t tile = (tile_blocks > 0 ? tile_blocks : 1) * block;
+  size_t passes = 0;
+  for (size_t width = tile; width < total; width *= 4) {
+    passes++;
+  }
+
+  void* aux = malloc(total);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, total);
+  const int into_aux = passes % 2 == 1;
+  for (size_t lo = 0; lo < total; lo += tile) {
+    size_t hi = (total - lo > tile) ? lo + tile : total;
+    merge_sort_tiled_tile(arr, aux, into_aux, size, compare, lo, hi, block);
+  }
+  SORT_STATS_ADD(merge_passes, 1);
+
+  char* src = into_aux ? (char*) aux : (char*) arr;
+  char* dst = into_aux ? (char*) arr : (char*) aux;
+  for (size_t width = tile; width < total; width *= 4) {
+    for (size_t lo = 0; lo < total; lo += 4 * width) {
+      size_t bounds[5];
+      for (int r = 0; r < 5; r++) {
+        bounds[r] = (total - lo > r * width) ? lo + r * width : total;
+      }
+      merge_sort_merge4(src, dst, size, compare, bounds);
+    }
+    SORT_STATS_ADD(merge_passes, 1);
+    char* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  free(aux);
+}
+
+/**
+ * @ingroup MergeSort
+ * @brief Sort one tile of merge_sort_tiled().
+ *
+ * Blocks are insertion sorted in arr, then merged 4-way back and forth
+ * between arr and aux. If the result ends in the other array than requested,
+ * the tile (still in cache) is copied across.
+ *
+ * @param arr Array containing the tile.
+ * @param aux Auxillary array of the same length.
+ * @param into_aux Whether the sorted tile should end up in aux.
+ * @param size Size of each element in either array.
+ * @param compare Function to be used to compare elements.
+ * @param lo Lower bound of the tile (inclusive).
+ * @param hi Upper bound of the tile (exclusive).
+ * @param block Bytes in each insertion sorted block.
+ * @return Void.
+ */
+void
+merge_sort_tiled_tile(void* arr, void* aux, int into_aux, size_t size, 
+                      int (*compare)(const void*, const void*), 
+                      size_t lo, size_t hi, size_t block)
+{
+  for (size_t b = lo; b < hi; b += block) {
+    size_t end = (hi - b > block) ? b + block : hi;
+    insert_sort_partial(arr, size, compare, b, end - size);
+  }
+  char* src = (char*) arr;
+  char* dst = (char*) aux;
+  for (size_t width = block; width < hi - lo; width *= 4) {
+    for (size_t b = lo; b < hi; b += 4 * width) {
+      size_t bounds[5];
+      for (int r = 0; r < 5; r++) {
+        bounds[r] = (hi - b > r * width) ? b + r * width : hi;
+      }
+      merge_sort_merge4(src, dst, size, compare, bounds);
+    }
+    char* tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+  if ((src == (char*) aux) != into_aux) {
+    memcpy(dst+(lo), src+(lo), hi - lo);
+    SORT_STATS_ADD(bytes_moved, hi - lo);
+  }
+}
+
+/**
+ * @ingroup MergeSort
+ * @brief Merge up to four adjacent sorted runs from src into dst.
+ *
+ * The runs are [bounds[0], bounds[1]), ..., [bounds[3], bounds[4]), any of
+ * which may be empty. Heads are compared as a tournament: the winners of runs
+ * 0 / 1 and of runs 2 / 3 are remembered, so that each element output costs
+ * two comparisons, replaying only the pair it came from. Ties go to the
+ * earlier run.
+ *
+ * @param src Array containing the runs.
+ * @param dst Array into which merged runs are copied (same offsets).
+ * @param size Size of each element in either array.
+ * @param compare Function to be used to compare elements.
+ * @param bounds Byte offsets delimiting the four runs.
+ * @return Void.
+ */
+void
+merge_sort_merge4(const void* src, void* dst, size_t size, 
+                  int (*compare)(const void*, const void*), 
+                  const size_t bounds[5])
+{
+  const char* src_p = (const char*) src;
+  char* dst_p = (char*) dst;
+  size_t pos[4] = { bounds[0], bounds[1], bounds[2], bounds[3] };
+  const size_t end[4] = { bounds[1], bounds[2], bounds[3], bounds[4] };
+  int low = merge_sort_merge4_pick(src_p, compare, pos, end, 0, 1);
+  int high = merge_sort_merge4_pick(src_p, compare, pos, end, 2, 3);
+  for (size_t k = bounds[0]; k < bounds[4]; k += size) {
+    int w = merge_sort_merge4_pick(src_p, compare, pos, end, low, high);
+    memcpy(dst_p+(k), src_p+(pos[w]), size);
+    pos[w] += size;
+    if (w < 2) {
+      low = merge_sort_merge4_pick(src_p, compare, pos, end, 0, 1);
+    } else {
+      high = merge_sort_merge4_pick(src_p, compare, pos, end, 2, 3);
+    }
+  }
+  SORT_STATS_ADD(bytes_moved, bounds[4] - bounds[0]);
+}
+
+/**
+ * @ingroup MergeSort
+ * @brief Pick the run with the smaller head, treating empty runs as larger
+ * than anything.
+ *
+ * @param src Array containing the runs.
+ * @param compare Function to be used to compare elements.
+ * @param pos Current head of each run.
+ * @param end End of each run (exclusive).
+ * @param a Earlier run, which wins ties.
+ * @param b Later run.
+ * @return a or b.
+ */
+int
+merge_sort_merge4_pick(const char* src, 
+                       int (*compare)(const void*, const void*), 
+                       const size_t pos[4], const size_t end[4], int a, int b)
+{
+  if (pos[b] == end[b]) {
+    return a;
+  } else if (pos[a] == end[a]) {
+    return b;
+  }
+  return compare(src+(pos[b]), src+(pos[a])) < 0 ? b : a;
 }
 
 /**
@@ -388,6 +746,10 @@ void
 quick_sort(void* arr, size_t nelems, size_t size, 
            int (*compare)(const void*, const void*))
 {
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
   if (nelems == 0) {
     return;
   }
@@ -418,15 +780,79 @@ quick_sort_recursive(void* arr, size_t size,
 {
   if (hi <= lo) {
     return;
-  } else if (hi - lo <= LENGTH_THRESHOLD * size) {
+  } else if (hi - lo <= sort_tuning_get(size)->length_threshold * size) {
     insert_sort_partial(arr, size, compare, lo, hi);
-  } else {
+  } else if (!sort_control_stop((hi - lo) / size)) {
     size_t pivot = quick_sort_partition(arr, size, compare, lo, hi);
     quick_sort_recursive(arr, size, compare, lo, pivot);
     quick_sort_recursive(arr, size, compare, pivot + size, hi);
   }
 }
 
+/**
+ * @ingroup QuickSort
+ * @brief Sort generic array using quicksort, without recursion.
+ *
+ * Same partitioning as quick_sort(), but pending subarrays are kept on a
+ * fixed array of QUICK_SORT_STACK_DEPTH (lo, hi) ranges on the call stack
+ * instead of in recursive calls. After each partition the larger side is
+ * pushed and the smaller side is sorted next, so every range on the stack is
+ * at least twice the size of the one above it and at most log2(nelems) are
+ * ever pending, even for adversarial inputs. Suitable for threads with small
+ * stacks.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @return Void.
+ *
+ * @see quick_sort()
+ * @see quick_sort_partition()
+ */
+void
+quick_sort_iterative(void* arr, size_t nelems, size_t size, 
+                     int (*compare)(const void*, const void*))
+{
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
+  if (nelems == 0) {
+    return;
+  }
+  const size_t threshold = sort_tuning_get(size)->length_threshold * size;
+  size_t ranges[QUICK_SORT_STACK_DEPTH][2];
+  size_t depth = 0;
+  size_t lo = 0;
+  size_t hi = (nelems - 1) * size;
+  while (1) {
+    if (hi > lo && hi - lo > threshold) {
+      size_t pivot = quick_sort_partition(arr, size, compare, lo, hi);
+      if (pivot - lo < hi - pivot - size) {
+        ranges[depth][0] = pivot + size;
+        ranges[depth][1] = hi;
+        hi = pivot;
+      } else {
+        ranges[depth][0] = lo;
+        ranges[depth][1] = pivot;
+        lo = pivot + size;
+      }
+      depth++;
+      continue;
+    }
+    if (hi > lo) {
+      insert_sort_partial(arr, size, compare, lo, hi);
+    }
+    if (depth == 0) {
+      return;
+    }
+    depth--;
+    lo = ranges[depth][0];
+    hi = ranges[depth][1];
+  }
+}
+
 /**
  * @ingroup QuickSort
  * @brief Partition subarray around pivot element.
@@ -475,6 +901,108 @@ quick_sort_partition(void* arr, size_t size,
   }
 }
 
+/**
+ * @ingroup QuickSort
+ * @brief Sort generic array using 3-way quicksort.
+ *
+ * Each partition splits the subarray into elements less than, equal to and
+ * greater than the pivot (Dijkstra's Dutch national flag scheme). Elements
+ * equal to the pivot are never revisited, so arrays with few unique values
+ * are sorted in close to linear time, where quick_sort() degrades.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @return Void.
+ *
+ * @see quick_sort()
+ */
+void
+quick_sort_3way(void* arr, size_t nelems, size_t size, 
+                int (*compare)(const void*, const void*))
+{
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
+  if (nelems == 0) {
+    return;
+  }
+  quick_sort_3way_recursive(arr, size, compare, 0, (nelems - 1) * size);
+}
+
+/**
+ * @ingroup QuickSort
+ * @brief Recursively perform 3-way quicksort.
+ *
+ * Only the smaller of the less-than and greater-than partitions is sorted
+ * recursively, the larger is sorted by the loop, bounding the recursion depth
+ * by log2(nelems).
+ *
+ * @param arr Array to be sorted.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param lo Lower index bound of current subarray (inclusive).
+ * @param hi Upper index bound of the current subarray (inclusive).
+ * @return Void.
+ *
+ * @see quick_sort_3way()
+ */
+void
+quick_sort_3way_recursive(void* arr, size_t size, 
+                          int (*compare)(const void*, const void*), 
+                          size_t lo, size_t hi)
+{
+  char* arr_p = (char*) arr;
+  const size_t threshold = sort_tuning_get(size)->length_threshold * size;
+  while (hi > lo) {
+    if (hi - lo <= threshold) {
+      insert_sort_partial(arr, size, compare, lo, hi);
+      return;
+    }
+    size_t mid = ((hi + lo) / 2 / size) * size;
+    size_t pivot = median_three(arr, size, lo, mid, hi, compare);
+    if (pivot != lo) {
+      swap(arr_p+(lo), arr_p+(pivot), size);
+    }
+
+    // Invariant: [lo, lt) < pivot, [lt, i) == pivot, (gt, hi] > pivot. The
+    // element at lt always equals the pivot, so no copy of it is needed.
+    size_t lt = lo;
+    size_t i = lo + size;
+    size_t gt = hi;
+    while (i <= gt) {
+      int cmp = compare(arr_p+(i), arr_p+(lt));
+      if (cmp < 0) {
+        swap(arr_p+(lt), arr_p+(i), size);
+        lt += size;
+        i += size;
+      } else if (cmp > 0) {
+        swap(arr_p+(i), arr_p+(gt), size);
+        gt -= size;
+      } else {
+        i += size;
+      }
+    }
+
+    if (lt - lo < hi - gt) {
+      if (lt > lo) {
+        quick_sort_3way_recursive(arr, size, compare, lo, lt - size);
+      }
+      lo = gt + size;
+    } else {
+      if (gt < hi) {
+        quick_sort_3way_recursive(arr, size, compare, gt + size, hi);
+      }
+      if (lt == lo) {
+        return;
+      }
+      hi = lt - size;
+    }
+  }
+}
+
 /**
  * @ingroup Timsort
  * @brief Sort generic array using Timsort.
@@ -483,7 +1011,7 @@ quick_sort_partition(void* arr, size_t size,
  * combining insertion sort and an optimized merge sort. 
  * The algorithm proceeds as follows:
  *
- * - If array to sort is shorter than 64 elements:
+ * - If array to sort is shorter than 64 elements (see SortTuning):
  *   -# Defer to insertion sort.
  *      - When array is this short, minrun will equal the length of the array.
  *        As such, timsort offers no benefit over insertion sort in this case.
@@ -528,8 +1056,12 @@ void
 timsort(void* arr, size_t nelems, size_t size, 
         int (*compare)(const void*, const void*))
 {
-  enum { TIMSORT_MIN_NELEMS = 64 };
-  if (nelems < TIMSORT_MIN_NELEMS) {
+  SORT_STATS_WRAP(compare);
+  if (SORT_PRECHECK(arr, nelems, size, compare)) {
+    return;
+  }
+  const SortTuning* tuning = sort_tuning_get(size);
+  if (nelems < tuning->timsort_min_nelems) {
     binary_insert_sort(arr, nelems, size, compare);
   } else {
     const size_t minrun = timsort_minrun(nelems);
@@ -546,17 +1078,32 @@ timsort(void* arr, size_t nelems, size_t size,
      * expensive. So much so that it slows down function by noticeable amount.
      */
     const size_t max_runs = (nelems / minrun) + 1;
-    TimsortRun runs[max_runs];
-    memset(&runs, 0, (max_runs) * sizeof(TimsortRun));
+    /*
+     * NOTE: Runs array is allocated on the heap, as for large N it no longer
+     * fits on the call stack (~32MB for 10^8 elements).
+     */
+    TimsortRun* runs = calloc(max_runs, sizeof(TimsortRun));
+    SORT_STATS_ADD(allocs, 1);
+    SORT_STATS_ADD(aux_bytes, max_runs * sizeof(TimsortRun));
     TimsortMergeState merge_state = { 
       runs,
       0,
       max_runs,
-      MIN_GALLOP,
+      tuning->min_gallop,
       0
     };
+    SORT_STATS_MIN_GALLOP(merge_state.min_gallop);
+    TRACE_BEGIN_ARGS("timsort", "nelems", nelems, "minrun", minrun);
+    PERF_PHASE_ENTER(PERF_PHASE_FIND_RUNS);
+    TRACE_BEGIN("find_runs");
     timsort_find_runs(arr, nelems, size, compare, minrun, &merge_state);
+    TRACE_END("find_runs");
+    TRACE_BEGIN("collapse_runs");
     timsort_collapse_runs(arr, size, compare, &merge_state);
+    TRACE_END("collapse_runs");
+    PERF_PHASE_EXIT();
+    TRACE_END("timsort");
+    free(runs);
   }
 }
 /**
@@ -565,7 +1112,8 @@ timsort(void* arr, size_t nelems, size_t size,
  *
  * A run is a sequence of either either strictly descending or non-descending 
  * elements. Because for any sequence of elements {i, i+1}, either 
- * arr[i] > arr[i + 1] or arr[i] <= arr[i +1], a run is always occuring.
+ * arr[i] > arr[i + 1] or arr[i] <= arr[i +1], a run is always occuring. Each
+ * run is measured by timsort_count_run().
  *
  * Runs must be at least minrun elements long. If a run is shorter than this,
  * it is extended using consecutive elements. There is one exception; the last
@@ -588,6 +1136,7 @@ timsort(void* arr, size_t nelems, size_t size,
  * @return Void.
  *
  * @see timsort()
+ * @see timsort_count_run()
  * @see timsort_check_invariants()
  */
 void
@@ -599,48 +1148,73 @@ timsort_find_runs(void* arr, size_t nelems, size_t size,
   size_t minrun_size = minrun * size;
   size_t nelems_size = nelems * size;
 
-  // Result of comparison between previous element and current element.
-  int vs_prev = -1; 
-  // Result of comparison between current element and next element.
-  int vs_next = -1; 
-  // Indicate beginning of new run.
-  int new_run = 1;
-
-  for (size_t i = 0, max_size = nelems_size - size; i <= max_size; i += size) {
-    vs_next = i < max_size ? compare(arr_p+(i), arr_p+(i + size)) : -999;
-    if (i < max_size
-        /*
-         * Note: Previously only checked first condition. However, first
-         * condition doesn't fully account for non-descending series (e.g.
-         * going from strict increase to equality and back).
-         */
-        && (((vs_next == vs_prev) || (vs_next + vs_prev < 0)) || new_run)) {
-      vs_prev = vs_next;
-      new_run = 0;
-    } else {
-      ms->runs[ms->nruns].len = i - ms->runs[ms->nruns].start + size;
-      if (vs_prev > 0) {
-        reverse_array(arr, ms->runs[ms->nruns].start,
-                      ms->runs[ms->nruns].start 
-                      + ms->runs[ms->nruns].len - size, 
-                      size);
-      }
-      if (ms->runs[ms->nruns].len < minrun_size) {
-        ms->runs[ms->nruns].len = ms->runs[ms->nruns].start + minrun_size - size 
-                                  >= nelems_size 
-                                  ? nelems_size - ms->runs[ms->nruns].start 
-                                  : minrun_size;
-        i = ms->runs[ms->nruns].start + ms->runs[ms->nruns].len - size;
-        insert_sort_partial(arr, size, compare, ms->runs[ms->nruns].start, 
-                            (ms->runs[ms->nruns].start 
-                             + ms->runs[ms->nruns].len - size));
-      }
-      ms->nruns++;
-      timsort_check_invariants(arr, size, compare, ms);
-      ms->runs[ms->nruns].start = i + size;
-      new_run = 1;
+  size_t start = 0;
+  while (start < nelems_size && !sort_control_stop(0)) {
+    int descending = 0;
+    TimsortRun* run = &ms->runs[ms->nruns];
+    run->start = start;
+    run->len = timsort_count_run(arr_p+(start), (nelems_size - start) / size,
+                                 size, compare, &descending) * size;
+    if (descending) {
+      reverse_array(arr, run->start, run->start + run->len - size, size);
     }
+    if (run->len < minrun_size) {
+      run->len = run->start + minrun_size - size >= nelems_size 
+                 ? nelems_size - run->start 
+                 : minrun_size;
+      TRACE_BEGIN_ARGS("pad_run", "start", run->start / size,
+                       "len", run->len / size);
+      insert_sort_partial(arr, size, compare, run->start, 
+                          run->start + run->len - size);
+      TRACE_END("pad_run");
+    }
+    start = run->start + run->len;
+    ms->nruns++;
+    SORT_STATS_ADD(runs, 1);
+    timsort_check_invariants(arr, size, compare, ms);
+  }
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Find length of run at start of array.
+ *
+ * A run is a sequence of either strictly descending or non-descending 
+ * elements. Descending runs must be strict so that reversing them keeps the
+ * sort stable.
+ *
+ * @param arr Array starting with run.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @param descending Set to 1 if run is strictly descending, else 0.
+ * @return Number of elements in run (0 only if array is empty).
+ *
+ * @see timsort_find_runs()
+ */
+size_t
+timsort_count_run(const void* arr, size_t nelems, size_t size, 
+                  int (*compare)(const void*, const void*), int* descending)
+{
+  const char* arr_p = (const char*) arr;
+  *descending = 0;
+  if (nelems < 2) {
+    return nelems;
   }
+  size_t n = 2;
+  if (compare(arr_p, arr_p+(size)) > 0) {
+    *descending = 1;
+    while (n < nelems 
+           && compare(arr_p+((n - 1) * size), arr_p+(n * size)) > 0) {
+      n++;
+    }
+  } else {
+    while (n < nelems 
+           && compare(arr_p+((n - 1) * size), arr_p+(n * size)) <= 0) {
+      n++;
+    }
+  }
+  return n;
 }
 
 /**
@@ -728,8 +1302,8 @@ timsort_collapse_runs(void* arr, size_t size,
  *
  * To optimize merges, the function first finds the locations of right[0] in
  * left[] (lo), and left[max] in right[] (hi). As runs are increasing, all 
- * values in left[] before 'lo' are smaller than all value in right[], and 
- * likewise all values in right above 'hi' are greater than all values in 
+ * values in left[] before 'lo' are no greater than all values in right[], and 
+ * likewise all values in right above 'hi' are no less than all values in 
  * left[]. These values can be ignored during the merge.
  *
  * @param arr Array containing runs.
@@ -745,7 +1319,7 @@ timsort_collapse_runs(void* arr, size_t size,
  * @see timsort_collapse_runs()
  * @see timsort_merge_runs_lo()
  * @see timsort_merge_runs_hi()
- * @see bin_search_loc()
+ * @see timsort_gallop_right()
  */
 void
 timsort_merge_runs(void* arr, size_t size, 
@@ -754,26 +1328,42 @@ timsort_merge_runs(void* arr, size_t size,
                    TimsortMergeState* ms)
 {
   char* arr_p = (char*) arr;
-
-  size_t lo = bin_search_loc(arr, size, compare, 
-                             left->start, left->start + left->len - size, 
-                             arr_p+(right->start));
-  size_t hi = bin_search_loc(arr, size, compare, 
-                             right->start, right->start + right->len - size, 
-                             arr_p+(left->start + left->len - size));
-
-  size_t left_len_adj = left->len - (lo - left->start);
-  size_t right_len_adj = hi - right->start + size;
-
-  if (left_len_adj < right_len_adj) {
-    timsort_merge_runs_lo(arr, size, compare, lo, left_len_adj, 
-                          hi, right_len_adj, ms);
-  } else {
-    timsort_merge_runs_hi(arr, size, compare, lo, left_len_adj, 
-                          hi, right_len_adj, ms);
+  if (sort_control_stop((left->len + right->len) / size)) {
+    return;
+  }
+  SORT_STATS_ADD(merges, 1);
+  PERF_PHASE_ENTER(PERF_PHASE_MERGE);
+  TRACE_BEGIN_ARGS("merge_runs", "left_len", left->len / size,
+                   "right_len", right->len / size);
+
+  // Elements of left[] not greater than right[0] stay put, as do elements of
+  // right[] not less than left[max]; equal elements keep their order.
+  size_t lo = left->start
+              + timsort_gallop_right(arr, size, compare, left->start,
+                                     left->start + left->len - size,
+                                     arr_p+(right->start), 1);
+  if (lo < left->start + left->len) {
+    size_t hi = right->start - size
+                + timsort_gallop_right(arr, size, compare, right->start,
+                                       right->start + right->len - size,
+                                       arr_p+(left->start + left->len - size),
+                                       0);
+
+    size_t left_len_adj = left->len - (lo - left->start);
+    size_t right_len_adj = hi - right->start + size;
+
+    if (left_len_adj < right_len_adj) {
+      timsort_merge_runs_lo(arr, size, compare, lo, left_len_adj, 
+                            hi, right_len_adj, ms);
+    } else {
+      timsort_merge_runs_hi(arr, size, compare, lo, left_len_adj, 
+                            hi, right_len_adj, ms);
+    }
   }
 
   left->len = left->len + right->len;
+  TRACE_END("merge_runs");
+  PERF_PHASE_EXIT();
   return;
 }
 
@@ -792,9 +1382,9 @@ timsort_merge_runs(void* arr, size_t size,
  * Galloping Mode (galloping right):
  * In galloping mode, merges are performed as a pair of operations:
  * -# Find the location of left[0] in right[]. Merge all values (slice1) in 
- *    right[] up to this point and then merge left[0].
+ *    right[] less than left[0] and then merge left[0].
  * -# Find the location of right[0] in left[]. Merge all values (slice2) in
- *    left[] up to this point and then merge right[0].
+ *    left[] not greater than right[0] and then merge right[0].
  * Note: The runs left[] and right[] are altered between these operations.
  *
  * Galloping mode lets us take advantage of subruns in data, and by performing
@@ -834,6 +1424,9 @@ timsort_merge_runs_lo(void* arr, size_t size,
 {
   char* arr_p = (char*) arr;
   char* temp = malloc(lo_len);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, lo_len);
+  SORT_STATS_ADD(bytes_moved, lo_len);
   memcpy(temp, arr_p+(lo), lo_len);
 
   const size_t min_gallop_size = ms->min_gallop * size;
@@ -850,49 +1443,62 @@ timsort_merge_runs_lo(void* arr, size_t size,
   for (size_t k = lo; k <= hi; k += size) {
     if (ms->galloping) {
       if (l < lo_len && r <= hi) {
-        slice1 = timsort_gallop_right(arr, size, compare, r, hi, temp+(l));
+        slice1 = timsort_gallop_right(arr, size, compare, r, hi, temp+(l), 0);
         memmove(arr_p+(k), arr_p+(r), slice1);
         memcpy(arr_p+(k + slice1), temp+(l), size);
         k += slice1;
         l += size;
         r += slice1;
+        SORT_STATS_ADD(bytes_moved, slice1 + size);
 
         // If any of these conditions hold, the next gallop operation will fail.
         // Hence we should exit.
         if (r > hi || l >= lo_len || k >= hi) {
           ms->galloping = 0;
           ms->min_gallop++;
+          SORT_STATS_ADD(gallop_exits, 1);
+          TRACE_INSTANT("gallop_exit", "min_gallop", ms->min_gallop);
+          SORT_STATS_MIN_GALLOP(ms->min_gallop);
           continue;
         }
 
         k += size;
 
         slice2 = timsort_gallop_right(temp, size, compare, l, lo_len - size, 
-                                      arr_p+(r));
+                                      arr_p+(r), 1);
         memmove(arr_p+(k), temp+(l), slice2);
         memcpy(arr_p+(k + slice2), arr_p+(r), size);
         k += slice2;
         r += size;
         l += slice2;
+        SORT_STATS_ADD(bytes_moved, slice2 + size);
 
         if (slice1 < min_gallop_size || slice2 < min_gallop_size) {
           ms->galloping = 0;
           ms->min_gallop++;
+          SORT_STATS_ADD(gallop_exits, 1);
+          TRACE_INSTANT("gallop_exit", "min_gallop", ms->min_gallop);
+          SORT_STATS_MIN_GALLOP(ms->min_gallop);
         } else {
           ms->min_gallop--;
+          SORT_STATS_MIN_GALLOP(ms->min_gallop);
         }
       } else {
         slice1 = (r <= hi) ? hi - r + size : 0;
         slice2 = (l < lo_len) ? lo_len - l : 0;
         memmove(arr_p+(k), arr_p+(r), slice1); 
         memmove(arr_p+(k), temp+(l), slice2);
+        SORT_STATS_ADD(bytes_moved, slice1 + slice2);
         ms->galloping = 0;
         ms->min_gallop++;
+        SORT_STATS_ADD(gallop_exits, 1);
+        TRACE_INSTANT("gallop_exit", "min_gallop", ms->min_gallop);
+        SORT_STATS_MIN_GALLOP(ms->min_gallop);
         // Done with merge so break
         break;
       }
     } else {
-      if (l < lo_len && (r > hi || compare(temp+(l), arr_p+(r)) < 0)) {
+      if (l < lo_len && (r > hi || compare(temp+(l), arr_p+(r)) <= 0)) {
         memcpy(arr_p+(k), temp+(l), size);
         l += size;
         l_won++;
@@ -903,8 +1509,11 @@ timsort_merge_runs_lo(void* arr, size_t size,
         l_won = 0;
         r_won++;
       }
+      SORT_STATS_ADD(bytes_moved, size);
       if (l_won > ms->min_gallop || r_won > ms->min_gallop) {
         ms->galloping = 1;
+        SORT_STATS_ADD(gallop_enters, 1);
+        TRACE_INSTANT("gallop_enter", "min_gallop", ms->min_gallop);
         l_won = r_won = 0;
       }
     }
@@ -916,19 +1525,23 @@ timsort_merge_runs_lo(void* arr, size_t size,
 /**
  * @ingroup Timsort
  * @brief Gallop left to right to find slice of elements in source array less
- * than target.
+ * than target (or not greater than target, if ties is set).
  *
  * In order to find this slice, we need to find the number of elements in the
- * source array smaller than the target. Given that the source array
- * is sorted and ascendingr, it suffices to find where the target would be
+ * source array which belong before the target. Given that the source array
+ * is sorted and ascending, it suffices to find where the target would be
  * located in the source array.
  *
  * To determine this location, we perform a pair of searches:
- * -# We first perform an exponential search to find the value k such that 
- *    base + ((2^(k-1) - 1) * size < target <= base + ((2^k - 1) * size).
- *    This condenses the range of values in which the target must lie.
+ * -# We first perform an exponential search, comparing the target with the
+ *    elements at offsets 1, 3, 7, ..., (2^k - 1) from base until one belongs
+ *    after the target. This condenses the range of values in which the
+ *    target must lie.
  * -# We then perform binary search using this range.
  *
+ * Merges stay stable as long as elements of the left run are galloped over
+ * with ties set, and elements of the right run without.
+ *
  * @note The slice is a memory offset corresponding to the total size of 
  * these elements.
  *
@@ -938,7 +1551,8 @@ timsort_merge_runs_lo(void* arr, size_t size,
  * @param base Initial offset to begin gallop.
  * @param limit Maximum offset for galloping (inclusive).
  * @param target Target element.
- * @return Total size of elements in source array less than target.
+ * @param ties Whether elements equal to target belong before it.
+ * @return Total size of elements in source array before target.
  *
  * @see timsort()
  * @see timsort_merge_runs_lo()
@@ -946,50 +1560,35 @@ timsort_merge_runs_lo(void* arr, size_t size,
 size_t
 timsort_gallop_right(void* src, size_t size, 
                      int (*compare)(const void*, const void*), 
-                     size_t base, size_t limit, void* target)
+                     size_t base, size_t limit, void* target, int ties)
 {
   char* src_p = (char*) src;
+  // Element e belongs before target if compare(target, e) >= min_cmp.
+  const int min_cmp = ties ? 0 : 1;
+  const size_t nelems = (limit - base) / size + 1;
 
-  size_t slice = 0;
-  if (compare(target, src_p+(base)) > 0) {
-    size_t srch_lo = base;
-    size_t srch_hi = base;
-    // Power of 2 used for exponential search.
-    size_t gallop_exp = 2;
-    size_t gallop_ind;
-    while (1) {
-      srch_hi = base + ((gallop_exp - 1) * size);
-      // Only srch_hi needs to be checked, as srch_lo contains previous value
-      // of srch_hi which was valid.
-      if (srch_hi > limit) {
-        srch_hi = limit;
-        break;
-      }
-      // Note: Because we assign srch_hi to srch_lo if the comparison fails, we
-      // know compare(target, src_p+(srch_lo) > 0 for the next search.
-      if (!(compare(target, src_p+(srch_hi)) <= 0)) {
-        gallop_exp *= 2;
-        srch_lo = srch_hi;
-      } else {
-        break;
-      }
-    }
-    gallop_ind = bin_search_loc(src, size, compare, srch_lo, srch_hi, target);
-    slice = gallop_ind - base;
-    /*
-     * The bin_search_loc() function can at most return the offset of the last
-     * element of the array that it is searching. While this is fine if the 
-     * target is less than or equal to the last element (as the slice need not 
-     * include the final element), it means that the slice will be off by one 
-     * if the target element is larger than all elements in the array
-     * (as gallop_ind - slice can be at most array_size - size).
-     * This conditional is needed to account for this possibility.
-    */
-    if (gallop_ind == limit && compare(target, src_p+(gallop_ind)) > 0) {
-      slice += size;
+  if (compare(target, src_p+(base)) < min_cmp) {
+    return 0;
+  }
+  // Elements [0, before] belong before target, and those from after on don't.
+  size_t before = 0;
+  size_t after = 1;
+  while (after < nelems
+         && compare(target, src_p+(base + after * size)) >= min_cmp) {
+    before = after;
+    after = 2 * after + 1;
+  }
+  after = after < nelems ? after : nelems;
+  before++;
+  while (before < after) {
+    size_t mid = before + (after - before) / 2;
+    if (compare(target, src_p+(base + mid * size)) >= min_cmp) {
+      before = mid + 1;
+    } else {
+      after = mid;
     }
   }
-  return slice;
+  return before * size;
 }
 
 /**
@@ -1007,9 +1606,9 @@ timsort_gallop_right(void* src, size_t size,
  * Galloping Mode (galloping left):
  * In galloping mode, merges are performed as a pair of operations:
  * -# Find the location of right[max] in left[]. Merge all values (slice1) in 
- *    left[] down to this point and then merge right[max].
+ *    left[] greater than right[max] and then merge right[max].
  * -# Find the location of left[max] in right[]. Merge all values (slice2) in
- *    right[] down to this point and then merge left[max].
+ *    right[] not less than left[max] and then merge left[max].
  * Note: The runs left[] and right[] are altered between these operations.
  *
  * Galloping mode lets us take advantage of subruns in data, and by performing
@@ -1049,6 +1648,9 @@ timsort_merge_runs_hi(void* arr, size_t size,
 {
   char* arr_p = (char*) arr;
   char* temp = malloc(hi_len);
+  SORT_STATS_ADD(allocs, 1);
+  SORT_STATS_ADD(aux_bytes, hi_len);
+  SORT_STATS_ADD(bytes_moved, hi_len);
   memcpy(temp, arr_p+(hi - hi_len + size), hi_len);
 
   const size_t min_gallop_size = ms->min_gallop * size;
@@ -1066,7 +1668,7 @@ timsort_merge_runs_hi(void* arr, size_t size,
     if (ms->galloping) {
       // Condition given that indices are size_t
       if (r <= hi && (l >= lo && l <= hi)) {
-        slice1 = timsort_gallop_left(arr, size, compare, l, lo, temp+(r));
+        slice1 = timsort_gallop_left(arr, size, compare, l, lo, temp+(r), 0);
         // To avoid going out of bounds, check that slice is at least 1.
         if (slice1 > 0) {
           memmove(arr_p+(k - slice1 + size), arr_p+(l - slice1 + size), slice1);
@@ -1075,18 +1677,22 @@ timsort_merge_runs_hi(void* arr, size_t size,
         k -= slice1;
         r -= size;
         l -= slice1;
+        SORT_STATS_ADD(bytes_moved, slice1 + size);
 
         // If any of these conditions hold, the next gallop operation will fail.
         // Hence we should exit.
         if ((r > hi) || (l < lo || l > lo) || (k <= lo || k > hi)) {
           ms->galloping = 0;
           ms->min_gallop++;
+          SORT_STATS_ADD(gallop_exits, 1);
+          TRACE_INSTANT("gallop_exit", "min_gallop", ms->min_gallop);
+          SORT_STATS_MIN_GALLOP(ms->min_gallop);
           continue;
         }
 
         k -= size;
 
-        slice2 = timsort_gallop_left(temp, size, compare, r, 0, arr_p+(l));
+        slice2 = timsort_gallop_left(temp, size, compare, r, 0, arr_p+(l), 1);
         // To avoid going out of bounds, check that slice is at least 1.
         if (slice2 > 0) {
           memmove(arr_p+(k - slice2 + size), temp+(r - slice2 + size), slice2);
@@ -1095,25 +1701,34 @@ timsort_merge_runs_hi(void* arr, size_t size,
         k -= slice2;
         l -= size;
         r -= slice2;
+        SORT_STATS_ADD(bytes_moved, slice2 + size);
 
         if (slice1 < min_gallop_size || slice2 < min_gallop_size) {
           ms->galloping = 0;
           ms->min_gallop++;
+          SORT_STATS_ADD(gallop_exits, 1);
+          TRACE_INSTANT("gallop_exit", "min_gallop", ms->min_gallop);
+          SORT_STATS_MIN_GALLOP(ms->min_gallop);
         } else {
           ms->min_gallop--;
+          SORT_STATS_MIN_GALLOP(ms->min_gallop);
         }
       } else {
         slice1 = (l >= lo && l <= hi) ? lo_len - l + size : 0;
         slice2 = (r <= hi) ? r + size : 0;
         memmove(arr_p+(k - slice1 + size), arr_p+(l - slice1 + size), slice1); 
         memmove(arr_p+(k - slice2 + size), temp+(r - slice2 + size), slice2);
+        SORT_STATS_ADD(bytes_moved, slice1 + slice2);
         ms->galloping = 0;
         ms->min_gallop++;
+        SORT_STATS_ADD(gallop_exits, 1);
+        TRACE_INSTANT("gallop_exit", "min_gallop", ms->min_gallop);
+        SORT_STATS_MIN_GALLOP(ms->min_gallop);
         break;
       }
     } else {
       if (r <= hi 
-          && ((l < lo || l > hi) || compare(temp+(r), arr_p+(l)) > 0)) {
+          && ((l < lo || l > hi) || compare(temp+(r), arr_p+(l)) >= 0)) {
         memcpy(arr_p+(k), temp+(r), size);
         r -= size;
         r_won++;
@@ -1124,8 +1739,11 @@ timsort_merge_runs_hi(void* arr, size_t size,
         r_won = 0;
         l_won++;
       }
+      SORT_STATS_ADD(bytes_moved, size);
       if (l_won > ms->min_gallop || r_won > ms->min_gallop) {
         ms->galloping = 1;
+        SORT_STATS_ADD(gallop_enters, 1);
+        TRACE_INSTANT("gallop_enter", "min_gallop", ms->min_gallop);
         l_won = r_won = 0;
       }
     }
@@ -1137,19 +1755,23 @@ timsort_merge_runs_hi(void* arr, size_t size,
 /**
  * @ingroup Timsort
  * @brief Gallop right to left to find slice of elements in source array greater
- * than target.
+ * than target (or not less than target, if ties is set).
  *
  * In order to find this slice, we need to find the number of elements in the
- * source array greater than the target. Given that the source array
+ * source array which belong after the target. Given that the source array
  * is sorted and ascending, it suffices to find where the target would be
  * located in the source array.
  *
  * To determine this location, we perform a pair of searches:
- * -# We first perform an exponential search to find the value k such that 
- *    base - ((2^(k) - 1) * size < target <= base - ((2^(k-1) - 1) * size).
- *    This condenses the range of values in which the target must lie.
+ * -# We first perform an exponential search, comparing the target with the
+ *    elements at offsets 1, 3, 7, ..., (2^k - 1) below base until one belongs
+ *    before the target. This condenses the range of values in which the
+ *    target must lie.
  * -# We then perform binary search using this range.
  *
+ * Merges stay stable as long as elements of the right run are galloped over
+ * with ties set, and elements of the left run without.
+ *
  * @note The slice is a memory offset corresponding to the total size of 
  * these elements.
  *
@@ -1157,9 +1779,10 @@ timsort_merge_runs_hi(void* arr, size_t size,
  * @param size Size of each element in array.
  * @param compare Function to compare elements.
  * @param base Initial offset to begin gallop.
- * @param limit Maximum offset for galloping (inclusive).
+ * @param limit Minimum offset for galloping (inclusive).
  * @param target Target element.
- * @return Total size of elements in souce array greater than target.
+ * @param ties Whether elements equal to target belong after it.
+ * @return Total size of elements in souce array after target.
  *
  * @see timsort()
  * @see timsort_merge_runs_hi()
@@ -1167,48 +1790,36 @@ timsort_merge_runs_hi(void* arr, size_t size,
 size_t 
 timsort_gallop_left(void* src, size_t size, 
                     int (*compare)(const void*, const void*), 
-                    size_t base, size_t limit, void* target) 
+                    size_t base, size_t limit, void* target, int ties) 
 {
   char* src_p = (char*) src;
+  // Element e belongs after target if compare(target, e) <= max_cmp.
+  const int max_cmp = ties ? 0 : -1;
+  const size_t nelems = (base - limit) / size + 1;
 
-  size_t slice = 0;
-  if (compare(target, src_p+(base)) < 0) {
-    size_t srch_lo = base;
-    size_t srch_hi = base;
-    // A power of 2 to use in exponential search.
-    size_t gallop_exp = 2; 
-    size_t gallop_ind;
-    while (1) {
-      srch_lo = base - ((gallop_exp - 1) * size);
-      // Only srch_lo needs to be checked, as srch_hi contains previous value
-      // of srch_lo which was valid.
-      if (srch_lo < limit || srch_lo > base) {
-        srch_lo = limit;
-        break;
-      }
-      // Note: Because we assign srch_lo to srch_hi if the comparison fails, we
-      // know compare(target, src_p+(srch_hi) <= 0 for the next search.
-      if (!(compare(target, src_p+(srch_lo)) > 0)) {
-        gallop_exp *= 2;
-        srch_hi = srch_lo;
-      } else {
-        break;
-      }
-    }
-    gallop_ind = bin_search_loc(src, size, compare, srch_lo, srch_hi, target);
-    slice = base - gallop_ind;
-    /*
-     * The bin_search_loc() function must return a non-negative offset. As
-     * such, the size of slice is at most array_size - size. However, when the 
-     * target is less than first value in the source array, the slice ought to
-     * include all elements in the array and therefore be equal to array_size.
-     * This conditional accounts for this.
-     */
-    if (compare(target, src_p+(gallop_ind)) < 0) {
-      slice += size;
+  if (compare(target, src_p+(base)) > max_cmp) {
+    return 0;
+  }
+  // Elements [0, after] below base belong after target, and those from
+  // before on don't.
+  size_t after = 0;
+  size_t before = 1;
+  while (before < nelems
+         && compare(target, src_p+(base - before * size)) <= max_cmp) {
+    after = before;
+    before = 2 * before + 1;
+  }
+  before = before < nelems ? before : nelems;
+  after++;
+  while (after < before) {
+    size_t mid = after + (before - after) / 2;
+    if (compare(target, src_p+(base - mid * size)) <= max_cmp) {
+      after = mid + 1;
+    } else {
+      before = mid;
     }
   }
-  return slice;
+  return after * size;
 }
 
 /**
@@ -1253,6 +1864,784 @@ timsort_minrun(size_t nelems)
   return nelems + pad;
 }
 
+/**
+ * @ingroup Timsort
+ * @enum SortStepPhase
+ * @brief Work a time-sliced Timsort resumes at.
+ */
+typedef enum SortStepPhase {
+  SORT_STEP_COUNT, ///< Counting run which starts at next.
+  SORT_STEP_REVERSE, ///< Reversing strictly descending run.
+  SORT_STEP_PAD, ///< Extending short run to minrun by binary insertion.
+  SORT_STEP_MERGE, ///< Merging runs, or choosing the next merge.
+  SORT_STEP_DONE ///< Array is sorted.
+} SortStepPhase;
+
+/**
+ * @ingroup Timsort
+ * @struct SortStepState
+ * @brief Struct to represent a Timsort which is run a slice at a time.
+ *
+ * All offsets are memory offsets into the array. During a merge, the shorter
+ * side is copied to tmp and merged back: from left to right if it is the left
+ * run (src and dest move up towards src_end), otherwise from right to left
+ * (src and dest move down towards src_end).
+ */
+struct SortStepState {
+  char* arr; ///< Array being sorted.
+  size_t nelems_size; ///< End of array.
+  size_t size; ///< Size of each element in array.
+  int (*compare)(const void*, const void*); ///< Function to compare elements.
+  size_t minrun_size; ///< Minimum run length.
+  TimsortMergeState ms; ///< Pending runs.
+  SortStepPhase phase; ///< Work to resume at.
+  size_t next; ///< Start of run being found (end of last pushed run).
+  size_t run_end; ///< End of run found so far.
+  int descending; ///< Whether run is strictly descending.
+  size_t rev_lo; ///< Next element to swap from the front of the run.
+  size_t rev_hi; ///< Next element to swap from the back of the run.
+  size_t pad_end; ///< End of run once padded to minrun.
+  int merge_at; ///< Left run of merge in progress, or -1.
+  int merge_hi; ///< Whether merge runs from right to left.
+  char* tmp; ///< Copy of shorter side of merge.
+  size_t tmp_cap; ///< Capacity of tmp.
+  size_t tmp_len; ///< Length of shorter side.
+  size_t copied; ///< Length of shorter side copied to tmp so far.
+  size_t tmp_pos; ///< Next element of tmp to merge (end of them, if hi).
+  size_t src; ///< Next element of longer side to merge (end, if hi).
+  size_t src_end; ///< Bound of longer side's elements to merge.
+  size_t dest; ///< Next slot to fill (end of them, if hi).
+};
+
+/**
+ * @ingroup Timsort
+ * @brief Start a Timsort which is run a slice at a time by sort_step().
+ *
+ * The array must not be modified, nor sorted by anything else, until
+ * sort_step() has returned 1 or the state has been freed. In between steps
+ * it is always a permutation of its original elements.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @return New sort state, to be freed with sort_step_free().
+ *
+ * @see sort_step()
+ */
+SortStepState*
+sort_step_init(void* arr, size_t nelems, size_t size, 
+               int (*compare)(const void*, const void*))
+{
+  SortStepState* state = calloc(1, sizeof(SortStepState));
+  const size_t minrun = nelems < 2 ? 1 : timsort_minrun(nelems);
+  const size_t max_runs = (nelems / minrun) + 1;
+  state->arr = (char*) arr;
+  state->nelems_size = nelems * size;
+  state->size = size;
+  state->compare = compare;
+  state->minrun_size = minrun * size;
+  state->ms.runs = calloc(max_runs, sizeof(TimsortRun));
+  state->ms.max_runs = max_runs;
+  state->ms.min_gallop = sort_tuning_get(size)->min_gallop;
+  state->phase = nelems < 2 ? SORT_STEP_DONE : SORT_STEP_COUNT;
+  state->merge_at = -1;
+  // Holds the element being inserted while padding, until a merge needs more.
+  state->tmp = malloc(size);
+  state->tmp_cap = size;
+  SORT_STATS_ADD(allocs, 3);
+  SORT_STATS_ADD(aux_bytes, sizeof(SortStepState) 
+                            + max_runs * sizeof(TimsortRun) + size);
+  return state;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Continue time-sliced Timsort for a bounded amount of work.
+ *
+ * Runs are found, padded and merged as in timsort(), with the same run
+ * invariants, but every phase can stop part-way and resume on the next call:
+ * runs are counted, reversed and padded an element at a time, and merges
+ * copy and merge a slice of elements at a time. This lets a single thread
+ * (an event loop, say) interleave a large sort with other work.
+ *
+ * Work is counted in comparisons, plus one per element copied or swapped in
+ * bulk. A step stops once budget is spent, except that the binary searches
+ * which pad a run or start a merge are not split, so it may overrun by
+ * about 2 * log2(nelems) comparisons.
+ *
+ * Merges do not gallop, so for highly structured input a time-sliced sort
+ * performs more comparisons than timsort().
+ *
+ * @param state Sort to continue.
+ * @param budget Work to do before returning.
+ * @return Returns 1 once the array is sorted, else 0.
+ *
+ * @see sort_step_init()
+ * @see timsort()
+ */
+int
+sort_step(SortStepState* state, size_t budget)
+{
+  // Wrap for this step only, as other sorts may run between steps.
+  int (*compare)(const void*, const void*) = state->compare;
+  SORT_STATS_WRAP(state->compare);
+  size_t spent = 0;
+  while (state->phase != SORT_STEP_DONE && spent < budget) {
+    switch (state->phase) {
+      case SORT_STEP_COUNT:
+        spent += sort_step_count(state, budget - spent);
+        break;
+      case SORT_STEP_REVERSE:
+        spent += sort_step_reverse(state, budget - spent);
+        break;
+      case SORT_STEP_PAD:
+        spent += sort_step_pad(state, budget - spent);
+        break;
+      default:
+        if (state->merge_at >= 0) {
+          spent += sort_step_merge(state, budget - spent);
+        } else {
+          int merge_at = sort_step_merge_at(state);
+          if (merge_at >= 0) {
+            spent += sort_step_merge_start(state, merge_at);
+          } else if (state->next == state->nelems_size) {
+            state->phase = SORT_STEP_DONE;
+          } else {
+            state->run_end = state->next;
+            state->phase = SORT_STEP_COUNT;
+          }
+        }
+        break;
+    }
+  }
+  state->compare = compare;
+  return state->phase == SORT_STEP_DONE;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Free time-sliced Timsort, whether or not it has finished.
+ *
+ * @param state Sort to free.
+ * @return Void.
+ */
+void
+sort_step_free(SortStepState** state)
+{
+  free((*state)->ms.runs);
+  free((*state)->tmp);
+  free(*state);
+  *state = NULL;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Count more of the run starting at next.
+ *
+ * As in timsort_count_run(), a run is strictly descending or non-descending.
+ * Once it ends, the sort moves on to reversing or padding it.
+ *
+ * @param state Sort in progress.
+ * @param budget Maximum number of comparisons.
+ * @return Comparisons performed.
+ */
+size_t
+sort_step_count(SortStepState* state, size_t budget)
+{
+  const char* arr_p = state->arr;
+  const size_t size = state->size;
+  size_t cost = 0;
+  if (state->run_end == state->next) {
+    state->run_end += size;
+    state->descending = 0;
+    if (state->run_end < state->nelems_size) {
+      state->descending = state->compare(arr_p+(state->next), 
+                                         arr_p+(state->run_end)) > 0;
+      state->run_end += size;
+      cost++;
+    }
+  }
+  while (state->run_end < state->nelems_size) {
+    if (cost == budget) {
+      return cost;
+    }
+    int cmp = state->compare(arr_p+(state->run_end - size), 
+                             arr_p+(state->run_end));
+    cost++;
+    if (state->descending ? cmp <= 0 : cmp > 0) {
+      break;
+    }
+    state->run_end += size;
+  }
+  state->pad_end = state->nelems_size - state->next > state->minrun_size 
+                   ? state->next + state->minrun_size 
+                   : state->nelems_size;
+  if (state->descending) {
+    state->rev_lo = state->next;
+    state->rev_hi = state->run_end - size;
+    state->phase = SORT_STEP_REVERSE;
+  } else {
+    state->phase = SORT_STEP_PAD;
+  }
+  return cost;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Reverse more of a strictly descending run.
+ *
+ * @param state Sort in progress.
+ * @param budget Maximum number of swaps.
+ * @return Swaps performed.
+ */
+size_t
+sort_step_reverse(SortStepState* state, size_t budget)
+{
+  size_t cost = 0;
+  while (state->rev_lo < state->rev_hi && cost < budget) {
+    swap(state->arr+(state->rev_lo), state->arr+(state->rev_hi), state->size);
+    state->rev_lo += state->size;
+    state->rev_hi -= state->size;
+    cost++;
+  }
+  if (state->rev_lo >= state->rev_hi) {
+    state->phase = SORT_STEP_PAD;
+  }
+  return cost;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Insert more elements into a run shorter than minrun.
+ *
+ * Once the run is minrun long (or reaches the end of the array), it is
+ * pushed onto the runs stack.
+ *
+ * @param state Sort in progress.
+ * @param budget Comparisons after which no further element is inserted.
+ * @return Comparisons performed.
+ */
+size_t
+sort_step_pad(SortStepState* state, size_t budget)
+{
+  char* arr_p = state->arr;
+  const size_t size = state->size;
+  size_t cost = 0;
+  while (state->run_end < state->pad_end && cost < budget) {
+    const size_t end = state->run_end;
+    size_t loc = sort_step_bound(arr_p, size, state->compare, state->next, 
+                                 end, arr_p+(end), 1, &cost);
+    if (loc < end) {
+      memcpy(state->tmp, arr_p+(end), size);
+      memmove(arr_p+(loc + size), arr_p+(loc), end - loc);
+      memcpy(arr_p+(loc), state->tmp, size);
+      SORT_STATS_ADD(bytes_moved, end - loc + 2 * size);
+    }
+    state->run_end += size;
+  }
+  if (state->run_end >= state->pad_end) {
+    TimsortMergeState* ms = &state->ms;
+    ms->runs[ms->nruns].start = state->next;
+    ms->runs[ms->nruns].len = state->run_end - state->next;
+    ms->nruns++;
+    SORT_STATS_ADD(runs, 1);
+    state->next = state->run_end;
+    state->phase = SORT_STEP_MERGE;
+  }
+  return cost;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Choose the next merge of pending runs.
+ *
+ * While runs are still being found, this is the merge which
+ * timsort_check_invariants() would perform next; once all have been found,
+ * the top two runs are merged, as in timsort_collapse_runs().
+ *
+ * @param state Sort in progress.
+ * @return Index of left run of merge, or -1 if no merge is due.
+ */
+int
+sort_step_merge_at(const SortStepState* state)
+{
+  const TimsortMergeState* ms = &state->ms;
+  if (ms->nruns < 2) {
+    return -1;
+  }
+  const int n = ms->nruns - 2;
+  if (state->next == state->nelems_size) {
+    return n;
+  }
+  if (n >= 1 
+      && (ms->runs[n - 1].len <= ms->runs[n].len + ms->runs[n + 1].len)) {
+    return ms->runs[n - 1].len < ms->runs[n + 1].len ? n - 1 : n;
+  } 
+  if (ms->runs[n].len <= ms->runs[n + 1].len) {
+    return n;
+  }
+  return -1;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Start merging run merge_at with the run after it.
+ *
+ * As in timsort_merge_runs(), elements of the left run not greater than the
+ * first of the right, and elements of the right run not less than the last
+ * of the left, are already in place and left out of the merge. The shorter of
+ * the remaining sides is the one copied to tmp.
+ *
+ * @param state Sort in progress.
+ * @param merge_at Left run of merge.
+ * @return Comparisons performed.
+ */
+size_t
+sort_step_merge_start(SortStepState* state, int merge_at)
+{
+  const char* arr_p = state->arr;
+  const size_t size = state->size;
+  const TimsortRun* right = &state->ms.runs[merge_at + 1];
+  const size_t left_start = state->ms.runs[merge_at].start;
+  const size_t right_end = right->start + right->len;
+  size_t cost = 0;
+  SORT_STATS_ADD(merges, 1);
+
+  size_t lo = sort_step_bound(arr_p, size, state->compare, left_start, 
+                              right->start, arr_p+(right->start), 1, &cost);
+  size_t hi = lo == right->start 
+              ? right->start 
+              : sort_step_bound(arr_p, size, state->compare, right->start, 
+                                right_end, arr_p+(right->start - size), 0, 
+                                &cost);
+
+  state->merge_at = merge_at;
+  state->merge_hi = hi - right->start < right->start - lo;
+  state->copied = 0;
+  if (state->merge_hi) {
+    state->tmp_len = hi - right->start;
+    state->tmp_pos = state->tmp_len;
+    state->src = right->start;
+    state->src_end = lo;
+    state->dest = hi;
+  } else {
+    state->tmp_len = right->start - lo;
+    state->tmp_pos = 0;
+    state->src = right->start;
+    state->src_end = hi;
+    state->dest = lo;
+  }
+  if (state->tmp_len > state->tmp_cap) {
+    free(state->tmp);
+    state->tmp = malloc(state->tmp_len);
+    SORT_STATS_ADD(allocs, 1);
+    SORT_STATS_ADD(aux_bytes, state->tmp_len - state->tmp_cap);
+    state->tmp_cap = state->tmp_len;
+  }
+  return cost;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Continue merge in progress.
+ *
+ * The shorter side is first copied to tmp, a slice at a time. It is then
+ * merged with the longer side one element at a time, taking from the left
+ * run on ties so that the merge is stable. Once either side runs out, what
+ * is left of tmp is copied back in slices, and the two runs become one.
+ *
+ * @param state Sort in progress.
+ * @param budget Maximum comparisons and elements copied.
+ * @return Work performed.
+ */
+size_t
+sort_step_merge(SortStepState* state, size_t budget)
+{
+  char* arr_p = state->arr;
+  char* tmp = state->tmp;
+  const size_t size = state->size;
+  size_t cost = 0;
+  size_t n;
+
+  const size_t base = state->merge_hi 
+                      ? state->dest - state->tmp_len 
+                      : state->dest;
+  while (state->copied < state->tmp_len) {
+    if (cost == budget) {
+      return cost;
+    }
+    n = state->tmp_len - state->copied;
+    if (n / size > budget - cost) {
+      n = (budget - cost) * size;
+    }
+    memcpy(tmp+(state->copied), arr_p+(base + state->copied), n);
+    state->copied += n;
+    cost += n / size;
+  }
+
+  if (!state->merge_hi) {
+    while (state->tmp_pos < state->tmp_len) {
+      if (cost == budget) {
+        return cost;
+      }
+      if (state->src == state->src_end) {
+        n = state->tmp_len - state->tmp_pos;
+        if (n / size > budget - cost) {
+          n = (budget - cost) * size;
+        }
+        memcpy(arr_p+(state->dest), tmp+(state->tmp_pos), n);
+        state->dest += n;
+        state->tmp_pos += n;
+        cost += n / size;
+      } else if (state->compare(arr_p+(state->src), 
+                                tmp+(state->tmp_pos)) < 0) {
+        memcpy(arr_p+(state->dest), arr_p+(state->src), size);
+        state->src += size;
+        state->dest += size;
+        cost++;
+      } else {
+        memcpy(arr_p+(state->dest), tmp+(state->tmp_pos), size);
+        state->tmp_pos += size;
+        state->dest += size;
+        cost++;
+      }
+    }
+  } else {
+    while (state->tmp_pos > 0) {
+      if (cost == budget) {
+        return cost;
+      }
+      if (state->src == state->src_end) {
+        n = state->tmp_pos;
+        if (n / size > budget - cost) {
+          n = (budget - cost) * size;
+        }
+        state->dest -= n;
+        state->tmp_pos -= n;
+        memcpy(arr_p+(state->dest), tmp+(state->tmp_pos), n);
+        cost += n / size;
+      } else if (state->compare(tmp+(state->tmp_pos - size), 
+                                arr_p+(state->src - size)) < 0) {
+        state->src -= size;
+        state->dest -= size;
+        memcpy(arr_p+(state->dest), arr_p+(state->src), size);
+        cost++;
+      } else {
+        state->tmp_pos -= size;
+        state->dest -= size;
+        memcpy(arr_p+(state->dest), tmp+(state->tmp_pos), size);
+        cost++;
+      }
+    }
+  }
+  SORT_STATS_ADD(bytes_moved, 2 * state->tmp_len);
+
+  TimsortMergeState* ms = &state->ms;
+  const int m = state->merge_at;
+  ms->runs[m].len += ms->runs[m + 1].len;
+  memmove(&ms->runs[m + 1], &ms->runs[m + 2], 
+          (ms->nruns - m - 2) * sizeof(TimsortRun));
+  ms->nruns--;
+  state->merge_at = -1;
+  return cost;
+}
+
+/**
+ * @ingroup Timsort
+ * @brief Find first element of sorted subarray after target (or, if not
+ * upper, not before target) using binary search.
+ *
+ * @param arr Array containing the subarray.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @param lo Lower bound of subarray (inclusive).
+ * @param hi Upper bound of subarray (exclusive).
+ * @param target Element to search for.
+ * @param upper Whether elements equal to target are skipped.
+ * @param cost Incremented once per comparison.
+ * @return Memory offset of element found, or hi if there is none.
+ */
+size_t
+sort_step_bound(const char* arr, size_t size, 
+                int (*compare)(const void*, const void*), 
+                size_t lo, size_t hi, const void* target, int upper, 
+                size_t* cost)
+{
+  while (lo < hi) {
+    size_t mid = lo + ((hi - lo) / size / 2) * size;
+    int cmp = compare(arr+(mid), target);
+    (*cost)++;
+    if (upper ? cmp <= 0 : cmp < 0) {
+      lo = mid + size;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/**
+ * @ingroup Tuning
+ * @brief Find size class of elements of given size.
+ *
+ * Classes are powers of two: class k holds sizes in (2^(k-1), 2^k], and the
+ * last class holds all sizes above 64 bytes.
+ *
+ * @param size Size of each element.
+ * @return Size class in [0, SORT_TUNING_NCLASSES).
+ */
+size_t
+sort_tuning_class(size_t size)
+{
+  size_t size_class = 0;
+  while (size_class < SORT_TUNING_NCLASSES - 1
+         && ((size_t)1 << size_class) < size) {
+    size_class++;
+  }
+  return size_class;
+}
+
+/**
+ * @ingroup Tuning
+ * @brief Get tuning used for elements of given size.
+ *
+ * @param size Size of each element.
+ * @return Tuning of the size class of the elements.
+ */
+const SortTuning*
+sort_tuning_get(size_t size)
+{
+  return &sort_tunings[sort_tuning_class(size)];
+}
+
+/**
+ * @ingroup Tuning
+ * @brief Replace tuning of size class at runtime.
+ *
+ * Values are clamped so that every sort remains correct: thresholds are at
+ * least 1 (Timsort's at least 2) and comb sort's shrink factor is above 1.
+ *
+ * @param size_class Size class to tune (see sort_tuning_class()).
+ * @param tuning New tuning.
+ * @return Void.
+ */
+void
+sort_tuning_set(size_t size_class, const SortTuning* tuning)
+{
+  if (size_class >= SORT_TUNING_NCLASSES) {
+    return;
+  }
+  SortTuning* t = &sort_tunings[size_class];
+  *t = *tuning;
+  t->length_threshold = t->length_threshold < 1 ? 1 : t->length_threshold;
+  t->min_gallop = t->min_gallop < 1 ? 1 : t->min_gallop;
+  t->timsort_min_nelems = t->timsort_min_nelems < 2
+                          ? 2 : t->timsort_min_nelems;
+  t->comb_shrink = t->comb_shrink <= 1.05 ? 1.05 : t->comb_shrink;
+}
+
+/**
+ * @ingroup Precheck
+ * @brief Enable or disable pre-check of every sort for sorted input.
+ *
+ * When enabled, each top-level sort first scans its input. Input which is
+ * already sorted is returned unchanged after nelems - 1 comparisons, and
+ * input which is strictly descending is reversed in place. Scans of other
+ * inputs stop at the first pair which rules out both, so that unsorted
+ * input usually costs only a few extra comparisons.
+ *
+ * Disabled by default.
+ *
+ * @param enabled 1 to enable, 0 to disable.
+ * @return Void.
+ *
+ * @see is_sorted()
+ */
+void
+sort_precheck_set(int enabled)
+{
+  sort_precheck_enabled = enabled != 0;
+}
+
+/**
+ * @ingroup Precheck
+ * @brief Check whether sorts pre-check for sorted input.
+ *
+ * @return Returns 1 if enabled else 0.
+ */
+int
+sort_precheck_get()
+{
+  return sort_precheck_enabled;
+}
+
+/**
+ * @ingroup Precheck
+ * @brief Put array in sorted order if it is sorted or strictly descending.
+ *
+ * Both directions are checked by a single pass, whose direction is fixed by
+ * the first pair. Only strictly descending arrays are reversed, so that
+ * equal elements keep their order.
+ *
+ * @param arr Array to check.
+ * @param nelems Number of elements in array.
+ * @param size Size of each element in array.
+ * @param compare Function to compare elements.
+ * @return Returns 1 if array is now sorted else 0 (array unchanged).
+ */
+int
+sort_precheck(void* arr, size_t nelems, size_t size,
+              int (*compare)(const void*, const void*))
+{
+  if (nelems < 2) {
+    return 1;
+  }
+  int descending;
+  if (timsort_count_run(arr, nelems, size, compare, &descending) < nelems) {
+    return 0;
+  }
+  if (descending) {
+    reverse_array(arr, 0, (nelems - 1) * size, size);
+  }
+  return 1;
+}
+
+/**
+ * @ingroup SortControl
+ * @brief Sort generic array using quicksort, unless stopped by control.
+ *
+ * Before partitioning at least SORT_CONTROL_NELEMS elements, the sort polls
+ * control, and once it fires no further partition is started. Whatever the
+ * outcome, the array is a permutation of its input.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param control Conditions to stop at (NULL: none).
+ * @return SORT_OK if sorted, else why the sort stopped.
+ *
+ * @see quick_sort()
+ */
+SortStatus
+quick_sort_ctl(void* arr, size_t nelems, size_t size, 
+               int (*compare)(const void*, const void*), 
+               const SortControl* control)
+{
+  return sort_control_run(quick_sort, arr, nelems, size, compare, control);
+}
+
+/**
+ * @ingroup SortControl
+ * @brief Sort generic array using merge sort, unless stopped by control.
+ *
+ * Before splitting or merging at least SORT_CONTROL_NELEMS elements, the sort
+ * polls control, and once it fires every pending merge is skipped. Whatever
+ * the outcome, the array is a permutation of its input.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param control Conditions to stop at (NULL: none).
+ * @return SORT_OK if sorted, else why the sort stopped.
+ *
+ * @see merge_sort()
+ */
+SortStatus
+merge_sort_ctl(void* arr, size_t nelems, size_t size, 
+               int (*compare)(const void*, const void*), 
+               const SortControl* control)
+{
+  return sort_control_run(merge_sort, arr, nelems, size, compare, control);
+}
+
+/**
+ * @ingroup SortControl
+ * @brief Sort generic array using Timsort, unless stopped by control.
+ *
+ * Before each merge of at least SORT_CONTROL_NELEMS elements, the sort polls
+ * control, and once it fires no further run is found or merged. Whatever the
+ * outcome, the array is a permutation of its input.
+ *
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param control Conditions to stop at (NULL: none).
+ * @return SORT_OK if sorted, else why the sort stopped.
+ *
+ * @see timsort()
+ */
+SortStatus
+timsort_ctl(void* arr, size_t nelems, size_t size, 
+            int (*compare)(const void*, const void*), 
+            const SortControl* control)
+{
+  return sort_control_run(timsort, arr, nelems, size, compare, control);
+}
+
+/**
+ * @ingroup SortControl
+ * @brief Run sort with control installed for this thread.
+ *
+ * A control which has already fired stops the sort before it touches the
+ * array. The previous control, if any, is restored afterwards, so controlled
+ * sorts may nest (e.g. within a comparison function).
+ *
+ * @param sort Sort to run.
+ * @param arr Array to be sorted.
+ * @param nelems Number of elements in the array.
+ * @param size Size of each element in the array.
+ * @param compare Function to be used to compare elements.
+ * @param control Conditions to stop at (NULL: none).
+ * @return SORT_OK if sorted, else why the sort stopped.
+ */
+SortStatus
+sort_control_run(void (*sort)(void*, size_t, size_t, 
+                              int (*compare)(const void*, const void*)), 
+                 void* arr, size_t nelems, size_t size, 
+                 int (*compare)(const void*, const void*), 
+                 const SortControl* control)
+{
+  const SortControl* outer = sort_control;
+  const SortStatus outer_status = sort_control_status;
+  sort_control = control;
+  sort_control_status = control != NULL ? sort_control_poll(control) 
+                                        : SORT_OK;
+  if (sort_control_status == SORT_OK) {
+    sort(arr, nelems, size, compare);
+  }
+  const SortStatus status = sort_control_status;
+  sort_control = outer;
+  sort_control_status = outer_status;
+  return status;
+}
+
+/**
+ * @ingroup SortControl
+ * @brief Check whether the controlled sort on this thread should stop.
+ *
+ * Polling reads an atomic flag and possibly the clock, so the control is
+ * only polled for work of at least SORT_CONTROL_NELEMS elements. Otherwise
+ * only whether the sort has already stopped is checked.
+ *
+ * @param nelems Number of elements about to be merged or partitioned.
+ * @return Returns 1 if sort should stop, else 0.
+ */
+int
+sort_control_stop(size_t nelems)
+{
+  if (sort_control == NULL) {
+    return 0;
+  }
+  if (sort_control_status == SORT_OK && nelems >= SORT_CONTROL_NELEMS) {
+    sort_control_status = sort_control_poll(sort_control);
+  }
+  return sort_control_status != SORT_OK;
+}
+
 /**
  * @ingroup SortingHelper
  * @brief Swap the values referenced by two pointers.
@@ -1270,13 +2659,17 @@ void
 swap(void* a, void* b, size_t size)
 {
   enum { SWAP_THRESHOLD = 8 };
+  SORT_STATS_ADD(swaps, 1);
+  SORT_STATS_ADD(bytes_moved, 3 * size);
   if (size <= SWAP_THRESHOLD) {
     char tmp[size];
     memcpy(tmp, a, size);
     memcpy(a, b, size);
     memcpy(b, tmp, size);
   } else {
-    void* tmp = malloc(sizeof(size));
+    void* tmp = malloc(size);
+    SORT_STATS_ADD(allocs, 1);
+    SORT_STATS_ADD(aux_bytes, size);
     memcpy(tmp, a, size);
     memcpy(a, b, size);
     memcpy(b, tmp, size);
@@ -1349,72 +2742,3 @@ reverse_array(void* arr, size_t start, size_t end, size_t size)
   }
 }
 
-/**
- * @ingroup SortingHelper
- * @brief Find location of target value in array using binary search.
- *
- * To account for duplicate values, the function performs a final linear search
- * once a location has been found until it finds the final duplicate.
- *
- * @note Location is given as a a memory offset. 
- *
- * @note In the case that the target element is not actually located in the 
- * array, the search returns where the target element would be located were it
- * in the array.
- *
- * @todo Use second binary search instead of linear search to find either first
- * or last instance of duplicate.
- *
- * @param arr Array to be searched.
- * @param size Size of each element in array.
- * @param compare Function to compare elements.
- * @param lo Lower bound for search (inclusive).
- * @param hi Upper bound for search (inclusive).
- * @param target Element to search for.
- * @return Location where element belongs in the array.
- */
-size_t
-bin_search_loc(void* arr, size_t size, 
-                int (*compare)(const void*, const void*),
-                size_t lo, size_t hi, void* target)
-{
-  char* arr_p = (char*) arr;
-  size_t l = lo;
-  size_t m = 0;
-  size_t r = hi;
-  int cmp;
-
-  while (1) {
-    if (r > hi || r <= l) {
-      cmp = compare(target, arr_p+(l));
-      if (cmp == 0) {
-        return l;
-      } else if (cmp < 0) {
-        do {
-          l -= size;
-        } while ((l <= hi && l >= lo) && compare(target, arr_p+(l)) < 0);
-        return (l >= hi || l < lo) ? lo : l + size;
-      } else {
-        do {
-          l += size;
-        } while (l <= hi && compare(target, arr_p+(l)) > 0);
-        return l > hi ? hi : l;
-      }
-    }
-    // Note that value in parantheses is truncated before being multiplied by
-    // size.
-    m = ((r + l) / 2 / size) * size;
-    cmp = compare(target, arr_p+(m));
-    if (cmp > 0) {
-      l = m + size;
-    } else if (cmp < 0) {
-      r = m - size;
-    } else {
-      do {
-        m += size;
-      } while (m <= hi && compare(target, arr_p+(m)) == 0);
-      return m > hi ? hi : m;
-    }
-  }
-}
-
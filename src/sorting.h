@@ -7,6 +7,7 @@
 
 #include <string.h>
 #include "stack.h"
+#include "sort_control.h"
 
 /** 
  * @def LENGTH_THRESHOLD
@@ -17,9 +18,47 @@
  * @def MIN_GALLOP
  * @brief Default minimum galloping threshold for Timsort. */
 #define MIN_GALLOP 7
+/** 
+ * @def TIMSORT_MIN_NELEMS
+ * @brief Default minimum array length at which Timsort stops deferring to
+ * binary insertion sort. */
+#define TIMSORT_MIN_NELEMS 64
+/** 
+ * @def COMB_SHRINK
+ * @brief Default factor by which comb sort shrinks its gap. */
+#define COMB_SHRINK 1.3
+/** 
+ * @def QUICK_SORT_STACK_DEPTH
+ * @brief Capacity of quick_sort_iterative()'s range stack. As the larger
+ * partition is always the one pushed, log2(SIZE_MAX) ranges always suffice. */
+#define QUICK_SORT_STACK_DEPTH (sizeof(size_t) * 8)
+/** 
+ * @def MERGE_SORT_TILE_BYTES
+ * @brief Bytes in each tile which merge_sort_tiled() sorts in cache before
+ * merging tiles. A tile and its share of the auxillary array should fit in
+ * L2. */
+#define MERGE_SORT_TILE_BYTES (64 * 1024)
+/** 
+ * @def SORT_TUNING_NCLASSES
+ * @brief Number of element size classes (1, 2, 4, ..., 64, >64 bytes) with
+ * their own tuning. */
+#define SORT_TUNING_NCLASSES 8
+
+/**
+ * @ingroup Tuning
+ * @struct SortTuning
+ * @brief Struct to represent tunable thresholds for one element size class.
+ */
+typedef struct SortTuning {
+  size_t length_threshold; ///< Replaces LENGTH_THRESHOLD.
+  int min_gallop; ///< Replaces MIN_GALLOP.
+  size_t timsort_min_nelems; ///< Replaces TIMSORT_MIN_NELEMS.
+  double comb_shrink; ///< Replaces COMB_SHRINK.
+} SortTuning;
 
 typedef struct TimsortRun TimsortRun;
 typedef struct TimsortMergeState TimsortMergeState;
+typedef struct SortStepState SortStepState;
 
 //##############################################################################
 //# SIMPLE SORTS
@@ -64,6 +103,26 @@ static void merge_sort_merge(void* arr, void* aux, size_t size,
                              int (*compare)(const void*, const void*), 
                              size_t lo, size_t mid, size_t hi);
 
+void merge_sort_iterative(void* arr, size_t nelems, size_t size, 
+                          int (*compare)(const void*, const void*));
+
+void merge_sort_tiled(void* arr, size_t nelems, size_t size, 
+                      int (*compare)(const void*, const void*));
+
+static void merge_sort_tiled_tile(void* arr, void* aux, int into_aux, 
+                                  size_t size, 
+                                  int (*compare)(const void*, const void*), 
+                                  size_t lo, size_t hi, size_t block);
+
+static void merge_sort_merge4(const void* src, void* dst, size_t size, 
+                              int (*compare)(const void*, const void*), 
+                              const size_t bounds[5]);
+
+static int merge_sort_merge4_pick(const char* src, 
+                                  int (*compare)(const void*, const void*), 
+                                  const size_t pos[4], const size_t end[4], 
+                                  int a, int b);
+
 
 void quick_sort(void* arr, size_t nelems, size_t size, 
                 int (*compare)(const void*, const void*));
@@ -76,6 +135,16 @@ static size_t quick_sort_partition(void* arr, size_t size,
                                    int (*compare)(const void*, const void*), 
                                    size_t lo, size_t hi);
 
+void quick_sort_iterative(void* arr, size_t nelems, size_t size, 
+                          int (*compare)(const void*, const void*));
+
+void quick_sort_3way(void* arr, size_t nelems, size_t size, 
+                     int (*compare)(const void*, const void*));
+
+static void quick_sort_3way_recursive(void* arr, size_t size, 
+                                      int (*compare)(const void*, const void*), 
+                                      size_t lo, size_t hi);
+
 //##############################################################################
 //# HYBRID SORTS
 //##############################################################################
@@ -89,6 +158,10 @@ static void timsort_find_runs(void* arr, size_t nelems, size_t size,
                               int (*compare)(const void*, const void*), 
                               size_t minrun, TimsortMergeState* merge_state);
 
+size_t timsort_count_run(const void* arr, size_t nelems, size_t size, 
+                         int (*compare)(const void*, const void*), 
+                         int* descending);
+
 static void timsort_merge_runs(void* arr, size_t size, 
                                int (*compare)(const void*, const void*), 
                                TimsortRun* a, TimsortRun* b, 
@@ -108,11 +181,13 @@ static void timsort_merge_runs_hi(void* arr, size_t size,
 
 static size_t timsort_gallop_right(void* src, size_t size, 
                                    int (*compare)(const void*, const void*), 
-                                   size_t base, size_t limit, void* target);
+                                   size_t base, size_t limit, void* target,
+                                   int ties);
 
 static size_t timsort_gallop_left(void* src, size_t size, 
                                   int (*compare)(const void*, const void*), 
-                                  size_t base, size_t limit, void* target);
+                                  size_t base, size_t limit, void* target,
+                                  int ties);
 
 static void timsort_check_invariants(void* arr, size_t size, 
                                      int (*compare)(const void*, const void*), 
@@ -122,6 +197,79 @@ static void timsort_collapse_runs(void* arr, size_t size,
                                   int (*compare)(const void*, const void*), 
                                   TimsortMergeState* merge_state);
 
+//##############################################################################
+//# TIME-SLICED SORTS
+//##############################################################################
+
+SortStepState* sort_step_init(void* arr, size_t nelems, size_t size, 
+                              int (*compare)(const void*, const void*));
+
+int sort_step(SortStepState* state, size_t budget);
+
+void sort_step_free(SortStepState** state);
+
+static size_t sort_step_count(SortStepState* state, size_t budget);
+
+static size_t sort_step_reverse(SortStepState* state, size_t budget);
+
+static size_t sort_step_pad(SortStepState* state, size_t budget);
+
+static size_t sort_step_merge_start(SortStepState* state, int merge_at);
+
+static size_t sort_step_merge(SortStepState* state, size_t budget);
+
+static int sort_step_merge_at(const SortStepState* state);
+
+static size_t sort_step_bound(const char* arr, size_t size, 
+                              int (*compare)(const void*, const void*), 
+                              size_t lo, size_t hi, const void* target, 
+                              int upper, size_t* cost);
+
+//##############################################################################
+//# TUNING
+//##############################################################################
+
+size_t sort_tuning_class(size_t size);
+
+const SortTuning* sort_tuning_get(size_t size);
+
+void sort_tuning_set(size_t size_class, const SortTuning* tuning);
+
+//##############################################################################
+//# PRECHECK
+//##############################################################################
+
+void sort_precheck_set(int enabled);
+
+int sort_precheck_get();
+
+static int sort_precheck(void* arr, size_t nelems, size_t size, 
+                         int (*compare)(const void*, const void*));
+
+//##############################################################################
+//# CONTROLLED SORTS
+//##############################################################################
+
+SortStatus quick_sort_ctl(void* arr, size_t nelems, size_t size, 
+                          int (*compare)(const void*, const void*), 
+                          const SortControl* control);
+
+SortStatus merge_sort_ctl(void* arr, size_t nelems, size_t size, 
+                          int (*compare)(const void*, const void*), 
+                          const SortControl* control);
+
+SortStatus timsort_ctl(void* arr, size_t nelems, size_t size, 
+                       int (*compare)(const void*, const void*), 
+                       const SortControl* control);
+
+static SortStatus sort_control_run(
+    void (*sort)(void*, size_t, size_t, 
+                 int (*compare)(const void*, const void*)), 
+    void* arr, size_t nelems, size_t size, 
+    int (*compare)(const void*, const void*), const SortControl* control);
+
+static int sort_control_stop(size_t nelems);
+
 //##############################################################################
 //# HELPERS
 //##############################################################################
@@ -133,8 +281,4 @@ static size_t median_three(void* arr, size_t size, size_t a, size_t b, size_t c,
 
 static void reverse_array(void* arr, size_t start, size_t end, size_t size);
 
-static size_t bin_search_loc(void* arr, size_t size, 
-                             int (*compare)(const void*, const void*),
-                             size_t lo, size_t hi, void* target);
-
 #endif /* MY_SORTING_ALGORITHMS_ */
@@ -6,6 +6,9 @@
 #include "stack.h"
 #include "doxygen.h"
 
+static StackFrame* stack_frame_take(Stack* stack);
+static void stack_chunk_add(Stack* stack, size_t nframes);
+
 /**
  * @addtogroup Stack
  * @{
@@ -19,6 +22,9 @@
 /**
  * @brief Initialize new stack frame.
  *
+ * @note Stacks do not use this function; their frames come from a pool owned
+ * by the stack (see stack_push()).
+ *
  * @param data Data to be stored in frame.
  * @return New stack frame.
  */
@@ -56,11 +62,37 @@ stack_init()
   Stack* stack = malloc(sizeof(Stack));
   stack->head = NULL;
   stack->len = 0;
+  stack->free_frames = NULL;
+  stack->chunks = NULL;
+  stack->chunk_used = 0;
+  stack->capacity = 0;
   return stack;
 }
+/**
+ * @brief Ensure that stack can grow by nframes without allocating.
+ *
+ * @param stack Stack to reserve frames for.
+ * @param nframes Number of further pushes which must not allocate.
+ * @return Void.
+ */
+void
+stack_reserve(Stack* stack, size_t nframes)
+{
+  size_t available = stack->capacity - stack->len;
+  if (available < nframes) {
+    stack_chunk_add(stack, nframes - available);
+  }
+}
 /**
  * @brief Push data onto stack.
  *
+ * Frames are taken from the stack's pool: first from frames released by
+ * earlier pops, then from the most recent chunk of frames. Only when both
+ * are exhausted is a new chunk allocated, as large as all previous chunks
+ * combined (up to STACK_CHUNK_MAX_FRAMES), so that capacity doubles. Pushes
+ * are therefore amortized O(1) and, once the stack has reached its peak
+ * length, never allocate.
+ *
  * @param stack Stack to push data onto.
  * @param data Data to be pushed.
  * @return Void.
@@ -68,13 +100,10 @@ stack_init()
 void
 stack_push(Stack* stack, void* data)
 {
-  if (stack->len == 0) {
-    stack->head = stack_frame_init(data);
-  } else {
-    StackFrame* next = stack_frame_init(data);
-    next->next = stack->head;
-    stack->head = next;
-  }
+  StackFrame* frame = stack_frame_take(stack);
+  frame->data = data;
+  frame->next = stack->head;
+  stack->head = frame;
   stack->len++;
 }
 /**
@@ -91,6 +120,8 @@ stack_peek(Stack* stack)
 /**
  * @brief Remove topmost value from stack wihout returning it.
  *
+ * The frame is returned to the stack's pool rather than freed.
+ *
  * @param stack Stack to pop from.
  * @return Returns 0 if unable to pop else 1.
  */
@@ -101,8 +132,9 @@ stack_pop(Stack* stack)
     return 0;
   } else {
     StackFrame* old_head = stack->head;
-    stack->head = stack->head->next;
-    stack_frame_free(&old_head);
+    stack->head = old_head->next;
+    old_head->next = stack->free_frames;
+    stack->free_frames = old_head;
     stack->len--;
     return 1;
   }
@@ -119,11 +151,8 @@ stack_pop_return(Stack* stack)
   if (stack->len == 0) {
     return NULL;
   } else {
-    StackFrame* old_head = stack->head;
     void* old_data = stack_peek(stack);
-    stack->head = stack->head->next;
-    stack_frame_free(&old_head);
-    stack->len--;
+    stack_pop(stack);
     return old_data;
   }
 }
@@ -139,12 +168,66 @@ stack_pop_return(Stack* stack)
 void
 stack_free(Stack** stack)
 {
-  while (stack_pop(*stack) != 0) {
-    continue;
+  StackChunk* chunk = (*stack)->chunks;
+  while (chunk != NULL) {
+    StackChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
   }
   free(*stack);
   *stack = NULL;
 }
 
-/** @} */
+/**
+ * @brief Take unused frame from stack's pool, growing pool if needed.
+ *
+ * @param stack Stack owning pool.
+ * @return Unused frame.
+ */
+StackFrame*
+stack_frame_take(Stack* stack)
+{
+  if (stack->free_frames != NULL) {
+    StackFrame* frame = stack->free_frames;
+    stack->free_frames = frame->next;
+    return frame;
+  }
+  if (stack->chunks == NULL || stack->chunk_used == stack->chunks->nframes) {
+    size_t nframes = stack->capacity < STACK_CHUNK_MIN_FRAMES
+                     ? STACK_CHUNK_MIN_FRAMES : stack->capacity;
+    stack_chunk_add(stack, nframes < STACK_CHUNK_MAX_FRAMES
+                           ? nframes : STACK_CHUNK_MAX_FRAMES);
+  }
+  return &stack->chunks->frames[stack->chunk_used++];
+}
 
+/**
+ * @brief Allocate new chunk of frames for stack's pool.
+ *
+ * Frames of the previous chunk which were never handed out are moved to the
+ * free list, so that they are not lost.
+ *
+ * @param stack Stack owning pool.
+ * @param nframes Number of frames in new chunk.
+ * @return Void.
+ */
+void
+stack_chunk_add(Stack* stack, size_t nframes)
+{
+  if (stack->chunks != NULL) {
+    while (stack->chunk_used < stack->chunks->nframes) {
+      StackFrame* frame = &stack->chunks->frames[stack->chunk_used++];
+      frame->next = stack->free_frames;
+      stack->free_frames = frame;
+    }
+  }
+  StackChunk* chunk = malloc(sizeof(StackChunk)
+                             + nframes * sizeof(StackFrame));
+  chunk->next = stack->chunks;
+  chunk->nframes = nframes;
+  stack->chunks = chunk;
+  stack->chunk_used = 0;
+  stack->capacity += nframes;
+}
+
+/** @} */
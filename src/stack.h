@@ -7,6 +7,15 @@
 
 #include <stdlib.h>
 
+/**
+ * @def STACK_CHUNK_MIN_FRAMES
+ * @brief Number of frames in the first chunk allocated by a stack. */
+#define STACK_CHUNK_MIN_FRAMES 16
+/**
+ * @def STACK_CHUNK_MAX_FRAMES
+ * @brief Maximum number of frames in any chunk allocated by a stack. */
+#define STACK_CHUNK_MAX_FRAMES 65536
+
 /**
  * @ingroup StackFrame
  * @struct StackFrame
@@ -17,6 +26,17 @@ typedef struct StackFrame {
   struct StackFrame* next; ///< Next frame in stack.
 } StackFrame;
 
+/**
+ * @ingroup Stack
+ * @struct StackChunk
+ * @brief Struct to represent a contiguous block of frames owned by a stack.
+ */
+typedef struct StackChunk {
+  struct StackChunk* next; ///< Previously allocated chunk.
+  size_t nframes; ///< Total number of frames in chunk.
+  StackFrame frames[]; ///< Frames of chunk.
+} StackChunk;
+
 /**
  * @ingroup Stack
  * @struct Stack
@@ -25,6 +45,10 @@ typedef struct StackFrame {
 typedef struct Stack {
   StackFrame* head; ///< Top frame in stack.
   size_t len; ///< Total number of frames in stack.
+  StackFrame* free_frames; ///< Popped frames, available for reuse.
+  StackChunk* chunks; ///< Most recently allocated chunk of frames.
+  size_t chunk_used; ///< Frames handed out from most recent chunk.
+  size_t capacity; ///< Total number of frames in all chunks.
 } Stack;
 
 //##############################################################################
@@ -39,6 +63,7 @@ void stack_frame_free(StackFrame** frame);
 //##############################################################################
 
 Stack* stack_init();
+void stack_reserve(Stack* stack, size_t nframes);
 void stack_push(Stack* stack, void* data);
 void* stack_peek(Stack* stack);
 int stack_pop(Stack* stack);
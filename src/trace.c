@@ -0,0 +1,250 @@
+/**
+ * @file
+ * @brief Phase tracing implementation.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trace.h"
+#include "doxygen.h"
+
+/**
+ * @ingroup Trace
+ * @brief Ring buffer of calling thread (NULL until first event).
+ */
+static __thread TraceBuffer* trace_local = NULL;
+
+/**
+ * @ingroup Trace
+ * @brief List of all registered ring buffers.
+ */
+static TraceBuffer* trace_buffers = NULL;
+
+/**
+ * @ingroup Trace
+ * @brief Next thread id to hand out.
+ */
+static int trace_next_tid = 0;
+
+/**
+ * @ingroup Trace
+ * @brief Key whose destructor releases the buffer of an exiting thread.
+ */
+static pthread_key_t trace_key;
+
+/**
+ * @ingroup Trace
+ * @brief Guard for creating trace_key once.
+ */
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+
+static TraceBuffer* trace_buffer();
+static void trace_key_init();
+static void trace_release(void* buf);
+
+/**
+ * @addtogroup Trace
+ * @{
+ */
+
+/**
+ * @brief Record event into ring buffer of calling thread.
+ *
+ * Usually called through the TRACE_* macros, so that it is compiled out of
+ * normal builds.
+ *
+ * @param name Name of event (must outlive trace_dump(), e.g. literal).
+ * @param phase Chrome event phase ('B', 'E' or 'i').
+ * @param arg0_name Name of first argument (NULL: unused).
+ * @param arg0 Value of first argument.
+ * @param arg1_name Name of second argument (NULL: unused).
+ * @param arg1 Value of second argument.
+ * @return Void.
+ */
+void
+trace_event(const char* name, char phase,
+            const char* arg0_name, uint64_t arg0,
+            const char* arg1_name, uint64_t arg1)
+{
+  TraceBuffer* buf = trace_buffer();
+  if (buf == NULL) {
+    return;
+  }
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  TraceEvent* ev = &buf->events[buf->nevents % TRACE_RING_CAPACITY];
+  ev->name = name;
+  ev->phase = phase;
+  ev->ts = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  ev->arg_names[0] = arg0_name;
+  ev->arg_names[1] = arg1_name;
+  ev->args[0] = arg0;
+  ev->args[1] = arg1;
+  __atomic_store_n(&buf->nevents, buf->nevents + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Name calling thread in trace output (e.g. "worker 3").
+ *
+ * @param name Name of thread (must outlive trace_dump(), e.g. literal).
+ * @return Void.
+ */
+void
+trace_thread_name(const char* name)
+{
+  TraceBuffer* buf = trace_buffer();
+  if (buf != NULL) {
+    buf->thread_name = name;
+  }
+}
+
+/**
+ * @brief Write events of all threads to file as Chrome trace_event JSON.
+ *
+ * @note Threads should not be recording events during the dump.
+ *
+ * @param path Path of file to create (or truncate).
+ * @return Returns 0 if unable to write file else 1.
+ */
+int
+trace_dump(const char* path)
+{
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    return 0;
+  }
+  int first = 1;
+  fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  TraceBuffer* buf = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+  for (; buf != NULL; buf = buf->next) {
+    uint64_t end = __atomic_load_n(&buf->nevents, __ATOMIC_ACQUIRE);
+    uint64_t begin = end > TRACE_RING_CAPACITY ? end - TRACE_RING_CAPACITY : 0;
+    if (buf->thread_name != NULL) {
+      fprintf(file, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+                    "\"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+              first ? "" : ",", buf->tid, buf->thread_name);
+      first = 0;
+    }
+    for (uint64_t i = begin; i < end; i++) {
+      const TraceEvent* ev = &buf->events[i % TRACE_RING_CAPACITY];
+      fprintf(file, "%s\n{\"name\": \"%s\", \"ph\": \"%c\", "
+                    "\"ts\": %.3f, \"pid\": 1, \"tid\": %d",
+              first ? "" : ",", ev->name, ev->phase, ev->ts / 1000.0,
+              buf->tid);
+      if (ev->phase == 'i') {
+        fprintf(file, ", \"s\": \"t\"");
+      }
+      if (ev->arg_names[0] != NULL) {
+        fprintf(file, ", \"args\": {\"%s\": %llu", ev->arg_names[0],
+                (unsigned long long) ev->args[0]);
+        if (ev->arg_names[1] != NULL) {
+          fprintf(file, ", \"%s\": %llu", ev->arg_names[1],
+                  (unsigned long long) ev->args[1]);
+        }
+        fprintf(file, "}");
+      }
+      fprintf(file, "}");
+      first = 0;
+    }
+  }
+  fprintf(file, "\n]}\n");
+  return fclose(file) == 0;
+}
+
+/**
+ * @brief Discard all recorded events.
+ *
+ * @note Threads should not be recording events during the reset.
+ *
+ * @return Void.
+ */
+void
+trace_reset()
+{
+  TraceBuffer* buf = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+  for (; buf != NULL; buf = buf->next) {
+    __atomic_store_n(&buf->nevents, 0, __ATOMIC_RELEASE);
+  }
+}
+
+/**
+ * @brief Get ring buffer of calling thread, claiming one on first use.
+ *
+ * Buffers are pushed onto a lock-free list and never freed, so that events
+ * of threads which have exited can still be dumped. A buffer released by an
+ * exited thread (see trace_release()) is claimed before a new one is
+ * allocated. The new thread keeps appending to it under the same tid, after
+ * the events of the previous owner, which remain until overwritten.
+ *
+ * @return Ring buffer of calling thread, or NULL if allocation failed.
+ */
+TraceBuffer*
+trace_buffer()
+{
+  if (trace_local != NULL) {
+    return trace_local;
+  }
+  pthread_once(&trace_key_once, trace_key_init);
+  TraceBuffer* buf = __atomic_load_n(&trace_buffers, __ATOMIC_ACQUIRE);
+  for (; buf != NULL; buf = buf->next) {
+    int in_use = 0;
+    if (__atomic_compare_exchange_n(&buf->in_use, &in_use, 1, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      trace_local = buf;
+      pthread_setspecific(trace_key, buf);
+      return buf;
+    }
+  }
+
+  buf = malloc(sizeof(TraceBuffer));
+  if (buf == NULL) {
+    return NULL;
+  }
+  buf->events = malloc(TRACE_RING_CAPACITY * sizeof(TraceEvent));
+  if (buf->events == NULL) {
+    free(buf);
+    return NULL;
+  }
+  buf->nevents = 0;
+  buf->in_use = 1;
+  buf->thread_name = NULL;
+  buf->tid = __atomic_fetch_add(&trace_next_tid, 1, __ATOMIC_RELAXED);
+  buf->next = __atomic_load_n(&trace_buffers, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&trace_buffers, &buf->next, buf, 0,
+                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    continue;
+  }
+  trace_local = buf;
+  pthread_setspecific(trace_key, buf);
+  return buf;
+}
+
+/**
+ * @brief Create key whose destructor runs trace_release().
+ *
+ * @return Void.
+ */
+void
+trace_key_init()
+{
+  pthread_key_create(&trace_key, trace_release);
+}
+
+/**
+ * @brief Release buffer of exiting thread for reuse by trace_buffer().
+ *
+ * @param buf Buffer of exiting thread (TraceBuffer).
+ * @return Void.
+ */
+void
+trace_release(void* buf)
+{
+  __atomic_store_n(&((TraceBuffer*) buf)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+/** @} */
@@ -0,0 +1,94 @@
+/**
+ * @file
+ * @brief Phase tracing header file.
+ *
+ * Sorts record timestamped begin / end events for their internal phases only
+ * when compiled with -DSORT_TRACE (e.g. `make SORT_TRACE=1`). Otherwise, the
+ * TRACE_* macros expand to nothing.
+ *
+ * Events are recorded into a fixed-size ring buffer per thread (oldest events
+ * are overwritten) and written out by trace_dump() in Chrome trace_event JSON
+ * format, which can be opened in Perfetto or chrome://tracing. When a thread
+ * exits, its buffer is handed to the next new thread, so memory grows with
+ * the number of threads alive at once, not with every thread ever started.
+ */
+#ifndef MY_TRACE_
+#define MY_TRACE_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/**
+ * @def TRACE_RING_CAPACITY
+ * @brief Maximum number of events kept per thread. */
+#define TRACE_RING_CAPACITY 65536
+
+/**
+ * @ingroup Trace
+ * @struct TraceEvent
+ * @brief Struct to represent a single trace event.
+ */
+typedef struct TraceEvent {
+  const char* name; ///< Name of event (must be a string literal).
+  char phase; ///< Chrome event phase ('B': begin, 'E': end, 'i': instant).
+  uint64_t ts; ///< Timestamp in nanoseconds.
+  const char* arg_names[2]; ///< Names of arguments (NULL: unused).
+  uint64_t args[2]; ///< Values of arguments.
+} TraceEvent;
+
+/**
+ * @ingroup Trace
+ * @struct TraceBuffer
+ * @brief Struct to represent the ring buffer of a single thread.
+ */
+typedef struct TraceBuffer {
+  TraceEvent* events; ///< Ring of TRACE_RING_CAPACITY events.
+  uint64_t nevents; ///< Total events ever recorded.
+  int tid; ///< Thread id used in output.
+  int in_use; ///< Whether a live thread owns the buffer.
+  const char* thread_name; ///< Thread name used in output (NULL: none).
+  struct TraceBuffer* next; ///< Next registered buffer.
+} TraceBuffer;
+
+//##############################################################################
+//# TRACE
+//##############################################################################
+
+void trace_event(const char* name, char phase,
+                 const char* arg0_name, uint64_t arg0,
+                 const char* arg1_name, uint64_t arg1);
+void trace_thread_name(const char* name);
+int trace_dump(const char* path);
+void trace_reset();
+
+#ifdef SORT_TRACE
+/**
+ * @def TRACE_BEGIN
+ * @brief Record beginning of phase. */
+#define TRACE_BEGIN(name) trace_event(name, 'B', NULL, 0, NULL, 0)
+/**
+ * @def TRACE_BEGIN_ARGS
+ * @brief Record beginning of phase with two named arguments. */
+#define TRACE_BEGIN_ARGS(name, n0, v0, n1, v1) \
+  trace_event(name, 'B', n0, v0, n1, v1)
+/**
+ * @def TRACE_END
+ * @brief Record end of innermost phase. */
+#define TRACE_END(name) trace_event(name, 'E', NULL, 0, NULL, 0)
+/**
+ * @def TRACE_INSTANT
+ * @brief Record instantaneous event with one named argument. */
+#define TRACE_INSTANT(name, n0, v0) trace_event(name, 'i', n0, v0, NULL, 0)
+/**
+ * @def TRACE_THREAD_NAME
+ * @brief Name calling thread in trace output. */
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#else
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_BEGIN_ARGS(name, n0, v0, n1, v1) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_INSTANT(name, n0, v0) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+#endif /* MY_TRACE_ */